@@ -0,0 +1,314 @@
+#include "bt/ByteEncDecoder.hpp"
+#include "bt/CodecKernels.hpp"
+#include "jutta_bt_proto/CoffeeMakerLoader.hpp"
+#include "jutta_bt_proto/MachineRegistry.hpp"
+#include "jutta_bt_proto/ManufacturerData.hpp"
+#include "jutta_bt_proto/Utils.hpp"
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/spdlog.h>
+
+/**
+ * Micro benchmarks for the codec, hex conversion and parsing hot paths.
+ * Prints the results as JSON, so they can be compared between releases.
+ **/
+
+struct BenchmarkResult {
+    std::string group;
+    std::string name;
+    /**
+     * Number of payload bytes processed per operation or 0 in case it does not apply.
+     **/
+    size_t bytes;
+    size_t iterations;
+    double nsPerOp;
+} __attribute__((aligned(128)));
+
+/**
+ * Prevents the compiler from optimizing away the computation of the given value.
+ **/
+template <typename T>
+inline void do_not_optimize(const T& value) {
+    // NOLINTNEXTLINE (hicpp-no-assembler)
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+class BenchmarkRunner {
+ private:
+    std::chrono::nanoseconds minTime;
+    /**
+     * Number of timed samples per benchmark. The median gets reported.
+     **/
+    size_t samples;
+    std::vector<BenchmarkResult> results{};
+
+ public:
+    BenchmarkRunner(std::chrono::nanoseconds minTime, size_t samples) : minTime(minTime), samples(samples) {}
+
+    /**
+     * Calls func repeatedly and records the median time per call.
+     * The number of iterations per sample gets doubled until a sample takes at least minTime / samples.
+     **/
+    template <typename Func>
+    void run(std::string_view group, std::string_view name, size_t bytes, Func func) {
+        const std::chrono::nanoseconds sampleTime = minTime / samples;
+        size_t iterations = 1;
+        while (time(func, iterations) < sampleTime) {
+            iterations *= 2;
+        }
+
+        std::vector<double> nsPerOp;
+        for (size_t i = 0; i < samples; i++) {
+            nsPerOp.push_back(static_cast<double>(time(func, iterations).count()) / static_cast<double>(iterations));
+        }
+        std::nth_element(nsPerOp.begin(), nsPerOp.begin() + static_cast<std::ptrdiff_t>(nsPerOp.size() / 2), nsPerOp.end());
+        results.push_back({std::string{group}, std::string{name}, bytes, iterations, nsPerOp[nsPerOp.size() / 2]});
+        std::cerr << group << '/' << name << ": " << fmt::format("{:.1f}", results.back().nsPerOp) << " ns\n";
+    }
+
+    void write_json(std::ostream& out) const {
+        out << "{\n";
+        out << fmt::format("  \"context\": {{\"codec_kernel\": \"{}\", \"min_time_ms\": {}, \"samples\": {}}},\n", bt::to_string(bt::get_codec_kernel()), std::chrono::duration_cast<std::chrono::milliseconds>(minTime).count(), samples);
+        out << "  \"benchmarks\": [\n";
+        for (size_t i = 0; i < results.size(); i++) {
+            const BenchmarkResult& r = results[i];
+            const double bytesPerSecond = r.bytes > 0 ? static_cast<double>(r.bytes) * 1e9 / r.nsPerOp : 0;
+            out << fmt::format(R"(    {{"group": "{}", "name": "{}", "bytes": {}, "iterations": {}, "ns_per_op": {:.3f}, "bytes_per_second": {:.0f}}})", r.group, r.name, r.bytes, r.iterations, r.nsPerOp, bytesPerSecond);
+            out << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+        out << "  ]\n";
+        out << "}\n";
+    }
+
+ private:
+    template <typename Func>
+    static std::chrono::nanoseconds time(Func& func, size_t iterations) {
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; i++) {
+            func();
+        }
+        return std::chrono::steady_clock::now() - start;
+    }
+};
+
+std::vector<uint8_t> make_payload(size_t size) {
+    std::vector<uint8_t> result(size);
+    for (size_t i = 0; i < size; i++) {
+        result[i] = static_cast<uint8_t>((i * 131) + 7);
+    }
+    return result;
+}
+
+void bench_codec(BenchmarkRunner& runner) {
+    constexpr uint8_t KEY = 0x2A;
+    const bt::CodecContext context(KEY);
+    for (const size_t size : {2, 16, 20, 64, 256, 1024, 4096, 16384, 65536}) {
+        const std::vector<uint8_t> data = make_payload(size);
+        std::vector<uint8_t> out(size);
+
+        runner.run("codec", fmt::format("encDecBytes/vector/{}", size), size, [&] {
+            std::vector<uint8_t> result = bt::encDecBytes(data, KEY);
+            do_not_optimize(result.data());
+        });
+        runner.run("codec", fmt::format("encDecBytes/span/{}", size), size, [&] {
+            bt::encDecBytes(data, out, KEY);
+            do_not_optimize(out.data());
+        });
+        runner.run("codec", fmt::format("CodecContext/{}", size), size, [&] {
+            context.enc_dec(data, out);
+            do_not_optimize(out.data());
+        });
+        for (const bt::CodecKernel kernel : {bt::CodecKernel::SCALAR, bt::CodecKernel::SSSE3, bt::CodecKernel::AVX2, bt::CodecKernel::NEON}) {
+            if (!bt::is_codec_kernel_supported(kernel)) {
+                continue;
+            }
+            runner.run("codec", fmt::format("kernel/{}/{}", bt::to_string(kernel), size), size, [&] {
+                bt::enc_dec_kernel(kernel, data, out, KEY);
+                do_not_optimize(out.data());
+            });
+        }
+    }
+}
+
+void bench_hex(BenchmarkRunner& runner) {
+    for (const size_t size : {2, 16, 64, 256, 1024, 4096}) {
+        const std::vector<uint8_t> data = make_payload(size);
+        const std::string hex = jutta_bt_proto::to_hex_string(data);
+
+        runner.run("hex", fmt::format("to_hex_string/{}", size), size, [&] {
+            std::string result = jutta_bt_proto::to_hex_string(data);
+            do_not_optimize(result.data());
+        });
+        runner.run("hex", fmt::format("from_hex_string/{}", size), size, [&] {
+            std::vector<uint8_t> result = jutta_bt_proto::from_hex_string(hex);
+            do_not_optimize(result.data());
+        });
+    }
+}
+
+void bench_product(BenchmarkRunner& runner) {
+    // A typical coffee product with all options set:
+    const jutta_bt_proto::Product product("Coffee", "03",
+                                          std::make_optional<jutta_bt_proto::ItemsOption>("F3", "02", std::span<const jutta_bt_proto::Item>{}),
+                                          std::make_optional<jutta_bt_proto::ItemsOption>("F7", "01", std::span<const jutta_bt_proto::Item>{}),
+                                          std::make_optional<jutta_bt_proto::MinMaxOption>("F4", 100, 25, 240, 5),
+                                          std::make_optional<jutta_bt_proto::MinMaxOption>("F5", 20, 0, 120, 1));
+    runner.run("product", "to_bt_command", 0, [&] {
+        std::string result = product.to_bt_command();
+        do_not_optimize(result.data());
+    });
+    runner.run("product", "command_variant", 0, [&] {
+        jutta_bt_proto::ProductCommand command = product.command;
+        product.waterAmount->to_bt_command(command, 150);
+        product.milkFoamAmount->to_bt_command(command, 10);
+        do_not_optimize(command);
+    });
+}
+
+void bench_man_data(BenchmarkRunner& runner) {
+    // Manufacturer data as advertised by an E6 (article number 15084):
+    static constexpr std::array<uint8_t, 16> MAN_DATA{0x2A, 0x05, 0x02, 0x00, 0xEC, 0x3A, 0x12, 0x00, 0x34, 0x12, 0x5B, 0x52, 0x5B, 0x52, 0x00, 0x00};
+    runner.run("man_data", "to_ymd", 0, [&] {
+        date::year_month_day result = jutta_bt_proto::to_ymd(MAN_DATA, 10);
+        do_not_optimize(result);
+    });
+    runner.run("man_data", "to_man_data", MAN_DATA.size(), [&] {
+        jutta_bt_proto::ManufacturerData result = jutta_bt_proto::to_man_data(MAN_DATA);
+        do_not_optimize(result);
+    });
+}
+
+/**
+ * Writes a machine file listing count machines and a machine file (XML) with the given number of products for each of them.
+ * Returns the path of the machine file.
+ **/
+std::filesystem::path write_machine_files(const std::filesystem::path& directory, size_t count, size_t productCount) {
+    std::filesystem::create_directories(directory);
+    std::ofstream machinesFile(directory / "JOE_MACHINES.TXT");
+    machinesFile << "ArticleNumber;Name;FileName;Version\n";
+    for (size_t i = 0; i < count; i++) {
+        const std::string fileName = fmt::format("BENCH{}", i);
+        machinesFile << fmt::format("{};Machine {};{};1\n", 10000 + i, i, fileName);
+
+        std::ofstream xml(directory / (fileName + ".xml"));
+        xml << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<JOE dated=\"2021-06-02\">\n  <PRODUCTS>\n";
+        for (size_t p = 0; p < productCount; p++) {
+            xml << fmt::format("    <PRODUCT Name=\"Product {}\" Code=\"{:02X}\">\n", p, p);
+            xml << "      <COFFEE_STRENGTH Argument=\"F3\" Default=\"02\"><ITEM Name=\"Mild\" Value=\"01\"/><ITEM Name=\"Normal\" Value=\"02\"/><ITEM Name=\"Strong\" Value=\"03\"/></COFFEE_STRENGTH>\n";
+            xml << "      <TEMPERATURE Argument=\"F7\" Default=\"01\"><ITEM Name=\"Normal\" Value=\"01\"/><ITEM Name=\"High\" Value=\"02\"/></TEMPERATURE>\n";
+            xml << "      <WATER_AMOUNT Argument=\"F4\" Value=\"45\" Min=\"25\" Max=\"240\" Step=\"5\"/>\n";
+            xml << "    </PRODUCT>\n";
+        }
+        xml << "  </PRODUCTS>\n  <ALERTS>\n";
+        for (size_t bit = 0; bit < 64; bit++) {
+            xml << fmt::format("    <ALERT Bit=\"{}\" Name=\"alert {}\" Type=\"{}\"/>\n", bit, bit, bit % 2 ? "error" : "info");
+        }
+        xml << "  </ALERTS>\n</JOE>\n";
+    }
+    return directory / "JOE_MACHINES.TXT";
+}
+
+void bench_preload(BenchmarkRunner& runner) {
+    constexpr size_t MACHINE_COUNT = 32;
+    constexpr size_t PRODUCT_COUNT = 128;
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "jutta_bt_proto_bench_preload";
+    jutta_bt_proto::MachineRegistry registry(write_machine_files(directory, MACHINE_COUNT, PRODUCT_COUNT));
+
+    // Preload logs each machine file:
+    const spdlog::level::level_enum level = spdlog::get_level();
+    spdlog::set_level(spdlog::level::warn);
+    std::vector<size_t> threadCounts{1, 2, 4};
+    threadCounts.push_back(std::max<size_t>(std::thread::hardware_concurrency(), 1));
+    std::sort(threadCounts.begin(), threadCounts.end());
+    threadCounts.erase(std::unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
+    for (const size_t threadCount : threadCounts) {
+        runner.run("registry", fmt::format("preload/{}x{}/threads/{}", MACHINE_COUNT, PRODUCT_COUNT, threadCount), 0, [&] {
+            registry.clear_joe_definitions();
+            std::vector<jutta_bt_proto::PreloadResult> results = registry.preload(threadCount);
+            do_not_optimize(results.data());
+        });
+    }
+    spdlog::set_level(level);
+    std::filesystem::remove_all(directory);
+}
+
+void print_usage(std::string_view name) {
+    std::cerr << "Usage: " << name << " [-t <ms>] [-s <samples>] [-o <file>]\n"
+              << "  -t <ms>       Minimum time spent per benchmark in milliseconds (default: 200).\n"
+              << "  -s <samples>  Number of samples per benchmark, the median gets reported (default: 5).\n"
+              << "  -o <file>     Write the JSON results to the given file instead of stdout.\n";
+}
+
+/**
+ * Parses a positive decimal number. Returns std::nullopt in case arg is no number or zero.
+ **/
+std::optional<size_t> to_positive(std::string_view arg) {
+    size_t result = 0;
+    const std::from_chars_result parsed = std::from_chars(arg.data(), arg.data() + arg.size(), result);
+    if (parsed.ec != std::errc{} || parsed.ptr != arg.data() + arg.size() || result == 0) {
+        return std::nullopt;
+    }
+    return result;
+}
+
+int main(int argc, char** argv) {
+    const std::vector<std::string_view> args(argv, argv + argc);
+    std::chrono::milliseconds minTime{200};
+    size_t samples = 5;
+    std::optional<std::string_view> path;
+    for (size_t i = 1; i < args.size(); i++) {
+        if ((args[i] == "-t" || args[i] == "-s") && i + 1 < args.size()) {
+            const std::optional<size_t> value = to_positive(args[i + 1]);
+            if (!value) {
+                std::cerr << "Invalid value '" << args[i + 1] << "' for " << args[i] << ". Expected a positive number.\n";
+                print_usage(args[0]);
+                return 1;
+            }
+            if (args[i] == "-t") {
+                minTime = std::chrono::milliseconds{*value};
+            } else {
+                samples = *value;
+            }
+            i++;
+        } else if (args[i] == "-o" && i + 1 < args.size()) {
+            path = args[++i];
+        } else {
+            print_usage(args[0]);
+            return args[i] == "-h" || args[i] == "--help" ? 0 : 1;
+        }
+    }
+
+    BenchmarkRunner runner(minTime, samples);
+    bench_codec(runner);
+    bench_hex(runner);
+    bench_product(runner);
+    bench_man_data(runner);
+    bench_preload(runner);
+
+    if (path) {
+        std::ofstream out{std::string{*path}};
+        if (!out) {
+            std::cerr << "Failed to open '" << *path << "'.\n";
+            return 1;
+        }
+        runner.write_json(out);
+    } else {
+        runner.write_json(std::cout);
+    }
+    return 0;
+}
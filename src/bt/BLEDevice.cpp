@@ -1,6 +1,7 @@
 #include <gattlib.h>  // Include first since we have some structs forward declared
 
 #include "bt/BLEDevice.hpp"
+#include "bt/Uuid.hpp"
 #include "bt/ByteEncDecoder.hpp"
 #include <array>
 #include <cassert>
@@ -8,11 +9,13 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <iomanip>
 #include <ios>
 #include <iostream>
 #include <logger/Logger.hpp>
+#include <span>
 #include <vector>
 #include <bluetooth/sdp.h>
 #include <spdlog/spdlog.h>
@@ -111,29 +114,25 @@ void BLEDevice::read_characteristic(const uuid_t& characteristic) {
     }
 
     uuid_t uuid = characteristic;
-    std::array<char, MAX_LEN_UUID_STR + 1> uuidStr{};
-    gattlib_uuid_to_string(&uuid, uuidStr.data(), uuidStr.size());
 
     void* buffer = nullptr;
     size_t bufLen = 0;
     int result = gattlib_read_char_by_uuid(connection, &uuid, &buffer, &bufLen);
     if (result != GATTLIB_SUCCESS) {
-        SPDLOG_WARN("Failed to read characteristic '{}' with error code {}.", uuidStr.data(), result);
+        SPDLOG_WARN("Failed to read characteristic '{}' with error code {}.", UuidView(uuid), result);
         return;
     }
-    // Convert to a vector:
-    const std::vector<uint8_t> data = to_vec(buffer, bufLen);
-    // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
-    onCharacteristicRead(data, characteristic);
-    SPDLOG_TRACE("Read {} bytes from '{}'.", bufLen, uuidStr.data());
+    onCharacteristicRead(std::span<const uint8_t>(static_cast<const uint8_t*>(buffer), bufLen), characteristic);
+    SPDLOG_TRACE("Read {} bytes from '{}'.", bufLen, UuidView(uuid));
+    // The buffer got allocated by gattlib and has to be freed by us:
+    // NOLINTNEXTLINE (cppcoreguidelines-no-malloc, hicpp-no-malloc)
+    std::free(buffer);
 }
 
 void BLEDevice::read_characteristics() {
-    std::array<char, MAX_LEN_UUID_STR + 1> uuidStr{};
     for (int i = 0; i < serviceCount; i++) {
         // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
-        gattlib_uuid_to_string(&services[i].uuid, uuidStr.data(), uuidStr.size());
-        SPDLOG_DEBUG("Found service with UUID: {}", uuidStr.data());
+        SPDLOG_DEBUG("Found service with UUID: {}", UuidView(services[i].uuid));
     }
 
     int characteristics_count = 0;
@@ -141,38 +140,33 @@ void BLEDevice::read_characteristics() {
     gattlib_discover_char(connection, &characteristics, &characteristics_count);
     for (int i = 0; i < characteristics_count; i++) {
         // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
-        gattlib_uuid_to_string(&characteristics[i].uuid, uuidStr.data(), uuidStr.size());
-        SPDLOG_DEBUG("Found characteristic with UUID: {}", uuidStr.data());
+        SPDLOG_DEBUG("Found characteristic with UUID: {}", UuidView(characteristics[i].uuid));
     }
 }
 
-bool BLEDevice::write(const uuid_t& characteristic, const std::vector<uint8_t>& data) {
+bool BLEDevice::write(const uuid_t& characteristic, std::span<const uint8_t> data) {
     if (!connected) {
         SPDLOG_WARN("Skipping write. Not connected.");
         return false;
     }
     uuid_t uuid = characteristic;
-    std::array<char, MAX_LEN_UUID_STR + 1> uuidStr{};
-    gattlib_uuid_to_string(&uuid, uuidStr.data(), uuidStr.size());
     int result = gattlib_write_char_by_uuid(connection, &uuid, data.data(), data.size());
     if (result == GATTLIB_SUCCESS) {
-        SPDLOG_TRACE("Wrote {} byte to characteristic '{}'.", data.size(), uuidStr.data());
+        SPDLOG_TRACE("Wrote {} byte to characteristic '{}'.", data.size(), UuidView(uuid));
         return true;
     }
-    SPDLOG_ERROR("Failed to write to characteristic '{}' with error code {}!", uuidStr.data(), result);
+    SPDLOG_ERROR("Failed to write to characteristic '{}' with error code {}!", UuidView(uuid), result);
     return false;
 }
 
 bool BLEDevice::subscribe(const uuid_t& characteristic) {
     const uuid_t uuid = characteristic;
-    std::array<char, MAX_LEN_UUID_STR + 1> uuidStr{};
-    gattlib_uuid_to_string(&uuid, uuidStr.data(), uuidStr.size());
     int result = gattlib_notification_start(connection, &uuid);
     if (result == GATTLIB_SUCCESS) {
-        SPDLOG_DEBUG("Subscribed to characteristic '{}'.", uuidStr.data());
+        SPDLOG_DEBUG("Subscribed to characteristic '{}'.", UuidView(uuid));
         return true;
     }
-    SPDLOG_ERROR("Failed to subscribe to characteristic '{}' with error code {}!", uuidStr.data(), result);
+    SPDLOG_ERROR("Failed to subscribe to characteristic '{}' with error code {}!", UuidView(uuid), result);
     return false;
 }
 
@@ -188,8 +182,7 @@ void BLEDevice::on_disconnected(void* arg) {
 
 void BLEDevice::on_notification(const uuid_t* uuid, const uint8_t* data, size_t len, void* arg) {
     BLEDevice* device = static_cast<BLEDevice*>(arg);
-    const std::vector<uint8_t> dataVec = BLEDevice::to_vec(data, len);
-    device->onCharacteristicNotification(dataVec, *uuid);
+    device->onCharacteristicNotification(std::span<const uint8_t>(data, len), *uuid);
 }
 //---------------------------------------------------------------------------
 }  // namespace bt
@@ -1,25 +1,18 @@
 #include "bt/ByteEncDecoder.hpp"
+#include "bt/CodecKernels.hpp"
 #include <array>
 #include <cassert>
 #include <cctype>
 #include <cstddef>
 #include <cstdint>
+#include <span>
 #include <vector>
 
 //---------------------------------------------------------------------------
 namespace bt {
 //---------------------------------------------------------------------------
-const std::array<uint8_t, 16> numbers1 = {14, 4, 3, 2, 1, 13, 8, 11, 6, 15, 12, 7, 10, 5, 0, 9};
-const std::array<uint8_t, 16> numbers2 = {10, 6, 13, 12, 14, 11, 1, 9, 15, 7, 0, 5, 3, 2, 4, 8};
-
 uint8_t mod256(int i) {
-    while (i > 255) {
-        i -= 256;
-    }
-    while (i < 0) {
-        i += 256;
-    }
-    return static_cast<uint8_t>(i);
+    return static_cast<uint8_t>(i & 0xFF);
 }
 
 uint8_t shuffle(int dataNibble, int nibbleCount, int keyLeftNibbel, int keyRightNibbel) {
@@ -33,6 +26,12 @@ uint8_t shuffle(int dataNibble, int nibbleCount, int keyLeftNibbel, int keyRight
 std::vector<uint8_t> encDecBytes(const std::vector<uint8_t>& data, uint8_t key) {
     std::vector<uint8_t> result;
     result.resize(data.size());
+    encDecBytes(data, result, key);
+    return result;
+}
+
+void encDecBytes(std::span<const uint8_t> data, std::span<uint8_t> out, uint8_t key) {
+    assert(out.size() >= data.size());
     uint8_t keyLeftNibbel = key >> 4;
     uint8_t keyRightNibbel = key & 15;
     int nibbelCount = 0;
@@ -42,11 +41,70 @@ std::vector<uint8_t> encDecBytes(const std::vector<uint8_t>& data, uint8_t key)
         uint8_t dataRightNibbel = d & 15;
         uint8_t resultLeftNibbel = shuffle(dataLeftNibbel, nibbelCount++, keyLeftNibbel, keyRightNibbel);
         uint8_t resultRightNibbel = shuffle(dataRightNibbel, nibbelCount++, keyLeftNibbel, keyRightNibbel);
-        result[offset] = (resultLeftNibbel << 4) | resultRightNibbel;
+        out[offset] = (resultLeftNibbel << 4) | resultRightNibbel;
     }
+}
+
+void encDecBytes(std::span<uint8_t> data, uint8_t key) {
+    encDecBytes(data, data, key);
+}
+
+CodecContext::CodecContext(uint8_t key) : key(key) {
+    uint8_t keyLeftNibbel = key >> 4;
+    uint8_t keyRightNibbel = key & 15;
+    for (size_t nibbelCount = 0; nibbelCount < PERIOD; nibbelCount++) {
+        const uint8_t shift = (nibbelCount & 1) ? 0 : 4;
+        for (uint8_t dataNibbel = 0; dataNibbel < 16; dataNibbel++) {
+            nibbles[nibbelCount][dataNibbel] = static_cast<uint8_t>(shuffle(dataNibbel, static_cast<int>(nibbelCount), keyLeftNibbel, keyRightNibbel) << shift);
+        }
+    }
+}
+
+uint8_t CodecContext::get_key() const {
+    return key;
+}
+
+std::vector<uint8_t> CodecContext::enc_dec(const std::vector<uint8_t>& data) const {
+    std::vector<uint8_t> result;
+    result.resize(data.size());
+    enc_dec(data, result);
     return result;
 }
 
+void CodecContext::enc_dec(std::span<const uint8_t> data, std::span<uint8_t> out, size_t offset) const {
+    assert(out.size() >= data.size());
+    if (data.size() >= KERNEL_THRESHOLD && get_codec_kernel() != CodecKernel::SCALAR) {
+        enc_dec_kernel(data, out, key, offset);
+        return;
+    }
+    for (size_t i = 0; i < data.size(); i++) {
+        const size_t nibbelCount = ((offset + i) << 1) % PERIOD;
+        const uint8_t d = data[i];
+        out[i] = nibbles[nibbelCount][d >> 4] | nibbles[nibbelCount + 1][d & 15];
+    }
+}
+
+void CodecContext::enc_dec(std::span<uint8_t> data) const {
+    enc_dec(data, data);
+}
+
+void StreamCodec::enc_dec(const CodecContext& context, std::span<const uint8_t> data, std::span<uint8_t> out) {
+    context.enc_dec(data, out, offset);
+    offset += data.size();
+}
+
+void StreamCodec::enc_dec(const CodecContext& context, std::span<uint8_t> data) {
+    enc_dec(context, data, data);
+}
+
+void StreamCodec::reset() {
+    offset = 0;
+}
+
+size_t StreamCodec::get_offset() const {
+    return offset;
+}
+
 //---------------------------------------------------------------------------
 }  // namespace bt
 //---------------------------------------------------------------------------
\ No newline at end of file
@@ -0,0 +1,374 @@
+#include "bt/CodecKernels.hpp"
+#include "bt/ByteEncDecoder.hpp"
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define JUTTA_BT_PROTO_KERNELS_X86
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(JUTTA_BT_PROTO_NEON_KERNELS)
+// Opt-in until the kernels have been verified on AArch64, the scalar kernel gets used otherwise:
+#define JUTTA_BT_PROTO_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+//---------------------------------------------------------------------------
+namespace bt {
+//---------------------------------------------------------------------------
+/**
+ * All kernels rely on the reformulation of the shuffle described at shuffle_nibble().
+ * Since the tables stay the same for every nibble, the vectorized kernels only need a single pshufb/tbl per table lookup.
+ **/
+void enc_dec_scalar(const uint8_t* data, uint8_t* out, size_t size, uint8_t key, size_t offset) {
+    const uint8_t keyLeft = key >> 4;
+    const uint8_t keyRight = key & 15;
+    for (size_t i = 0; i < size; i++) {
+        const auto n = static_cast<uint8_t>((offset + i) << 1);
+        // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        const uint8_t d = data[i];
+        const uint8_t left = shuffle_nibble(d >> 4, n, keyLeft, keyRight);
+        const uint8_t right = shuffle_nibble(d & 15, static_cast<uint8_t>(n + 1), keyLeft, keyRight);
+        // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        out[i] = static_cast<uint8_t>((left << 4) | right);
+    }
+}
+
+/**
+ * Processes the frames [first, frameCount) of a batch one nibble at a time.
+ **/
+void enc_dec_batch_scalar(const uint8_t* data, uint8_t* out, const uint8_t* keys, size_t first, size_t frameCount, size_t frameSize) {
+    for (size_t f = first; f < frameCount; f++) {
+        // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        const uint8_t keyLeft = keys[f] >> 4;
+        // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        const uint8_t keyRight = keys[f] & 15;
+        for (size_t i = 0; i < frameSize; i++) {
+            const auto n = static_cast<uint8_t>(i << 1);
+            const size_t index = (i * frameCount) + f;
+            // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            const uint8_t d = data[index];
+            const uint8_t left = shuffle_nibble(d >> 4, n, keyLeft, keyRight);
+            const uint8_t right = shuffle_nibble(d & 15, static_cast<uint8_t>(n + 1), keyLeft, keyRight);
+            // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            out[index] = static_cast<uint8_t>((left << 4) | right);
+        }
+    }
+}
+
+#ifdef JUTTA_BT_PROTO_KERNELS_X86
+__attribute__((target("ssse3"))) inline __m128i shuffle_nibbles_ssse3(__m128i d, __m128i n, __m128i keyLeft, __m128i keyRight, __m128i n1, __m128i n2) {
+    const __m128i mask = _mm_set1_epi8(0x0F);
+    const __m128i i5 = _mm_and_si128(_mm_srli_epi16(n, 4), mask);
+    const __m128i a = _mm_add_epi8(n, keyLeft);
+    const __m128i b = _mm_sub_epi8(_mm_add_epi8(keyRight, i5), a);
+    __m128i t = _mm_shuffle_epi8(n1, _mm_and_si128(_mm_add_epi8(d, a), mask));
+    t = _mm_shuffle_epi8(n2, _mm_and_si128(_mm_add_epi8(t, b), mask));
+    t = _mm_shuffle_epi8(n1, _mm_and_si128(_mm_sub_epi8(t, b), mask));
+    return _mm_and_si128(_mm_sub_epi8(t, a), mask);
+}
+
+__attribute__((target("ssse3"))) size_t enc_dec_ssse3(const uint8_t* data, uint8_t* out, size_t size, uint8_t key, size_t offset) {
+    const __m128i mask = _mm_set1_epi8(0x0F);
+    const __m128i n1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(numbers1.data()));
+    const __m128i n2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(numbers2.data()));
+    const __m128i keyLeft = _mm_set1_epi8(static_cast<char>(key >> 4));
+    const __m128i keyRight = _mm_set1_epi8(static_cast<char>(key & 15));
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i step = _mm_set1_epi8(32);
+    // Positions of the left nibbles. Wrapping around at 256 is exactly the period of the shuffle:
+    __m128i n = _mm_add_epi8(_mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30), _mm_set1_epi8(static_cast<char>(offset << 1)));
+
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        const __m128i left = shuffle_nibbles_ssse3(_mm_and_si128(_mm_srli_epi16(d, 4), mask), n, keyLeft, keyRight, n1, n2);
+        const __m128i right = shuffle_nibbles_ssse3(_mm_and_si128(d, mask), _mm_add_epi8(n, one), keyLeft, keyRight, n1, n2);
+        // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_or_si128(_mm_slli_epi16(left, 4), right));
+        n = _mm_add_epi8(n, step);
+    }
+    return i;
+}
+
+/**
+ * Processes 16 frames of a batch at once, one frame per lane. Returns the number of frames processed.
+ **/
+__attribute__((target("ssse3"))) size_t enc_dec_batch_ssse3(const uint8_t* data, uint8_t* out, const uint8_t* keys, size_t frameCount, size_t frameSize) {
+    const __m128i mask = _mm_set1_epi8(0x0F);
+    const __m128i n1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(numbers1.data()));
+    const __m128i n2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(numbers2.data()));
+
+    size_t f = 0;
+    for (; f + 16 <= frameCount; f += 16) {
+        // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        const __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + f));
+        const __m128i keyLeft = _mm_and_si128(_mm_srli_epi16(k, 4), mask);
+        const __m128i keyRight = _mm_and_si128(k, mask);
+        for (size_t i = 0; i < frameSize; i++) {
+            const __m128i n = _mm_set1_epi8(static_cast<char>(i << 1));
+            const size_t index = (i * frameCount) + f;
+            // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + index));
+            const __m128i left = shuffle_nibbles_ssse3(_mm_and_si128(_mm_srli_epi16(d, 4), mask), n, keyLeft, keyRight, n1, n2);
+            const __m128i right = shuffle_nibbles_ssse3(_mm_and_si128(d, mask), _mm_add_epi8(n, _mm_set1_epi8(1)), keyLeft, keyRight, n1, n2);
+            // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + index), _mm_or_si128(_mm_slli_epi16(left, 4), right));
+        }
+    }
+    return f;
+}
+
+__attribute__((target("avx2"))) inline __m256i shuffle_nibbles_avx2(__m256i d, __m256i n, __m256i keyLeft, __m256i keyRight, __m256i n1, __m256i n2) {
+    const __m256i mask = _mm256_set1_epi8(0x0F);
+    const __m256i i5 = _mm256_and_si256(_mm256_srli_epi16(n, 4), mask);
+    const __m256i a = _mm256_add_epi8(n, keyLeft);
+    const __m256i b = _mm256_sub_epi8(_mm256_add_epi8(keyRight, i5), a);
+    __m256i t = _mm256_shuffle_epi8(n1, _mm256_and_si256(_mm256_add_epi8(d, a), mask));
+    t = _mm256_shuffle_epi8(n2, _mm256_and_si256(_mm256_add_epi8(t, b), mask));
+    t = _mm256_shuffle_epi8(n1, _mm256_and_si256(_mm256_sub_epi8(t, b), mask));
+    return _mm256_and_si256(_mm256_sub_epi8(t, a), mask);
+}
+
+__attribute__((target("avx2"))) size_t enc_dec_avx2(const uint8_t* data, uint8_t* out, size_t size, uint8_t key, size_t offset) {
+    const __m256i mask = _mm256_set1_epi8(0x0F);
+    // vpshufb works on both 128 bit lanes independently, so both lanes need the complete table:
+    const __m256i n1 = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(numbers1.data())));
+    const __m256i n2 = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(numbers2.data())));
+    const __m256i keyLeft = _mm256_set1_epi8(static_cast<char>(key >> 4));
+    const __m256i keyRight = _mm256_set1_epi8(static_cast<char>(key & 15));
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i step = _mm256_set1_epi8(64);
+    __m256i n = _mm256_add_epi8(_mm256_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30,
+                                                 32, 34, 36, 38, 40, 42, 44, 46, 48, 50, 52, 54, 56, 58, 60, 62),
+                                _mm256_set1_epi8(static_cast<char>(offset << 1)));
+
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        const __m256i left = shuffle_nibbles_avx2(_mm256_and_si256(_mm256_srli_epi16(d, 4), mask), n, keyLeft, keyRight, n1, n2);
+        const __m256i right = shuffle_nibbles_avx2(_mm256_and_si256(d, mask), _mm256_add_epi8(n, one), keyLeft, keyRight, n1, n2);
+        // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_or_si256(_mm256_slli_epi16(left, 4), right));
+        n = _mm256_add_epi8(n, step);
+    }
+    return i;
+}
+/**
+ * Processes 32 frames of a batch at once, one frame per lane. Returns the number of frames processed.
+ **/
+__attribute__((target("avx2"))) size_t enc_dec_batch_avx2(const uint8_t* data, uint8_t* out, const uint8_t* keys, size_t frameCount, size_t frameSize) {
+    const __m256i mask = _mm256_set1_epi8(0x0F);
+    const __m256i n1 = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(numbers1.data())));
+    const __m256i n2 = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(numbers2.data())));
+
+    size_t f = 0;
+    for (; f + 32 <= frameCount; f += 32) {
+        // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        const __m256i k = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + f));
+        const __m256i keyLeft = _mm256_and_si256(_mm256_srli_epi16(k, 4), mask);
+        const __m256i keyRight = _mm256_and_si256(k, mask);
+        for (size_t i = 0; i < frameSize; i++) {
+            const __m256i n = _mm256_set1_epi8(static_cast<char>(i << 1));
+            const size_t index = (i * frameCount) + f;
+            // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + index));
+            const __m256i left = shuffle_nibbles_avx2(_mm256_and_si256(_mm256_srli_epi16(d, 4), mask), n, keyLeft, keyRight, n1, n2);
+            const __m256i right = shuffle_nibbles_avx2(_mm256_and_si256(d, mask), _mm256_add_epi8(n, _mm256_set1_epi8(1)), keyLeft, keyRight, n1, n2);
+            // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + index), _mm256_or_si256(_mm256_slli_epi16(left, 4), right));
+        }
+    }
+    return f;
+}
+#endif  // JUTTA_BT_PROTO_KERNELS_X86
+
+#ifdef JUTTA_BT_PROTO_KERNELS_NEON
+inline uint8x16_t shuffle_nibbles_neon(uint8x16_t d, uint8x16_t n, uint8x16_t keyLeft, uint8x16_t keyRight, uint8x16_t n1, uint8x16_t n2) {
+    const uint8x16_t mask = vdupq_n_u8(0x0F);
+    const uint8x16_t i5 = vshrq_n_u8(n, 4);
+    const uint8x16_t a = vaddq_u8(n, keyLeft);
+    const uint8x16_t b = vsubq_u8(vaddq_u8(keyRight, i5), a);
+    uint8x16_t t = vqtbl1q_u8(n1, vandq_u8(vaddq_u8(d, a), mask));
+    t = vqtbl1q_u8(n2, vandq_u8(vaddq_u8(t, b), mask));
+    t = vqtbl1q_u8(n1, vandq_u8(vsubq_u8(t, b), mask));
+    return vandq_u8(vsubq_u8(t, a), mask);
+}
+
+size_t enc_dec_neon(const uint8_t* data, uint8_t* out, size_t size, uint8_t key, size_t offset) {
+    static constexpr std::array<uint8_t, 16> POSITIONS{0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30};
+    const uint8x16_t mask = vdupq_n_u8(0x0F);
+    const uint8x16_t n1 = vld1q_u8(numbers1.data());
+    const uint8x16_t n2 = vld1q_u8(numbers2.data());
+    const uint8x16_t keyLeft = vdupq_n_u8(key >> 4);
+    const uint8x16_t keyRight = vdupq_n_u8(key & 15);
+    const uint8x16_t one = vdupq_n_u8(1);
+    const uint8x16_t step = vdupq_n_u8(32);
+    uint8x16_t n = vaddq_u8(vld1q_u8(POSITIONS.data()), vdupq_n_u8(static_cast<uint8_t>(offset << 1)));
+
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        const uint8x16_t d = vld1q_u8(data + i);
+        const uint8x16_t left = shuffle_nibbles_neon(vshrq_n_u8(d, 4), n, keyLeft, keyRight, n1, n2);
+        const uint8x16_t right = shuffle_nibbles_neon(vandq_u8(d, mask), vaddq_u8(n, one), keyLeft, keyRight, n1, n2);
+        // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        vst1q_u8(out + i, vorrq_u8(vshlq_n_u8(left, 4), right));
+        n = vaddq_u8(n, step);
+    }
+    return i;
+}
+
+/**
+ * Processes 16 frames of a batch at once, one frame per lane. Returns the number of frames processed.
+ **/
+size_t enc_dec_batch_neon(const uint8_t* data, uint8_t* out, const uint8_t* keys, size_t frameCount, size_t frameSize) {
+    const uint8x16_t mask = vdupq_n_u8(0x0F);
+    const uint8x16_t n1 = vld1q_u8(numbers1.data());
+    const uint8x16_t n2 = vld1q_u8(numbers2.data());
+
+    size_t f = 0;
+    for (; f + 16 <= frameCount; f += 16) {
+        // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        const uint8x16_t k = vld1q_u8(keys + f);
+        const uint8x16_t keyLeft = vshrq_n_u8(k, 4);
+        const uint8x16_t keyRight = vandq_u8(k, mask);
+        for (size_t i = 0; i < frameSize; i++) {
+            const uint8x16_t n = vdupq_n_u8(static_cast<uint8_t>(i << 1));
+            const size_t index = (i * frameCount) + f;
+            // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            const uint8x16_t d = vld1q_u8(data + index);
+            const uint8x16_t left = shuffle_nibbles_neon(vshrq_n_u8(d, 4), n, keyLeft, keyRight, n1, n2);
+            const uint8x16_t right = shuffle_nibbles_neon(vandq_u8(d, mask), vaddq_u8(n, vdupq_n_u8(1)), keyLeft, keyRight, n1, n2);
+            // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            vst1q_u8(out + index, vorrq_u8(vshlq_n_u8(left, 4), right));
+        }
+    }
+    return f;
+}
+#endif  // JUTTA_BT_PROTO_KERNELS_NEON
+
+CodecKernel detect_codec_kernel() {
+#ifdef JUTTA_BT_PROTO_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return CodecKernel::AVX2;
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return CodecKernel::SSSE3;
+    }
+#endif  // JUTTA_BT_PROTO_KERNELS_X86
+#ifdef JUTTA_BT_PROTO_KERNELS_NEON
+    return CodecKernel::NEON;
+#endif  // JUTTA_BT_PROTO_KERNELS_NEON
+    return CodecKernel::SCALAR;
+}
+
+CodecKernel get_codec_kernel() {
+    static const CodecKernel kernel = detect_codec_kernel();
+    return kernel;
+}
+
+bool is_codec_kernel_supported(CodecKernel kernel) {
+    switch (kernel) {
+        case CodecKernel::SCALAR:
+            return true;
+
+        case CodecKernel::SSSE3:
+            return get_codec_kernel() == CodecKernel::SSSE3 || get_codec_kernel() == CodecKernel::AVX2;
+
+        case CodecKernel::AVX2:
+        case CodecKernel::NEON:
+            return get_codec_kernel() == kernel;
+    }
+    return false;
+}
+
+std::string_view to_string(CodecKernel kernel) {
+    switch (kernel) {
+        case CodecKernel::SCALAR:
+            return "scalar";
+
+        case CodecKernel::SSSE3:
+            return "ssse3";
+
+        case CodecKernel::AVX2:
+            return "avx2";
+
+        case CodecKernel::NEON:
+            return "neon";
+    }
+    return "unknown";
+}
+
+void enc_dec_kernel(std::span<const uint8_t> data, std::span<uint8_t> out, uint8_t key, size_t offset) {
+    enc_dec_kernel(get_codec_kernel(), data, out, key, offset);
+}
+
+void enc_dec_kernel(CodecKernel kernel, std::span<const uint8_t> data, std::span<uint8_t> out, uint8_t key, size_t offset) {
+    assert(out.size() >= data.size());
+    assert(is_codec_kernel_supported(kernel));
+
+    size_t done = 0;
+    switch (kernel) {
+#ifdef JUTTA_BT_PROTO_KERNELS_X86
+        case CodecKernel::SSSE3:
+            done = enc_dec_ssse3(data.data(), out.data(), data.size(), key, offset);
+            break;
+
+        case CodecKernel::AVX2:
+            done = enc_dec_avx2(data.data(), out.data(), data.size(), key, offset);
+            break;
+#endif  // JUTTA_BT_PROTO_KERNELS_X86
+#ifdef JUTTA_BT_PROTO_KERNELS_NEON
+        case CodecKernel::NEON:
+            done = enc_dec_neon(data.data(), out.data(), data.size(), key, offset);
+            break;
+#endif  // JUTTA_BT_PROTO_KERNELS_NEON
+        default:
+            break;
+    }
+    // Remaining bytes that do not fill a whole vector:
+    // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    enc_dec_scalar(data.data() + done, out.data() + done, data.size() - done, key, offset + done);
+}
+
+void enc_dec_batch(std::span<const uint8_t> data, std::span<uint8_t> out, std::span<const uint8_t> keys, size_t frameSize) {
+    enc_dec_batch(get_codec_kernel(), data, out, keys, frameSize);
+}
+
+void enc_dec_batch(CodecKernel kernel, std::span<const uint8_t> data, std::span<uint8_t> out, std::span<const uint8_t> keys, size_t frameSize) {
+    assert(data.size() == keys.size() * frameSize);
+    assert(out.size() >= data.size());
+    assert(is_codec_kernel_supported(kernel));
+
+    size_t done = 0;
+    switch (kernel) {
+#ifdef JUTTA_BT_PROTO_KERNELS_X86
+        case CodecKernel::SSSE3:
+            done = enc_dec_batch_ssse3(data.data(), out.data(), keys.data(), keys.size(), frameSize);
+            break;
+
+        case CodecKernel::AVX2:
+            done = enc_dec_batch_avx2(data.data(), out.data(), keys.data(), keys.size(), frameSize);
+            break;
+#endif  // JUTTA_BT_PROTO_KERNELS_X86
+#ifdef JUTTA_BT_PROTO_KERNELS_NEON
+        case CodecKernel::NEON:
+            done = enc_dec_batch_neon(data.data(), out.data(), keys.data(), keys.size(), frameSize);
+            break;
+#endif  // JUTTA_BT_PROTO_KERNELS_NEON
+        default:
+            break;
+    }
+    // Remaining frames that do not fill a whole vector:
+    enc_dec_batch_scalar(data.data(), out.data(), keys.data(), done, keys.size(), frameSize);
+}
+//---------------------------------------------------------------------------
+}  // namespace bt
+//---------------------------------------------------------------------------
@@ -0,0 +1,71 @@
+#include "bt/FrameBatch.hpp"
+#include "bt/CodecKernels.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+//---------------------------------------------------------------------------
+namespace bt {
+//---------------------------------------------------------------------------
+FrameBatch::FrameBatch(size_t capacity, size_t maxFrameSize) : capacity(capacity), maxFrameSize(maxFrameSize), data(capacity * maxFrameSize), keys(capacity), sizes(capacity) {}
+
+bool FrameBatch::add(std::span<const uint8_t> frame, uint8_t key) {
+    if (count >= capacity || frame.size() > maxFrameSize) {
+        return false;
+    }
+    for (size_t i = 0; i < frame.size(); i++) {
+        data[(i * capacity) + count] = frame[i];
+    }
+    keys[count] = key;
+    sizes[count] = frame.size();
+    count++;
+    return true;
+}
+
+void FrameBatch::enc_dec() {
+    if (count <= 0) {
+        return;
+    }
+    // All lanes up to the longest frame get processed, including the padding of shorter frames and unused lanes.
+    // Those bytes are never read, but this way the rows stay contiguous and the kernels do not need a stride.
+    const size_t frameSize = *std::max_element(sizes.begin(), sizes.begin() + static_cast<std::ptrdiff_t>(count));
+    const std::span<uint8_t> rows = std::span<uint8_t>(data).first(frameSize * capacity);
+    enc_dec_batch(rows, rows, keys, frameSize);
+}
+
+std::span<uint8_t> FrameBatch::get_frame(size_t index, std::span<uint8_t> out) const {
+    assert(index < count);
+    assert(out.size() >= sizes[index]);
+    for (size_t i = 0; i < sizes[index]; i++) {
+        out[i] = data[(i * capacity) + index];
+    }
+    return out.first(sizes[index]);
+}
+
+std::vector<uint8_t> FrameBatch::get_frame(size_t index) const {
+    assert(index < count);
+    std::vector<uint8_t> result(sizes[index]);
+    get_frame(index, result);
+    return result;
+}
+
+void FrameBatch::clear() {
+    // Unused lanes still get processed by enc_dec(), so reset them to something defined:
+    std::fill(keys.begin(), keys.end(), 0);
+    std::fill(sizes.begin(), sizes.end(), 0);
+    count = 0;
+}
+
+size_t FrameBatch::size() const { return count; }
+
+bool FrameBatch::empty() const { return count <= 0; }
+
+size_t FrameBatch::get_capacity() const { return capacity; }
+
+size_t FrameBatch::get_max_frame_size() const { return maxFrameSize; }
+//---------------------------------------------------------------------------
+}  // namespace bt
+//---------------------------------------------------------------------------
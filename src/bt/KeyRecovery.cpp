@@ -0,0 +1,106 @@
+#include "bt/KeyRecovery.hpp"
+#include "bt/CodecKernels.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+//---------------------------------------------------------------------------
+namespace bt {
+//---------------------------------------------------------------------------
+/**
+ * Inverse of KEY_FRAME_START: For each possible encoded first byte, all keys producing it.
+ **/
+const std::array<KeyCandidates, 256>& get_candidates_by_frame_start() {
+    static const std::array<KeyCandidates, 256> candidates = [] {
+        std::array<KeyCandidates, 256> result{};
+        for (size_t key = 0; key < KEY_FRAME_START.size(); key++) {
+            result[KEY_FRAME_START[key]].set(key);
+        }
+        return result;
+    }();
+    return candidates;
+}
+
+KeyCandidates find_key_candidates(std::span<const uint8_t> frame) {
+    if (frame.empty()) {
+        return KeyCandidates{};
+    }
+    return get_candidates_by_frame_start()[frame[0]];
+}
+
+std::vector<KeyCandidates> find_key_candidates(std::span<const std::vector<uint8_t>> frames) {
+    std::vector<KeyCandidates> result;
+    result.reserve(frames.size());
+    for (const std::vector<uint8_t>& frame : frames) {
+        result.push_back(find_key_candidates(frame));
+    }
+    return result;
+}
+
+KeyCandidates find_common_key_candidates(std::span<const std::vector<uint8_t>> frames) {
+    KeyCandidates result;
+    if (frames.empty()) {
+        return result;
+    }
+    result.set();
+    for (const std::vector<uint8_t>& frame : frames) {
+        result &= find_key_candidates(frame);
+    }
+    return result;
+}
+
+/**
+ * Returns the number of frames that end with the given key once decoded.
+ **/
+size_t count_key_terminated(std::span<const std::vector<uint8_t>> frames, uint8_t key) {
+    size_t count = 0;
+    for (const std::vector<uint8_t>& frame : frames) {
+        if (frame.size() < 2) {
+            continue;
+        }
+        uint8_t last = 0;
+        enc_dec_kernel(CodecKernel::SCALAR, std::span<const uint8_t>(frame).last(1), std::span<uint8_t>(&last, 1), key, frame.size() - 1);
+        if (last == key) {
+            count++;
+        }
+    }
+    return count;
+}
+
+std::optional<uint8_t> recover_key(const KeyCandidates& candidates, std::span<const std::vector<uint8_t>> frames) {
+    std::optional<uint8_t> result;
+    size_t bestCount = 0;
+    bool unique = false;
+    for (size_t key = 0; key < candidates.size(); key++) {
+        if (!candidates.test(key)) {
+            continue;
+        }
+        if (candidates.count() == 1) {
+            return static_cast<uint8_t>(key);
+        }
+        const size_t count = count_key_terminated(frames, static_cast<uint8_t>(key));
+        if (count > bestCount) {
+            bestCount = count;
+            result = static_cast<uint8_t>(key);
+            unique = true;
+        } else if (count == bestCount) {
+            unique = false;
+        }
+    }
+    return unique ? result : std::nullopt;
+}
+
+std::optional<uint8_t> recover_key(std::span<const std::vector<uint8_t>> frames) {
+    return recover_key(find_common_key_candidates(frames), frames);
+}
+
+std::optional<uint8_t> recover_key(std::span<const uint8_t> frame) {
+    const std::vector<uint8_t> frames{frame.begin(), frame.end()};
+    return recover_key(find_key_candidates(frame), std::span<const std::vector<uint8_t>>(&frames, 1));
+}
+//---------------------------------------------------------------------------
+}  // namespace bt
+//---------------------------------------------------------------------------
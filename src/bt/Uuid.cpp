@@ -0,0 +1,54 @@
+#include <gattlib.h>  // Include first since we have some structs forward declared
+
+#include "bt/Uuid.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <bluetooth/sdp.h>
+
+//---------------------------------------------------------------------------
+namespace bt {
+//---------------------------------------------------------------------------
+/**
+ * Bluetooth base UUID 00000000-0000-1000-8000-00805F9B34FB.
+ * 16 and 32 bit UUIDs replace its first 32 bits.
+ **/
+constexpr uint64_t BASE_UUID_HIGH = 0x0000000000001000;
+constexpr uint64_t BASE_UUID_LOW = 0x800000805F9B34FB;
+
+size_t Uuid128Hash::operator()(const Uuid128& uuid) const noexcept {
+    return std::hash<uint64_t>{}(uuid.high ^ (uuid.low * 0x9E3779B97F4A7C15));
+}
+
+Uuid128 to_uuid128(const uuid_t& uuid) {
+    switch (uuid.type) {
+        case SDP_UUID16:
+            return Uuid128{(static_cast<uint64_t>(uuid.value.uuid16) << 32) | BASE_UUID_HIGH, BASE_UUID_LOW};
+
+        case SDP_UUID32:
+            return Uuid128{(static_cast<uint64_t>(uuid.value.uuid32) << 32) | BASE_UUID_HIGH, BASE_UUID_LOW};
+
+        default: {
+            // 128 bit UUIDs are stored big-endian:
+            Uuid128 result;
+            for (size_t i = 0; i < 8; i++) {
+                result.high = (result.high << 8) | uuid.value.uuid128.data[i];
+                result.low = (result.low << 8) | uuid.value.uuid128.data[i + 8];
+            }
+            return result;
+        }
+    }
+}
+
+std::string_view to_string(const uuid_t& uuid, std::array<char, UUID_STR_SIZE>& buffer) {
+    static_assert(UUID_STR_SIZE >= MAX_LEN_UUID_STR + 1);
+    if (gattlib_uuid_to_string(&uuid, buffer.data(), buffer.size()) != GATTLIB_SUCCESS) {
+        return "invalid UUID";
+    }
+    return buffer.data();
+}
+//---------------------------------------------------------------------------
+}  // namespace bt
+//---------------------------------------------------------------------------
@@ -1,10 +1,12 @@
 #pragma once
 
+#include <array>
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <optional>
+#include <span>
 #include <string>
 #include <vector>
 #include <bluetooth/sdp.h>
@@ -17,10 +19,19 @@ using gattlib_primary_service_t = struct gattlib_primary_service_t;
 //---------------------------------------------------------------------------
 namespace bt {
 //---------------------------------------------------------------------------
+/**
+ * The maximum length of an attribute value as defined by the Bluetooth Core Specification.
+ **/
+constexpr size_t MAX_ATTRIBUTE_SIZE = 512;
+/**
+ * A buffer large enough to hold any characteristic value.
+ **/
+using AttributeBuffer = std::array<uint8_t, MAX_ATTRIBUTE_SIZE>;
+
 class BLEDevice {
  public:
-    using OnCharacteristicReadFunc = std::function<void(const std::vector<uint8_t>&, const uuid_t&)>;
-    using OnCharacteristicNotificationFunc = std::function<void(const std::vector<uint8_t>&, const uuid_t&)>;
+    using OnCharacteristicReadFunc = std::function<void(std::span<const uint8_t>, const uuid_t&)>;
+    using OnCharacteristicNotificationFunc = std::function<void(std::span<const uint8_t>, const uuid_t&)>;
     using OnConnectedFunc = std::function<void()>;
     using OnDisconnectedFunc = std::function<void()>;
 
@@ -53,7 +64,7 @@ class BLEDevice {
     const std::vector<uint8_t> get_mam_data();
     void read_characteristics();
     void read_characteristic(const uuid_t& characteristic);
-    bool write(const uuid_t& characteristic, const std::vector<uint8_t>& data);
+    bool write(const uuid_t& characteristic, std::span<const uint8_t> data);
     bool subscribe(const uuid_t& characteristic);
 
  private:
@@ -1,19 +1,148 @@
 #pragma once
 
+#include <array>
 #include <cstddef>
 #include <cstdint>
+#include <span>
 #include <vector>
 
 //---------------------------------------------------------------------------
 namespace bt {
 //---------------------------------------------------------------------------
+/**
+ * Substitution tables used for shuffling nibbles.
+ **/
+constexpr std::array<uint8_t, 16> numbers1 = {14, 4, 3, 2, 1, 13, 8, 11, 6, 15, 12, 7, 10, 5, 0, 9};
+constexpr std::array<uint8_t, 16> numbers2 = {10, 6, 13, 12, 14, 11, 1, 9, 15, 7, 0, 5, 3, 2, 4, 8};
+
+/**
+ * Shuffles a single nibble at the given nibble position n (modulo 256).
+ * This is a reformulation of the shuffle used by encDecBytes() where everything is calculated modulo 16:
+ * a = n + keyLeft
+ * b = keyRight + (n >> 4) - a
+ * result = numbers1[numbers2[numbers1[dataNibble + a] + b] - b] - a
+ * Only a and b depend on the position and the key, the tables stay the same for every nibble.
+ **/
+constexpr uint8_t shuffle_nibble(uint8_t dataNibble, uint8_t n, uint8_t keyLeft, uint8_t keyRight) {
+    const auto a = static_cast<uint8_t>(n + keyLeft);
+    const auto b = static_cast<uint8_t>(keyRight + (n >> 4) - a);
+    uint8_t t = numbers1[(dataNibble + a) & 15];
+    t = numbers2[(t + b) & 15];
+    t = numbers1[(t - b) & 15];
+    return static_cast<uint8_t>((t - a) & 15);
+}
+
+/**
+ * Compile time version of encDecBytes() for fixed size data.
+ **/
+template <size_t N>
+constexpr std::array<uint8_t, N> encDecArray(const std::array<uint8_t, N>& data, uint8_t key) {
+    const uint8_t keyLeft = key >> 4;
+    const uint8_t keyRight = key & 15;
+    std::array<uint8_t, N> result{};
+    for (size_t i = 0; i < N; i++) {
+        const auto n = static_cast<uint8_t>(i << 1);
+        const uint8_t left = shuffle_nibble(data[i] >> 4, n, keyLeft, keyRight);
+        const uint8_t right = shuffle_nibble(data[i] & 15, static_cast<uint8_t>(n + 1), keyLeft, keyRight);
+        result[i] = static_cast<uint8_t>((left << 4) | right);
+    }
+    return result;
+}
+
 /**
  * Encodes or decodes the given data with the given key.
  * When you are decoding data, the first byte of the result should be key if everything went well.
  * This function is reversible.
  * encDecBytes(encDecBytes(data)) == data
  **/
-std::vector<uint8_t> encDecBytes(const std::vector<uint8_t>& data, uint8_t key);
+[[nodiscard]] std::vector<uint8_t> encDecBytes(const std::vector<uint8_t>& data, uint8_t key);
+/**
+ * Encodes or decodes the given data with the given key and writes the result to out.
+ * out has to be at least as large as data and may be the same memory as data.
+ **/
+void encDecBytes(std::span<const uint8_t> data, std::span<uint8_t> out, uint8_t key);
+/**
+ * Encodes or decodes the given data in place with the given key.
+ **/
+void encDecBytes(std::span<uint8_t> data, uint8_t key);
+
+/**
+ * Precomputed encoding/decoding tables for a single key.
+ * The shuffle result of a nibble only depends on its value and its position modulo CodecContext::PERIOD.
+ * Building a context once per key (e.g. once per connection) reduces encoding or decoding a byte to two table lookups.
+ * Payloads of at least KERNEL_THRESHOLD bytes are handed to the vectorized kernel in case the CPU supports one.
+ * The result is identical to encDecBytes().
+ **/
+class CodecContext {
+ public:
+    /**
+     * Number of nibbles after which the shuffle pattern repeats.
+     **/
+    static constexpr size_t PERIOD = 256;
+    /**
+     * Minimum payload size in bytes for which the vectorized kernel is used instead of the tables.
+     **/
+    static constexpr size_t KERNEL_THRESHOLD = 64;
+
+ private:
+    uint8_t key;
+    /**
+     * The result nibble for each (nibble position, nibble) pair.
+     * Results for even positions (the left nibble of a byte) are stored already shifted into the upper half of the byte.
+     **/
+    std::array<std::array<uint8_t, 16>, PERIOD> nibbles{};
+
+ public:
+    explicit CodecContext(uint8_t key);
+
+    [[nodiscard]] uint8_t get_key() const;
+    /**
+     * Encodes or decodes the given data with the key of this context.
+     **/
+    [[nodiscard]] std::vector<uint8_t> enc_dec(const std::vector<uint8_t>& data) const;
+    /**
+     * Encodes or decodes the given data with the key of this context and writes the result to out.
+     * out has to be at least as large as data and may be the same memory as data.
+     * offset is the position in bytes of data[0] inside the frame, which allows to process a frame in multiple parts.
+     **/
+    void enc_dec(std::span<const uint8_t> data, std::span<uint8_t> out, size_t offset = 0) const;
+    /**
+     * Encodes or decodes the given data in place with the key of this context.
+     **/
+    void enc_dec(std::span<uint8_t> data) const;
+};
+
+/**
+ * Stateful codec for frames that are known to arrive in multiple chunks.
+ * Keeps track of the position inside the current frame, so each chunk can be processed as soon as it arrives without reassembling the frame first.
+ * Only holds the position, the context gets passed on each call. Call reset() once the frame is complete, before starting with the next one.
+ **/
+class StreamCodec {
+ private:
+    /**
+     * Number of bytes of the current frame processed so far.
+     **/
+    size_t offset{0};
+
+ public:
+    /**
+     * Encodes or decodes the next chunk of the current frame with the given context and writes the result to out.
+     * out has to be at least as large as data and may be the same memory as data.
+     **/
+    void enc_dec(const CodecContext& context, std::span<const uint8_t> data, std::span<uint8_t> out);
+    /**
+     * Encodes or decodes the next chunk of the current frame in place.
+     **/
+    void enc_dec(const CodecContext& context, std::span<uint8_t> data);
+    /**
+     * Starts a new frame.
+     **/
+    void reset();
+    /**
+     * Returns the number of bytes of the current frame processed so far.
+     **/
+    [[nodiscard]] size_t get_offset() const;
+};
 //---------------------------------------------------------------------------
 }  // namespace bt
-//---------------------------------------------------------------------------
\ No newline at end of file
+//---------------------------------------------------------------------------
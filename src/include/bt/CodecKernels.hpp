@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+//---------------------------------------------------------------------------
+namespace bt {
+//---------------------------------------------------------------------------
+/**
+ * Implementations of the nibble shuffle used by encDecBytes().
+ * All of them produce bit-identical results.
+ **/
+enum class CodecKernel : uint8_t {
+    /**
+     * Portable fallback processing one nibble at a time.
+     **/
+    SCALAR,
+    /**
+     * x86 SSSE3 (pshufb), 16 bytes per iteration.
+     **/
+    SSSE3,
+    /**
+     * x86 AVX2 (vpshufb), 32 bytes per iteration.
+     **/
+    AVX2,
+    /**
+     * AArch64 NEON (tbl), 16 bytes per iteration.
+     * Only compiled on AArch64 with JUTTA_BT_PROTO_NEON_KERNELS, since it has not been verified on real hardware yet (see README.md).
+     **/
+    NEON
+};
+
+/**
+ * Returns the fastest kernel supported by the CPU we are running on.
+ * The CPU gets only probed on the first call.
+ **/
+[[nodiscard]] CodecKernel get_codec_kernel();
+/**
+ * Returns true in case the given kernel got compiled in and is supported by the CPU we are running on.
+ **/
+[[nodiscard]] bool is_codec_kernel_supported(CodecKernel kernel);
+[[nodiscard]] std::string_view to_string(CodecKernel kernel);
+
+/**
+ * Encodes or decodes the given data with the given key like encDecBytes() using the fastest available kernel.
+ * offset is the position in bytes of data[0] inside the frame, which allows to process a frame in multiple parts.
+ * out has to be at least as large as data and may be the same memory as data.
+ **/
+void enc_dec_kernel(std::span<const uint8_t> data, std::span<uint8_t> out, uint8_t key, size_t offset = 0);
+/**
+ * Same as above but with an explicitly selected kernel.
+ * The kernel has to be supported (see is_codec_kernel_supported()).
+ **/
+void enc_dec_kernel(CodecKernel kernel, std::span<const uint8_t> data, std::span<uint8_t> out, uint8_t key, size_t offset = 0);
+
+/**
+ * Encodes or decodes a batch of frames, each with its own key, using the fastest available kernel.
+ * The frames are stored as structure of arrays: byte i of frame f is located at data[i * keys.size() + f].
+ * This way the bytes at the same position of all frames are consecutive in memory and get processed together, one frame per vector lane.
+ * data has to hold frameSize * keys.size() bytes. Frames shorter than frameSize have to be padded.
+ * out has to be at least as large as data and may be the same memory as data.
+ **/
+void enc_dec_batch(std::span<const uint8_t> data, std::span<uint8_t> out, std::span<const uint8_t> keys, size_t frameSize);
+/**
+ * Same as above but with an explicitly selected kernel.
+ * The kernel has to be supported (see is_codec_kernel_supported()).
+ **/
+void enc_dec_batch(CodecKernel kernel, std::span<const uint8_t> data, std::span<uint8_t> out, std::span<const uint8_t> keys, size_t frameSize);
+//---------------------------------------------------------------------------
+}  // namespace bt
+//---------------------------------------------------------------------------
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+//---------------------------------------------------------------------------
+namespace bt {
+//---------------------------------------------------------------------------
+/**
+ * A batch of frames from multiple coffee makers, each with its own key, that get encoded or decoded together.
+ * The frames are stored as structure of arrays (see enc_dec_batch()), so the SIMD kernels process one frame per vector lane.
+ * Intended for gateways talking to a whole fleet of coffee makers at once.
+ * The buffers get allocated once on construction and reused after clear().
+ **/
+class FrameBatch {
+ private:
+    size_t capacity;
+    size_t maxFrameSize;
+    /**
+     * Byte i of frame f is located at data[i * capacity + f].
+     **/
+    std::vector<uint8_t> data;
+    /**
+     * Key and size for each of the capacity lanes. Unused lanes hold 0.
+     **/
+    std::vector<uint8_t> keys;
+    std::vector<size_t> sizes;
+    size_t count{0};
+
+ public:
+    /**
+     * capacity is the maximum number of frames. Should be a multiple of 32 to make full use of the kernels.
+     * maxFrameSize is the maximum size of a single frame in bytes.
+     **/
+    FrameBatch(size_t capacity, size_t maxFrameSize);
+
+    /**
+     * Adds the given frame together with the key it should be encoded or decoded with.
+     * Returns false in case the batch is full or the frame is larger than maxFrameSize.
+     **/
+    bool add(std::span<const uint8_t> frame, uint8_t key);
+    /**
+     * Encodes or decodes all frames in place.
+     **/
+    void enc_dec();
+    /**
+     * Copies the frame at the given index into out and returns the part of out holding it.
+     * out has to be at least as large as the frame.
+     **/
+    std::span<uint8_t> get_frame(size_t index, std::span<uint8_t> out) const;
+    [[nodiscard]] std::vector<uint8_t> get_frame(size_t index) const;
+    /**
+     * Removes all frames but keeps the buffers.
+     **/
+    void clear();
+
+    [[nodiscard]] size_t size() const;
+    [[nodiscard]] bool empty() const;
+    [[nodiscard]] size_t get_capacity() const;
+    [[nodiscard]] size_t get_max_frame_size() const;
+};
+//---------------------------------------------------------------------------
+}  // namespace bt
+//---------------------------------------------------------------------------
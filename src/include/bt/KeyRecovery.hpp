@@ -0,0 +1,64 @@
+#pragma once
+
+#include "bt/ByteEncDecoder.hpp"
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+//---------------------------------------------------------------------------
+namespace bt {
+//---------------------------------------------------------------------------
+/**
+ * Set of keys. Bit k is set in case key k is a candidate.
+ **/
+using KeyCandidates = std::bitset<256>;
+
+/**
+ * The first byte of a correctly decoded frame is the key.
+ * Since the shuffle of the first byte is a bijection for every key, there is exactly one encoded first byte per key that decodes to the key itself.
+ * This table holds this byte for each key, so testing all 256 keys against a frame boils down to comparing its first byte with this table.
+ * Since some keys share the same start byte (up to three), the first byte alone is not always enough to tell the key.
+ **/
+inline constexpr std::array<uint8_t, 256> KEY_FRAME_START = [] {
+    std::array<uint8_t, 256> result{};
+    for (size_t key = 0; key < result.size(); key++) {
+        result[key] = encDecArray(std::array<uint8_t, 1>{static_cast<uint8_t>(key)}, static_cast<uint8_t>(key))[0];
+    }
+    return result;
+}();
+
+/**
+ * Returns all keys that decode the given encoded frame so that it starts with the key.
+ * Returns an empty set in case the frame is empty.
+ **/
+[[nodiscard]] KeyCandidates find_key_candidates(std::span<const uint8_t> frame);
+/**
+ * Returns the candidates for each of the given encoded frames.
+ * A single table lookup per frame, so this is not worth splitting across threads.
+ **/
+[[nodiscard]] std::vector<KeyCandidates> find_key_candidates(std::span<const std::vector<uint8_t>> frames);
+/**
+ * Returns the keys that are candidates for all of the given encoded frames, e.g. all frames captured from a single coffee maker.
+ **/
+[[nodiscard]] KeyCandidates find_common_key_candidates(std::span<const std::vector<uint8_t>> frames);
+/**
+ * Returns the key in case it can be determined unambiguously from the given encoded frames.
+ * In case multiple keys match the start of all frames, the one ending the most frames with the key wins.
+ * This is the case for frames written with the key overridden at the end (e.g. product and statistics commands).
+ **/
+[[nodiscard]] std::optional<uint8_t> recover_key(std::span<const std::vector<uint8_t>> frames);
+/**
+ * Same as above but for the common candidates of the given frames computed already (see find_common_key_candidates()).
+ **/
+[[nodiscard]] std::optional<uint8_t> recover_key(const KeyCandidates& candidates, std::span<const std::vector<uint8_t>> frames);
+/**
+ * Same as above but for a single encoded frame.
+ **/
+[[nodiscard]] std::optional<uint8_t> recover_key(std::span<const uint8_t> frame);
+//---------------------------------------------------------------------------
+}  // namespace bt
+//---------------------------------------------------------------------------
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <bluetooth/sdp.h>
+#include <spdlog/fmt/fmt.h>
+
+//---------------------------------------------------------------------------
+namespace bt {
+//---------------------------------------------------------------------------
+/**
+ * A UUID in its 128 bit form stored as two integers, so it can be compared and hashed cheaply.
+ **/
+struct Uuid128 {
+    uint64_t high{0};
+    uint64_t low{0};
+
+    bool operator==(const Uuid128& other) const = default;
+} __attribute__((aligned(16)));
+
+struct Uuid128Hash {
+    size_t operator()(const Uuid128& uuid) const noexcept;
+};
+
+/**
+ * Converts the given UUID to its 128 bit form.
+ * 16 and 32 bit UUIDs get expanded with the Bluetooth base UUID like gattlib_uuid_cmp() does.
+ **/
+[[nodiscard]] Uuid128 to_uuid128(const uuid_t& uuid);
+
+/**
+ * Enough to hold any UUID formatted by gattlib including the null terminator.
+ **/
+constexpr size_t UUID_STR_SIZE = 38;
+/**
+ * Formats the given UUID with gattlib into the given buffer and returns the formatted part.
+ **/
+std::string_view to_string(const uuid_t& uuid, std::array<char, UUID_STR_SIZE>& buffer);
+
+/**
+ * Non owning wrapper for formatting a UUID with fmt/spdlog.
+ * The UUID only gets formatted in case the message actually gets emitted.
+ * Example: SPDLOG_TRACE("Read from '{}'.", UuidView(uuid));
+ **/
+struct UuidView {
+    const uuid_t& uuid;
+
+    explicit UuidView(const uuid_t& uuid) : uuid(uuid) {}
+} __attribute__((aligned(8)));
+//---------------------------------------------------------------------------
+}  // namespace bt
+//---------------------------------------------------------------------------
+
+template <>
+struct fmt::formatter<bt::UuidView> {
+    // NOLINTNEXTLINE (readability-convert-member-functions-to-static)
+    constexpr auto parse(fmt::format_parse_context& ctx) -> decltype(ctx.begin()) {
+        if (ctx.begin() != ctx.end() && *ctx.begin() != '}') {
+            throw fmt::format_error("invalid format for UuidView");
+        }
+        return ctx.begin();
+    }
+
+    template <typename FormatContext>
+    auto format(const bt::UuidView& view, FormatContext& ctx) const -> decltype(ctx.out()) {
+        std::array<char, bt::UUID_STR_SIZE> buffer{};
+        const std::string_view str = bt::to_string(view.uuid, buffer);
+        return std::copy(str.begin(), str.end(), ctx.out());
+    }
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
+
+//---------------------------------------------------------------------------
+namespace jutta_bt_proto {
+//---------------------------------------------------------------------------
+/**
+ * Monotonic memory arena for everything loaded from the machine files.
+ * Strings get interned, so each distinct string (e.g. "Normal" or an alert type) is stored only once, no matter how many models use it.
+ * Memory gets allocated in blocks and only released once the arena gets destroyed, so all views handed out stay valid as long as the arena exists.
+ * Thread safe.
+ **/
+class Arena {
+ public:
+    static constexpr size_t BLOCK_SIZE = 16 * 1024;
+
+ private:
+    mutable std::mutex mutex{};
+    std::vector<std::unique_ptr<std::byte[]>> blocks{};
+    std::byte* blockPos{nullptr};
+    std::byte* blockEnd{nullptr};
+    /**
+     * Views into the blocks.
+     **/
+    std::unordered_set<std::string_view> strings{};
+    size_t size{0};
+
+    /**
+     * Returns size bytes aligned to alignment. mutex has to be held.
+     **/
+    std::byte* allocate(size_t size, size_t alignment);
+    const std::byte* store_bytes(const void* data, size_t size, size_t alignment);
+
+ public:
+    Arena() = default;
+    Arena(Arena&&) = delete;
+    Arena(const Arena&) = delete;
+    Arena& operator=(Arena&&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    ~Arena() = default;
+
+    /**
+     * Returns a view of an equal string stored inside the arena. Equal strings result in the same view.
+     **/
+    [[nodiscard]] std::string_view intern(std::string_view str);
+    /**
+     * Copies the given values into the arena. Empty spans do not allocate anything.
+     **/
+    template <typename T>
+        requires std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>
+    [[nodiscard]] std::span<const T> store(std::span<const T> values) {
+        // Blocks are only aligned for fundamental types:
+        static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+        if (values.empty()) {
+            return {};
+        }
+        // NOLINTNEXTLINE (cppcoreguidelines-pro-type-reinterpret-cast)
+        return {reinterpret_cast<const T*>(store_bytes(values.data(), values.size_bytes(), alignof(T))), values.size()};
+    }
+
+    /**
+     * Returns the number of distinct strings stored.
+     **/
+    [[nodiscard]] size_t get_string_count() const;
+    /**
+     * Returns the number of bytes in use, excluding the unused rest of the current block.
+     **/
+    [[nodiscard]] size_t get_size() const;
+};
+//---------------------------------------------------------------------------
+}  // namespace jutta_bt_proto
+//---------------------------------------------------------------------------
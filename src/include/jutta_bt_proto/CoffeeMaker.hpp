@@ -1,13 +1,19 @@
 #pragma once
 
 #include "bt/BLEDevice.hpp"
-#include "date/date.hpp"
+#include "bt/ByteEncDecoder.hpp"
+#include "bt/Uuid.hpp"
 #include "jutta_bt_proto/CoffeeMakerLoader.hpp"
+#include "jutta_bt_proto/MachineRegistry.hpp"
+#include "jutta_bt_proto/ManufacturerData.hpp"
+#include "jutta_bt_proto/ProductCommandCache.hpp"
+#include <array>
 #include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <memory>
 #include <optional>
+#include <span>
 #include <string>
 #include <thread>
 #include <unordered_map>
@@ -50,7 +56,7 @@ enum CoffeeMakerState {
 enum StatParseMode : uint16_t {
     /**
      * Triggers the Joe::productStatisticCountersChangedEventHandler event handler.
-     * It contains a pointer to Joe containing the products with their individual counters.
+     * It contains a pointer to Joe containing the individual counters of the products.
      **/
     PRODUCT_COUNTERS = 1,
     /**
@@ -63,24 +69,28 @@ enum StatParseMode : uint16_t {
     MAINTENANCE_PERCENT = 8
 };
 
-struct ManufacturerData {
-    uint8_t key{0};
-    uint8_t bfMajVer{0};
-    uint8_t bfMinVer{0};
-    uint16_t articleNumber{0};
-    uint16_t machineNumber{0};
-    uint16_t serialNumber{0};
-    date::year_month_day machineProdDate{};
-    date::year_month_day machineProdDateUCHI{};
-    uint8_t unusedSecond{0};
-    uint8_t statusBits{0};
-} __attribute__((aligned(32)));
-
 struct AboutData {
     std::string blueFrogVersion{};
     std::string coffeeMachineVersion{};
 } __attribute__((aligned(64)));
 
+/**
+ * The last raw (still encoded) frame read from a characteristic.
+ * Used for skipping reads that return exactly the same bytes as the previous one.
+ **/
+struct LastFrame {
+    bt::AttributeBuffer data{};
+    size_t size{0};
+    bool valid{false};
+
+    /**
+     * Returns true in case the given frame is byte-identical to the stored one.
+     * Otherwise stores the given frame and returns false.
+     **/
+    bool is_duplicate(std::span<const uint8_t> frame);
+    void reset();
+};
+
 class CoffeeMaker {
  public:
     static const RelevantUUIDs RELEVANT_UUIDS;
@@ -90,24 +100,70 @@ class CoffeeMaker {
     eventpp::CallbackList<void(const ManufacturerData&)> manDataChangedEventHandler;
     eventpp::CallbackList<void(const AboutData&)> aboutDataChangedEventHandler;
     eventpp::CallbackList<void(const std::shared_ptr<Joe>&)> joeChangedEventHandler;
+    /**
+     * Triggered for reads and notifications of characteristics without a parser.
+     * In case no handler is registered, they get logged and dropped.
+     **/
+    eventpp::CallbackList<void(std::span<const uint8_t>, const uuid_t&)> unknownCharacteristicReadEventHandler;
 
  private:
     bt::BLEDevice bleDevice;
     CoffeeMakerState state{CoffeeMakerState::DISCONNECTED};
     std::optional<std::thread> heartbeatThread{std::nullopt};
 
-    const std::unordered_map<size_t, const Machine> machines;
+    /**
+     * Provides the JoeDefinition once the article number is known. Has to outlive this instance.
+     **/
+    MachineRegistry* registry;
 
     std::shared_ptr<Joe> joe{nullptr};
     ManufacturerData manData{};
+    /**
+     * Encoding/decoding tables for the key of the current connection.
+     * Gets rebuilt inside parse_man_data() in case the key changes.
+     **/
+    bt::CodecContext codec{0};
+    /**
+     * Product commands encoded for the current key and machine.
+     * Gets rebuilt inside parse_man_data() once the machine got loaded.
+     **/
+    ProductCommandCache productCommands{};
     AboutData aboutData{};
     std::vector<const Alert*> alerts{};
+    /**
+     * Scratch buffer for parse_machine_status() to prevent reallocating it on every status update.
+     **/
+    std::vector<const Alert*> newAlerts{};
+    /**
+     * Decoded status bits (without the key byte) of the last machine status.
+     * Used for skipping unchanged status updates and finding the raised and cleared alerts.
+     * Gets reset whenever the machine changes.
+     **/
+    bt::AttributeBuffer lastStatusBits{};
+    size_t lastStatusBitsSize{0};
+    /**
+     * Scratch buffers for the alerts of bits that got set or cleared since the last status.
+     **/
+    std::vector<const Alert*> raisedAlerts{};
+    std::vector<const Alert*> clearedAlerts{};
+    /**
+     * Last frames of the characteristics where reading the same bytes again does not change anything.
+     * Not used for the statistics characteristics, since their reads are part of a request/response sequence.
+     * Get reset whenever the machine changes.
+     **/
+    LastFrame lastAboutFrame{};
+    LastFrame lastStatusFrame{};
+    size_t skippedReads{0};
 
     StatParseMode statParserMode{};
     bool statDataReady{false};
 
  public:
+    /**
+     * Uses the machines and definitions of the process wide MachineRegistry.
+     **/
     explicit CoffeeMaker(std::string&& name, std::string&& addr);
+    CoffeeMaker(std::string&& name, std::string&& addr, MachineRegistry& registry);
     CoffeeMaker(CoffeeMaker&&) = default;
     CoffeeMaker(const CoffeeMaker&) = delete;
     CoffeeMaker& operator=(CoffeeMaker&&) = delete;
@@ -130,6 +186,10 @@ class CoffeeMaker {
     [[nodiscard]] const ManufacturerData& get_man_data() const;
     [[nodiscard]] const AboutData& get_about_data() const;
     [[nodiscard]] const std::vector<const Alert*>& get_alerts() const;
+    /**
+     * Returns the number of characteristic reads that got skipped, since they were identical to the previous read.
+     **/
+    [[nodiscard]] size_t get_skipped_reads() const;
     /**
      * Performs a graceful shutdown with rinsing.
      **/
@@ -158,14 +218,21 @@ class CoffeeMaker {
      * Sends the given data to the TX characteristic.
      * Before sending, the data will be encoded.
      **/
-    void write_tx(const std::vector<uint8_t>& data);
+    void write_tx(std::span<const uint8_t> data);
     /**
      * Sends the given string to the TX characteristic.
      * Before sending, the data will be encoded.
      **/
     void write_tx(const std::string& s);
     void request_coffee();
+    /**
+     * Starts the given product with its default options.
+     **/
     void request_coffee(const Product& product);
+    /**
+     * Starts a product with the given command, e.g. a Product::command with adjusted options.
+     **/
+    void request_coffee(const ProductCommand& command);
     /**
      * Requests product or maintenance statistics.
      * On success the appropriate event gets triggered inside Joe.
@@ -189,39 +256,48 @@ class CoffeeMaker {
      **/
     void analyze_man_data();
 
-    void parse_man_data(const std::vector<uint8_t>& data);
-    void parse_about_data(const std::vector<uint8_t>& data);
-    static void parse_product_progress(const std::vector<uint8_t>& data, uint8_t key);
-    void parse_machine_status(const std::vector<uint8_t>& data, uint8_t key);
-    static void parse_rx(const std::vector<uint8_t>& data, uint8_t key);
-    static std::string parse_version(const std::vector<uint8_t>& data, size_t from, size_t to);
-    void parse_statistics_command(const std::vector<uint8_t>& data, uint8_t key);
-    void parse_statistics_data(const std::vector<uint8_t>& data, uint8_t key);
-    void parse_maintainence_counter_data(const std::vector<uint8_t>& data);
-    void parse_maintainence_percent_data(const std::vector<uint8_t>& data);
-    void parse_product_counter_data(const std::vector<uint8_t>& data);
-
-    static size_t get_stat_val(const std::vector<uint8_t>& data, size_t offset, size_t bytesPerVal);
-    void append_prod_stat_bits(std::vector<uint8_t> data) const;
-    /**
-     * Converts the given data to an uint16_t from little-endian.
-     **/
-    static uint16_t to_uint16_t_little_endian(const std::vector<uint8_t>& data, size_t offset);
+    void parse_man_data(std::span<const uint8_t> data);
+    void parse_about_data(std::span<const uint8_t> data);
+    static void parse_product_progress(std::span<const uint8_t> data, const bt::CodecContext& codec);
+    void parse_machine_status(std::span<const uint8_t> data, const bt::CodecContext& codec);
+    static void parse_rx(std::span<const uint8_t> data, const bt::CodecContext& codec);
+    static std::string parse_version(std::span<const uint8_t> data, size_t from, size_t to);
+    void parse_statistics_command(std::span<const uint8_t> data, const bt::CodecContext& codec);
+    void parse_statistics_data(std::span<const uint8_t> data, const bt::CodecContext& codec);
+    void parse_maintainence_counter_data(std::span<const uint8_t> data);
+    void parse_maintainence_percent_data(std::span<const uint8_t> data);
+    void parse_product_counter_data(std::span<const uint8_t> data);
+
     /**
-     * Parses the given data as a date::year_month_day object.
+     * Decodes the given data into the given buffer and returns the part of the buffer holding the decoded data.
      **/
-    static date::year_month_day to_ymd(const std::vector<uint8_t>& data, size_t offset);
+    static std::span<const uint8_t> decode(std::span<const uint8_t> data, const bt::CodecContext& codec, bt::AttributeBuffer& buffer);
+    static size_t get_stat_val(std::span<const uint8_t> data, size_t offset, size_t bytesPerVal);
+    void append_prod_stat_bits(std::vector<uint8_t> data) const;
     /**
      * Writes the given data to the given characteristic.
      * Allows you to specify wether the data should be encoded and the key inside the data should be overriden.
      * Usually you only want to set encode to true.
      **/
-    bool write(const uuid_t& characteristic, const std::vector<uint8_t>& data, bool encode, bool overrideKey);
+    bool write(const uuid_t& characteristic, std::span<const uint8_t> data, bool encode, bool overrideKey);
     /**
      * Event handler that gets triggered when a characteristic got read.
      * data: The data read which might be encoded and has to be decoded.
      **/
-    void on_characteristic_read(const std::vector<uint8_t>& data, const uuid_t& uuid);
+    void on_characteristic_read(std::span<const uint8_t> data, const uuid_t& uuid);
+    /**
+     * Parser for each characteristic we read from, keyed by the 128 bit UUID of the characteristic.
+     * Built once on first use, since the UUIDs are the same for all coffee makers.
+     **/
+    using CharacteristicReadHandler = void (CoffeeMaker::*)(std::span<const uint8_t>);
+    using CharacteristicReadHandlers = std::unordered_map<bt::Uuid128, CharacteristicReadHandler, bt::Uuid128Hash>;
+    static const CharacteristicReadHandlers& get_characteristic_read_handlers();
+    void on_about_read(std::span<const uint8_t> data);
+    void on_machine_status_read(std::span<const uint8_t> data);
+    void on_product_progress_read(std::span<const uint8_t> data);
+    void on_rx_read(std::span<const uint8_t> data);
+    void on_statistics_command_read(std::span<const uint8_t> data);
+    void on_statistics_data_read(std::span<const uint8_t> data);
     /**
      * Event handler that gets triggered when the coffee maker is connected.
      **/
@@ -235,7 +311,7 @@ class CoffeeMaker {
      * Should be the entry point of a new thread.
      **/
     void heartbeat_run();
-    static std::vector<uint8_t> build_stats_cmd(StatParseMode mode);
+    static std::array<uint8_t, 5> build_stats_cmd(StatParseMode mode);
 };
 //---------------------------------------------------------------------------
 }  // namespace jutta_bt_proto
@@ -1,11 +1,16 @@
 #pragma once
 
+#include "jutta_bt_proto/Arena.hpp"
+#include <array>
 #include <cstddef>
 #include <cstdint>
 #include <filesystem>
+#include <istream>
 #include <memory>
 #include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 #include <eventpp/callbacklist.h>
@@ -13,128 +18,374 @@
 //---------------------------------------------------------------------------
 namespace jutta_bt_proto {
 //---------------------------------------------------------------------------
+class MachineSnapshot;
+
+/**
+ * Binary command for starting a product: the key, the product code and one byte per option.
+ **/
+constexpr size_t PRODUCT_COMMAND_SIZE = 18;
+using ProductCommand = std::array<uint8_t, PRODUCT_COMMAND_SIZE>;
+
+/**
+ * Resolves an option argument from the machine file (e.g. "F3") to the offset of its byte inside the ProductCommand.
+ * Returns std::nullopt and logs an error in case the argument is invalid.
+ **/
+std::optional<uint8_t> to_command_offset(std::string_view argument);
+/**
+ * Parses a single hex encoded byte from the machine file (e.g. "0A").
+ * Returns 0 and logs an error in case it is invalid.
+ **/
+uint8_t to_command_byte(std::string_view hex);
+/**
+ * Parses a hex encoded product code from the machine file (e.g. "0A") into an integer.
+ * Returns 0 and logs an error in case it is invalid.
+ **/
+size_t to_product_code(std::string_view hex);
+
+/**
+ * All strings below are views into the Arena the machines and definitions got loaded into, the mapped MachineSnapshot or the embedded tables.
+ * There is one of these structs per machine, product, item and alert of every loaded model,
+ * so they are kept compact and trivially copyable instead of being padded to full cache lines.
+ **/
+
+// NOLINTNEXTLINE (altera-struct-pack-align)
 struct Machine {
     size_t articleNumber;
-    std::string name;
-    std::string fileName;
+    std::string_view name;
+    std::string_view fileName;
     uint8_t version;
 
-    Machine(size_t articleNumber, std::string&& name, std::string&& fileName, uint8_t version) : articleNumber(articleNumber),
-                                                                                                 name(std::move(name)),
-                                                                                                 fileName(std::move(fileName)),
-                                                                                                 version(version){};
-} __attribute__((aligned(128)));
+    Machine(size_t articleNumber, std::string_view name, std::string_view fileName, uint8_t version) : articleNumber(articleNumber),
+                                                                                                       name(name),
+                                                                                                       fileName(fileName),
+                                                                                                       version(version){};
+} __attribute__((aligned(8)));
+static_assert(sizeof(Machine) == 48);
 
+// NOLINTNEXTLINE (altera-struct-pack-align)
 struct Item {
-    std::string name;
-    std::string value;
+    std::string_view name;
+    std::string_view value;
+    /**
+     * value parsed as byte for the ProductCommand.
+     **/
+    uint8_t commandValue;
 
-    Item(std::string&& name, std::string&& value) : name(std::move(name)),
-                                                    value(std::move(value)) {}
-} __attribute__((aligned(64)));
+    Item(std::string_view name, std::string_view value) : name(name),
+                                                          value(value),
+                                                          commandValue(to_command_byte(value)) {}
+} __attribute__((aligned(8)));
+static_assert(sizeof(Item) == 40);
 
+// NOLINTNEXTLINE (altera-struct-pack-align)
 struct ItemsOption {
-    std::string argument;
-    std::string defaultValue;
-    std::vector<Item> items;
+    std::string_view argument;
+    std::string_view defaultValue;
+    /**
+     * Stored inside the same arena as the strings.
+     **/
+    std::span<const Item> items;
+    /**
+     * argument and defaultValue resolved once on load.
+     **/
+    std::optional<uint8_t> commandOffset;
+    uint8_t commandDefaultValue;
 
-    ItemsOption(std::string&& argument, std::string&& defaultValue, std::vector<Item>&& items) : argument(std::move(argument)),
-                                                                                                 defaultValue(std::move(defaultValue)),
-                                                                                                 items(std::move(items)) {}
+    ItemsOption(std::string_view argument, std::string_view defaultValue, std::span<const Item> items) : argument(argument),
+                                                                                                         defaultValue(defaultValue),
+                                                                                                         items(items),
+                                                                                                         commandOffset(to_command_offset(argument)),
+                                                                                                         commandDefaultValue(to_command_byte(defaultValue)) {}
 
-    void to_bt_command(std::vector<std::string>& command) const;
-} __attribute__((aligned(128)));
+    /**
+     * Stores the default value inside the given command.
+     **/
+    void to_bt_command(ProductCommand& command) const;
+    /**
+     * Stores the given item value (see Item::commandValue) inside the given command.
+     **/
+    void to_bt_command(ProductCommand& command, uint8_t value) const;
+} __attribute__((aligned(8)));
+static_assert(sizeof(ItemsOption) == 56);
 
+// NOLINTNEXTLINE (altera-struct-pack-align)
 struct MinMaxOption {
-    std::string argument;
+    std::string_view argument;
     uint8_t value;
     uint8_t min;
     uint8_t max;
     uint8_t step;
 
-    MinMaxOption(std::string&& argument, uint8_t value, uint8_t min, uint8_t max, uint8_t step) : argument(std::move(argument)),
-                                                                                                  value(value),
-                                                                                                  min(min),
-                                                                                                  max(max),
-                                                                                                  step(step) {}
+    /**
+     * argument resolved once on load.
+     **/
+    std::optional<uint8_t> commandOffset;
 
-    void to_bt_command(std::vector<std::string>& command) const;
-} __attribute__((aligned(64)));
+    MinMaxOption(std::string_view argument, uint8_t value, uint8_t min, uint8_t max, uint8_t step) : argument(argument),
+                                                                                                     value(value),
+                                                                                                     min(min),
+                                                                                                     max(max),
+                                                                                                     step(step),
+                                                                                                     commandOffset(to_command_offset(argument)) {}
 
+    /**
+     * Stores the default value inside the given command.
+     **/
+    void to_bt_command(ProductCommand& command) const;
+    /**
+     * Stores the given amount (e.g. the water amount in ml) divided by step inside the given command.
+     **/
+    void to_bt_command(ProductCommand& command, uint8_t amount) const;
+} __attribute__((aligned(8)));
+static_assert(sizeof(MinMaxOption) == 24);
+
+/**
+ * The options a product might have.
+ **/
+enum class ProductOptionType : uint8_t {
+    NONE,
+    STRENGTH,
+    TEMPERATURE,
+    WATER_AMOUNT,
+    MILK_FOAM_AMOUNT
+};
+
+/**
+ * Starts on a cache line. Everything needed for starting a product or reading its statistics is part of this first cache line,
+ * the options only get touched when changing them.
+ **/
 struct Product {
-    std::string name;
-    std::string code;
+    /**
+     * code parsed once on load.
+     **/
+    size_t codeValue;
+    /**
+     * Command for starting the product with its default options.
+     * Compiled once on load, so starting a product does not require any parsing.
+     **/
+    ProductCommand command{};
+    /**
+     * The option stored at each byte offset of the command.
+     **/
+    std::array<ProductOptionType, PRODUCT_COMMAND_SIZE> optionsByOffset{};
+    std::string_view name;
 
+    std::string_view code;
     std::optional<ItemsOption> strength;
     std::optional<ItemsOption> temperature;
     std::optional<MinMaxOption> waterAmount;
     std::optional<MinMaxOption> milkFoamAmount;
 
-    size_t statCounter{0};
-
-    Product(std::string&& name, std::string&& code, std::optional<ItemsOption>&& strength, std::optional<ItemsOption>&& temperature, std::optional<MinMaxOption>&& waterAmount, std::optional<MinMaxOption> milkFoamAmount) : name(std::move(name)),
-                                                                                                                                                                                                                              code(std::move(code)),
-                                                                                                                                                                                                                              strength(std::move(strength)),
-                                                                                                                                                                                                                              temperature(std::move(temperature)),
-                                                                                                                                                                                                                              waterAmount(std::move(waterAmount)),
-                                                                                                                                                                                                                              milkFoamAmount(std::move(milkFoamAmount)) {}
+    Product(std::string_view name, std::string_view code, std::optional<ItemsOption> strength, std::optional<ItemsOption> temperature, std::optional<MinMaxOption> waterAmount, std::optional<MinMaxOption> milkFoamAmount) : codeValue(to_product_code(code)),
+                                                                                                                                                                                                                              name(name),
+                                                                                                                                                                                                                              code(code),
+                                                                                                                                                                                                                              strength(strength),
+                                                                                                                                                                                                                              temperature(temperature),
+                                                                                                                                                                                                                              waterAmount(waterAmount),
+                                                                                                                                                                                                                              milkFoamAmount(milkFoamAmount) {
+        compile_bt_command();
+    }
 
+    /**
+     * Returns the command with the default options as hex string.
+     **/
     [[nodiscard]] std::string to_bt_command() const;
+    /**
+     * Returns the precomputed codeValue.
+     **/
     [[nodiscard]] size_t code_to_size_t() const;
-} __attribute__((aligned(128)));
+    /**
+     * Returns the option stored at the given byte offset of the command or nullptr in case there is none of this kind.
+     **/
+    [[nodiscard]] const ItemsOption* find_items_option(size_t offset) const;
+    [[nodiscard]] const MinMaxOption* find_min_max_option(size_t offset) const;
 
+ private:
+    void compile_bt_command();
+} __attribute__((aligned(64)));
+static_assert(offsetof(Product, name) + sizeof(Product::name) <= 64);
+
+// NOLINTNEXTLINE (altera-struct-pack-align)
 struct Alert {
+    /**
+     * Highest bit the machine status can carry: Its characteristic holds up to bt::MAX_ATTRIBUTE_SIZE (512) bytes, the first of them being the key.
+     **/
+    static constexpr size_t MAX_BIT = ((512 - 1) * 8) - 1;
+
     size_t bit;
-    std::string name;
-    std::string type;
+    std::string_view name;
+    std::string_view type;
 
-    Alert(size_t bit, std::string&& name, std::string&& type) : bit(bit),
-                                                                name(std::move(name)),
-                                                                type(std::move(type)) {}
-} __attribute__((aligned(128)));
+    Alert(size_t bit, std::string_view name, std::string_view type) : bit(bit),
+                                                                      name(name),
+                                                                      type(type) {}
+} __attribute__((aligned(8)));
+static_assert(sizeof(Alert) == 40);
 
+// NOLINTNEXTLINE (altera-struct-pack-align)
 struct MaintenanceCounter {
-    std::string name;
+    std::string_view name;
     uint16_t count;
 
-    MaintenanceCounter(std::string&& name, uint16_t count) : name(std::move(name)),
-                                                             count(count) {}
-} __attribute__((aligned(64)));
+    MaintenanceCounter(std::string_view name, uint16_t count) : name(name),
+                                                                count(count) {}
+} __attribute__((aligned(8)));
+static_assert(sizeof(MaintenanceCounter) == 24);
 
+// NOLINTNEXTLINE (altera-struct-pack-align)
 struct MaintenancePercentage {
-    std::string name;
+    std::string_view name;
     uint8_t percent;
 
-    MaintenancePercentage(std::string&& name, uint8_t percent) : name(std::move(name)),
-                                                                 percent(percent) {}
-} __attribute__((aligned(64)));
+    MaintenancePercentage(std::string_view name, uint8_t percent) : name(name),
+                                                                    percent(percent) {}
+} __attribute__((aligned(8)));
+static_assert(sizeof(MaintenancePercentage) == 24);
 
-struct Joe {
-    std::string dated;
-    const Machine* machine;
+/**
+ * Everything known about a coffee maker model from its machine file.
+ * Immutable once loaded, so it gets shared by all coffee makers with the same article number (see MachineRegistry).
+ **/
+struct JoeDefinition {
+    /**
+     * Owns the memory all strings and items of this definition point into.
+     * Usually shared with the definitions of other models, so strings used by multiple models are only stored once.
+     * Might be nullptr in case all of them point to static storage.
+     **/
+    std::shared_ptr<const Arena> arena;
+    /**
+     * The mapped snapshot the strings point into in case it got loaded from one, nullptr otherwise.
+     **/
+    std::shared_ptr<const MachineSnapshot> snapshot;
+    std::string_view dated;
+    std::shared_ptr<const Machine> machine;
     std::vector<Product> products;
+    /**
+     * codeValue of each product in the same order as products.
+     * Kept separately, so loops over all products (e.g. when parsing the statistics) only touch a single dense array.
+     **/
+    std::vector<size_t> productCodes;
     std::vector<Alert> alerts;
+    /**
+     * The maintenance counters and percentages the coffee maker reports. All values are 0.
+     **/
     std::vector<MaintenanceCounter> maintenanceCounters;
     std::vector<MaintenancePercentage> maintenancePercentages;
 
+ private:
+    /**
+     * Lookup indexes into products and alerts. Built once on construction.
+     * Names are views into the arena, which never gets modified after construction.
+     **/
+    std::unordered_map<size_t, size_t> productsByCode;
+    std::unordered_map<std::string_view, size_t> productsByName;
+    /**
+     * Dense bit -> alerts table in compressed sparse row layout:
+     * The alerts for bit b are alertsByBit[alertBitOffsets[b]] up to alertsByBit[alertBitOffsets[b + 1]].
+     * Bits without alerts take up a single offset entry.
+     **/
+    std::vector<uint32_t> alertBitOffsets;
+    std::vector<const Alert*> alertsByBit;
+
+ public:
+    JoeDefinition(std::shared_ptr<const Arena> arena, std::string_view dated, std::shared_ptr<const Machine> machine, std::vector<Product>&& products, std::vector<Alert>&& alerts, std::vector<MaintenanceCounter>&& maintenanceCounters, std::vector<MaintenancePercentage>&& maintenancePercentages, std::shared_ptr<const MachineSnapshot> snapshot = nullptr) : arena(std::move(arena)),
+                                                                                                                                                                                                                                                                                                                                                                     snapshot(std::move(snapshot)),
+                                                                                                                                                                                                                                                                                                                                                                     dated(dated),
+                                                                                                                                                                                                                                                                                                                                                                     machine(std::move(machine)),
+                                                                                                                                                                                                                                                                                                                                                                     products(std::move(products)),
+                                                                                                                                                                                                                                                                                                                                                                     alerts(std::move(alerts)),
+                                                                                                                                                                                                                                                                                                                                                                     maintenanceCounters(std::move(maintenanceCounters)),
+                                                                                                                                                                                                                                                                                                                                                                     maintenancePercentages(std::move(maintenancePercentages)) {
+        build_indexes();
+    }
+    // The indexes refer to the products, so do not allow to copy or move:
+    JoeDefinition(const JoeDefinition&) = delete;
+    JoeDefinition(JoeDefinition&&) = delete;
+    JoeDefinition& operator=(const JoeDefinition&) = delete;
+    JoeDefinition& operator=(JoeDefinition&&) = delete;
+    ~JoeDefinition() = default;
+
+    /**
+     * Return nullptr in case no matching product or alert exists.
+     **/
+    [[nodiscard]] const Product* find_product_by_code(size_t code) const;
+    [[nodiscard]] const Product* find_product_by_name(std::string_view name) const;
+    [[nodiscard]] const Alert* find_alert_by_bit(size_t bit) const;
+    /**
+     * Returns all alerts for the given bit. Might be empty.
+     **/
+    [[nodiscard]] std::span<const Alert* const> find_alerts_by_bit(size_t bit) const;
+    /**
+     * Appends the alerts for all set bits to result in ascending bit order.
+     * statusBits is the decoded machine status without its first (key) byte. Bits are counted MSB first.
+     **/
+    void find_alerts(std::span<const uint8_t> statusBits, std::vector<const Alert*>& result) const;
+    /**
+     * Appends the alerts for all bits that differ between lastStatusBits and statusBits in ascending bit order.
+     * Alerts for bits set in statusBits get appended to raised, the others to cleared.
+     * Bytes missing from the shorter one count as zero, so passing an empty lastStatusBits raises the alerts of all set bits.
+     **/
+    void find_changed_alerts(std::span<const uint8_t> lastStatusBits, std::span<const uint8_t> statusBits, std::vector<const Alert*>& raised, std::vector<const Alert*>& cleared) const;
+
+ private:
+    void build_indexes();
+} __attribute__((aligned(128)));
+
+/**
+ * State of a single connection to a coffee maker, on top of the shared JoeDefinition of its model.
+ * Gets created for each connection, so nothing in here outlives it.
+ **/
+struct Joe {
+    std::shared_ptr<const JoeDefinition> definition;
+
+    /**
+     * Statistic counter of each product. Same order as definition->products.
+     **/
+    std::vector<size_t> productStatCounters;
     size_t statTotalCount{0};
+    std::vector<MaintenanceCounter> maintenanceCounters;
+    std::vector<MaintenancePercentage> maintenancePercentages;
 
     // Events:
     eventpp::CallbackList<void(const std::vector<const Alert*>&)> alertsChangedEventHandler;
+    /**
+     * Triggered once for each alert that got raised or cleared since the last machine status.
+     * In contrast to alertsChangedEventHandler, only the alerts that actually changed get reported.
+     **/
+    eventpp::CallbackList<void(const Alert&)> alertRaisedEventHandler;
+    eventpp::CallbackList<void(const Alert&)> alertClearedEventHandler;
     eventpp::CallbackList<void(const std::shared_ptr<Joe>&)> productStatisticCountersChangedEventHandler;
     eventpp::CallbackList<void(const std::vector<MaintenanceCounter>&)> maintenanceCountersChangedEventHandler;
     eventpp::CallbackList<void(const std::vector<MaintenancePercentage>&)> maintenancePercentagesChangedEventHandler;
 
-    Joe(std::string&& dated, const Machine* machine, std::vector<Product>&& products, std::vector<Alert>&& alerts, std::vector<MaintenanceCounter>&& maintenanceCounters, std::vector<MaintenancePercentage>&& maintenancePercentages) : dated(std::move(dated)),
-                                                                                                                                                                                                                                         machine(machine),
-                                                                                                                                                                                                                                         products(std::move(products)),
-                                                                                                                                                                                                                                         alerts(std::move(alerts)),
-                                                                                                                                                                                                                                         maintenanceCounters(std::move(maintenanceCounters)),
-                                                                                                                                                                                                                                         maintenancePercentages(std::move(maintenancePercentages)) {}
+    explicit Joe(std::shared_ptr<const JoeDefinition> definition);
+
+    /**
+     * Returns the statistic counter of the given product, which has to be part of definition->products.
+     **/
+    [[nodiscard]] size_t get_stat_counter(const Product& product) const;
 } __attribute__((aligned(128)));
 
-std::unordered_map<size_t, const Machine> load_machines(const std::filesystem::path& path);
-std::shared_ptr<Joe> load_joe(const Machine* machine);
+/**
+ * All known machines indexed by their article number.
+ **/
+using Machines = std::unordered_map<size_t, const Machine>;
+
+/**
+ * Parses JOE_MACHINES.TXT. The names of the machines get interned into the given arena, which has to outlive the result.
+ **/
+Machines load_machines(const std::filesystem::path& path, Arena& arena);
+/**
+ * Parses the machine file of the given machine from the given directory.
+ * All strings get interned into the given arena, which the result keeps alive. In case it is nullptr, a new one gets created for this definition only.
+ * Returns nullptr and logs the reason in case the file does not exist or is malformed.
+ * Use MachineRegistry::get_joe_definition() to share the result with other coffee makers of the same model.
+ **/
+std::shared_ptr<const JoeDefinition> load_joe(std::shared_ptr<const Machine> machine, const std::filesystem::path& directory = "machinefiles", std::shared_ptr<Arena> arena = nullptr);
+/**
+ * Same as above, but parses the machine file from the given stream. name is only used for logging.
+ **/
+std::shared_ptr<const JoeDefinition> load_joe(std::shared_ptr<const Machine> machine, std::istream& in, std::string_view name, std::shared_ptr<Arena> arena = nullptr);
 //---------------------------------------------------------------------------
 }  // namespace jutta_bt_proto
 //---------------------------------------------------------------------------
\ No newline at end of file
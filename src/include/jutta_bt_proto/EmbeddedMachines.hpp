@@ -0,0 +1,114 @@
+#pragma once
+
+#include "jutta_bt_proto/CoffeeMakerLoader.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+
+//---------------------------------------------------------------------------
+namespace jutta_bt_proto {
+//---------------------------------------------------------------------------
+/**
+ * Constant tables of JOE_MACHINES.TXT and the machine files it references, compiled into the library.
+ * With JUTTA_BT_PROTO_EMBED_MACHINES enabled, the build generates them from src/resources/machinefiles (see jutta_machine_codegen).
+ * The generated header (jutta_bt_proto/EmbeddedMachineFiles.hpp) holds one Definition per machine file inside embedded::machines named after the file.
+ * Referring to a single one of them only links this model, while get_embedded_machines() links all of them.
+ **/
+namespace embedded {
+struct Item {
+    std::string_view name;
+    std::string_view value;
+};
+
+struct ItemsOption {
+    std::string_view argument;
+    std::string_view defaultValue;
+    std::span<const Item> items;
+};
+
+struct MinMaxOption {
+    std::string_view argument;
+    uint8_t value;
+    uint8_t min;
+    uint8_t max;
+    uint8_t step;
+};
+
+struct Product {
+    std::string_view name;
+    std::string_view code;
+    /**
+     * nullptr in case the product does not have this option.
+     **/
+    const ItemsOption* strength;
+    const ItemsOption* temperature;
+    const MinMaxOption* waterAmount;
+    const MinMaxOption* milkFoamAmount;
+};
+
+struct Alert {
+    size_t bit;
+    std::string_view name;
+    std::string_view type;
+};
+
+struct Definition {
+    std::string_view fileName;
+    std::string_view dated;
+    std::span<const Product> products;
+    std::span<const Alert> alerts;
+    std::span<const std::string_view> maintenanceCounters;
+    std::span<const std::string_view> maintenancePercentages;
+};
+
+/**
+ * Sorted by article number.
+ **/
+struct Machine {
+    size_t articleNumber;
+    std::string_view name;
+    std::string_view fileName;
+    uint8_t version;
+    /**
+     * nullptr in case the machine file was not found.
+     **/
+    const Definition* definition;
+};
+}  // namespace embedded
+
+/**
+ * Returns all embedded machines sorted by article number.
+ * Empty in case the library got built without JUTTA_BT_PROTO_EMBED_MACHINES.
+ **/
+[[nodiscard]] std::span<const embedded::Machine> get_embedded_machines();
+/**
+ * Returns the embedded machine with the given article number or nullptr in case there is none.
+ **/
+[[nodiscard]] const embedded::Machine* find_embedded_machine(size_t articleNumber);
+/**
+ * Creates the machines from the given embedded ones. Their names point to the embedded tables.
+ **/
+[[nodiscard]] Machines to_machines(std::span<const embedded::Machine> machines);
+/**
+ * Creates the definition for the given machine from the given embedded definition without any I/O or XML parsing.
+ * Strings point to the embedded tables, only the items of the product options get copied into a small arena.
+ **/
+std::shared_ptr<const JoeDefinition> load_joe(std::shared_ptr<const Machine> machine, const embedded::Definition& definition);
+
+/**
+ * Namespace of the tables generated for the library with JUTTA_BT_PROTO_EMBED_MACHINES.
+ **/
+constexpr std::string_view EMBEDDED_MACHINES_NAMESPACE = "jutta_bt_proto::embedded::machines";
+
+/**
+ * Returns the C++ header with the embedded tables for the given machines and definitions, as included by the library with JUTTA_BT_PROTO_EMBED_MACHINES.
+ * definitions holds one definition per machine file. Machines without a definition are embedded without one.
+ * nameSpace has to be nested inside jutta_bt_proto::embedded, so the tables find their types.
+ **/
+[[nodiscard]] std::string to_embedded_header(const Machines& machines, std::span<const std::shared_ptr<const JoeDefinition>> definitions, std::string_view nameSpace = EMBEDDED_MACHINES_NAMESPACE);
+//---------------------------------------------------------------------------
+}  // namespace jutta_bt_proto
+//---------------------------------------------------------------------------
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "bt/ByteEncDecoder.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+//---------------------------------------------------------------------------
+namespace jutta_bt_proto {
+//---------------------------------------------------------------------------
+/**
+ * A command encoded for each of the 256 possible keys.
+ * Index it with the key to get the ready to send frame.
+ **/
+template <size_t N>
+using EncodedFrames = std::array<std::array<uint8_t, N>, 256>;
+
+/**
+ * Encodes the given command for all 256 possible keys at compile time.
+ * Same as CoffeeMaker::write() with encode set and overrideKey unset, the first byte gets replaced with the key before encoding.
+ **/
+template <size_t N>
+consteval EncodedFrames<N> pre_encode(std::array<uint8_t, N> command) {
+    EncodedFrames<N> result{};
+    for (size_t key = 0; key < result.size(); key++) {
+        command[0] = static_cast<uint8_t>(key);
+        result[key] = bt::encDecArray(command, static_cast<uint8_t>(key));
+    }
+    return result;
+}
+
+/**
+ * Commands sent to the P Mode characteristic.
+ **/
+constexpr std::array<uint8_t, 3> STAY_IN_BLE_COMMAND{0x00, 0x7F, 0x80};
+constexpr std::array<uint8_t, 3> DISCONNECT_COMMAND{0x00, 0x7F, 0x81};
+constexpr std::array<uint8_t, 3> SHUTDOWN_COMMAND{0x00, 0x46, 0x02};
+
+/**
+ * Commands sent to the Barista Mode characteristic.
+ **/
+constexpr std::array<uint8_t, 2> LOCK_COMMAND{0x00, 0x01};
+constexpr std::array<uint8_t, 2> UNLOCK_COMMAND{0x00, 0x00};
+
+inline constexpr EncodedFrames<3> STAY_IN_BLE_FRAMES = pre_encode(STAY_IN_BLE_COMMAND);
+inline constexpr EncodedFrames<3> DISCONNECT_FRAMES = pre_encode(DISCONNECT_COMMAND);
+inline constexpr EncodedFrames<3> SHUTDOWN_FRAMES = pre_encode(SHUTDOWN_COMMAND);
+inline constexpr EncodedFrames<2> LOCK_FRAMES = pre_encode(LOCK_COMMAND);
+inline constexpr EncodedFrames<2> UNLOCK_FRAMES = pre_encode(UNLOCK_COMMAND);
+//---------------------------------------------------------------------------
+}  // namespace jutta_bt_proto
+//---------------------------------------------------------------------------
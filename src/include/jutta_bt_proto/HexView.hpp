@@ -0,0 +1,52 @@
+#pragma once
+
+#include "jutta_bt_proto/Utils.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <spdlog/fmt/fmt.h>
+
+//---------------------------------------------------------------------------
+namespace jutta_bt_proto {
+//---------------------------------------------------------------------------
+/**
+ * Non owning wrapper for formatting bytes as upper case hex with fmt/spdlog.
+ * In contrast to to_hex_string(), the conversion only happens once the message actually gets formatted.
+ * So passing it to a log macro with a disabled log level costs nothing.
+ * Example: SPDLOG_TRACE("Wrote: {}", HexView(data));
+ **/
+struct HexView {
+    std::span<const uint8_t> data;
+
+    explicit HexView(std::span<const uint8_t> data) : data(data) {}
+} __attribute__((aligned(16)));
+//---------------------------------------------------------------------------
+}  // namespace jutta_bt_proto
+//---------------------------------------------------------------------------
+
+template <>
+struct fmt::formatter<jutta_bt_proto::HexView> {
+    // NOLINTNEXTLINE (readability-convert-member-functions-to-static)
+    constexpr auto parse(fmt::format_parse_context& ctx) -> decltype(ctx.begin()) {
+        if (ctx.begin() != ctx.end() && *ctx.begin() != '}') {
+            throw fmt::format_error("invalid format for HexView");
+        }
+        return ctx.begin();
+    }
+
+    template <typename FormatContext>
+    auto format(const jutta_bt_proto::HexView& view, FormatContext& ctx) const -> decltype(ctx.out()) {
+        // Convert in chunks on the stack to avoid allocating:
+        constexpr size_t CHUNK_SIZE = 64;
+        std::array<char, CHUNK_SIZE * 2> buffer{};
+        auto out = ctx.out();
+        for (size_t i = 0; i < view.data.size(); i += CHUNK_SIZE) {
+            const std::span<const uint8_t> chunk = view.data.subspan(i, std::min(CHUNK_SIZE, view.data.size() - i));
+            [[maybe_unused]] const jutta_bt_proto::HexResult result = jutta_bt_proto::to_hex(chunk, buffer);
+            out = std::copy_n(buffer.begin(), chunk.size() * 2, out);
+        }
+        return out;
+    }
+};
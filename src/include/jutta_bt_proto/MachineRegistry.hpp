@@ -0,0 +1,189 @@
+#pragma once
+
+#include "jutta_bt_proto/Arena.hpp"
+#include "jutta_bt_proto/CoffeeMakerLoader.hpp"
+#include "jutta_bt_proto/MachineSnapshot.hpp"
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+//---------------------------------------------------------------------------
+namespace jutta_bt_proto {
+//---------------------------------------------------------------------------
+/**
+ * Outcome of preloading the definition of a single machine (see MachineRegistry::preload()).
+ **/
+struct PreloadResult {
+    size_t articleNumber;
+    std::string fileName;
+    /**
+     * Time it took to load the definition on the worker thread.
+     **/
+    std::chrono::microseconds duration;
+    bool fromSnapshot;
+    bool success;
+} __attribute__((aligned(64)));
+
+/**
+ * Process wide registry of the machines listed in the machine file (JOE_MACHINES.TXT) and their definitions.
+ * The file gets parsed once on first use and the result is shared by all CoffeeMaker instances.
+ * The machine file (XML) of each model gets parsed once the first coffee maker of this model connects and is shared with all others.
+ * In case an up to date snapshot (see MachineSnapshot) exists next to the machine file, machines and definitions get loaded from it instead.
+ * In case the library got built with JUTTA_BT_PROTO_EMBED_MACHINES and the path did not get changed, the embedded machines get used without touching any files.
+ * The machines and definitions are immutable, so references handed out stay valid as long as the caller holds on to the std::shared_ptr, even after a reload.
+ * All machines loaded together and their definitions share an arena, so strings used by multiple models (e.g. "Normal" or alert types) are only stored once.
+ * Each (re)load of the machines starts a new arena, so the previous one gets freed once the last coffee maker released its machines and definitions.
+ * Changed machine files can be published while running with refresh_machines() and refresh_joe_definitions() (see MachineWatcher).
+ * Thread safe.
+ **/
+class MachineRegistry {
+ private:
+    mutable std::mutex mutex{};
+    std::filesystem::path path{DEFAULT_PATH};
+    std::shared_ptr<const Machines> machines{nullptr};
+    std::shared_ptr<const MachineSnapshot> snapshot{nullptr};
+    bool embedded{false};
+    /**
+     * Arena of the current machines and the definitions loaded for them. Gets replaced together with machines.
+     **/
+    std::shared_ptr<Arena> arena{std::make_shared<Arena>()};
+
+    /**
+     * Guarded by their own mutex, so parsing a machine file does not block looking up machines.
+     **/
+    mutable std::mutex definitionsMutex{};
+    std::unordered_map<size_t, std::shared_ptr<const JoeDefinition>> definitions{};
+    /**
+     * Incremented whenever the cached definitions get dropped or replaced.
+     * Definitions are parsed without holding any lock, so they only get cached in case it did not change since they started loading.
+     * Guarded by definitionsMutex.
+     **/
+    size_t generation{0};
+
+ public:
+    static constexpr const char* DEFAULT_PATH = "machinefiles/JOE_MACHINES.TXT";
+
+    MachineRegistry() = default;
+    explicit MachineRegistry(std::filesystem::path path);
+    MachineRegistry(MachineRegistry&&) = delete;
+    MachineRegistry(const MachineRegistry&) = delete;
+    MachineRegistry& operator=(MachineRegistry&&) = delete;
+    MachineRegistry& operator=(const MachineRegistry&) = delete;
+    ~MachineRegistry() = default;
+
+    /**
+     * Returns the registry used by all CoffeeMaker instances.
+     **/
+    static MachineRegistry& get_instance();
+
+    /**
+     * Changes the path of the machine file. The XML machine files are expected in the same directory.
+     * In case it differs from the current one, the machines and definitions get loaded again from the new location on next access.
+     **/
+    void set_path(std::filesystem::path path);
+    [[nodiscard]] std::filesystem::path get_path() const;
+    /**
+     * Returns all known machines. Loads them in case this is the first call since construction or since the path changed.
+     **/
+    [[nodiscard]] std::shared_ptr<const Machines> get_machines();
+    /**
+     * Parses the machine file again, e.g. to load them eagerly on startup, and returns the result.
+     * Drops all cached definitions.
+     **/
+    std::shared_ptr<const Machines> reload();
+    /**
+     * Returns true in case the machines have been loaded.
+     **/
+    [[nodiscard]] bool is_loaded() const;
+    /**
+     * Returns the snapshot the machines got loaded from or nullptr in case they got loaded from the machine files.
+     **/
+    [[nodiscard]] std::shared_ptr<const MachineSnapshot> get_snapshot();
+    /**
+     * Returns true in case the machines got loaded from the embedded machine files (see get_embedded_machines()).
+     **/
+    [[nodiscard]] bool is_embedded();
+    /**
+     * Returns the arena the current machines and their definitions are stored in, e.g. for reporting its size.
+     **/
+    [[nodiscard]] std::shared_ptr<const Arena> get_arena() const;
+
+    /**
+     * Returns the machine with the given article number or nullptr in case it is unknown.
+     * The machine shares ownership with all machines loaded together with it.
+     **/
+    [[nodiscard]] std::shared_ptr<const Machine> get_machine(size_t articleNumber);
+    /**
+     * Returns the definition for the machine with the given article number or nullptr in case the machine or its machine file is unknown.
+     * Only the first call per article number parses the machine file, all further calls return the cached definition.
+     * Concurrent first calls for the same article number might parse it more than once, but all of them return the same definition.
+     **/
+    [[nodiscard]] std::shared_ptr<const JoeDefinition> get_joe_definition(size_t articleNumber);
+    /**
+     * Drops all cached definitions, so they get parsed again on next access.
+     **/
+    void clear_joe_definitions();
+    /**
+     * Returns the number of cached definitions.
+     **/
+    [[nodiscard]] size_t get_joe_definition_count() const;
+    /**
+     * Loads the definitions of all known machines, which are not cached yet, on up to threadCount threads and waits for them.
+     * Meant to be called once on startup, so the first connect of each model does not have to wait for its machine file getting parsed.
+     * Each thread stores the strings of the definitions it loaded inside an arena of its own, so the threads do not serialize on a shared one.
+     * Returns one result per loaded machine and logs the load time of each.
+     **/
+    std::vector<PreloadResult> preload(size_t threadCount = std::thread::hardware_concurrency());
+
+    /**
+     * Parses the machine file and the machine files (XML) of all cached definitions again and publishes them in case all of them are valid.
+     * Parsing happens without holding any lock, so lookups keep getting served from the previous machines and definitions in the meantime.
+     * Definitions handed out before stay untouched, so coffee makers only move to the new ones on their next connect.
+     * Returns false and keeps everything as it is in case parsing or validating failed or the machines are embedded.
+     **/
+    bool refresh_machines();
+    /**
+     * Same as refresh_machines(), but only for the cached definitions using the given machine file (e.g. "EF532V2").
+     * Definitions of this machine file, which are not cached yet, get parsed from the changed file on first access.
+     **/
+    bool refresh_joe_definitions(std::string_view fileName);
+
+ private:
+    /**
+     * Loads the machines from the embedded machine files, the snapshot or in case there is no valid one, from the machine file.
+     * mutex has to be held.
+     **/
+    void load();
+    /**
+     * Loads the definition for the given machine from the embedded machine files, the snapshot or its machine file without caching it.
+     * Returns nullptr in case none of them contains it.
+     **/
+    [[nodiscard]] std::shared_ptr<const JoeDefinition> load_joe_definition(std::shared_ptr<const Machine> machine, bool& fromSnapshot);
+    [[nodiscard]] std::shared_ptr<Arena> get_current_arena() const;
+    /**
+     * Same as above, but from the given snapshot (might be nullptr) or the machine files inside the given directory only.
+     * Strings get stored inside the given arena.
+     **/
+    [[nodiscard]] static std::shared_ptr<const JoeDefinition> load_joe_definition(std::shared_ptr<const Machine> machine, const std::shared_ptr<const MachineSnapshot>& snapshot, const std::filesystem::path& directory, const std::shared_ptr<Arena>& arena, bool& fromSnapshot);
+    /**
+     * Caches the given definition unless another one got cached for the same article number in the meantime and returns the cached one.
+     * Returns nullptr without caching it in case generation changed since loadGeneration, since it might have been loaded from outdated machines or files.
+     **/
+    [[nodiscard]] std::shared_ptr<const JoeDefinition> cache_joe_definition(std::shared_ptr<const JoeDefinition> definition, size_t loadGeneration);
+};
+
+/**
+ * Returns true in case the given definition can be served to coffee makers.
+ * Checks that it has products, their codes are unique and the values of their options are in range. Logs the reason otherwise.
+ **/
+[[nodiscard]] bool validate_joe_definition(const JoeDefinition& definition);
+//---------------------------------------------------------------------------
+}  // namespace jutta_bt_proto
+//---------------------------------------------------------------------------
@@ -0,0 +1,249 @@
+#pragma once
+
+#include "jutta_bt_proto/Arena.hpp"
+#include "jutta_bt_proto/CoffeeMakerLoader.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
+//---------------------------------------------------------------------------
+namespace jutta_bt_proto {
+//---------------------------------------------------------------------------
+/**
+ * Binary snapshot of JOE_MACHINES.TXT and all machine files (XML) it references.
+ * The snapshot is a single file of flat tables, which refer to each other by index and to the strings by offset into a shared string pool.
+ * All values are stored in native byte order, so snapshots are only valid on hosts with the same byte order as the one that created them.
+ * Equal strings are stored only once and machines using the same machine file share a single definition.
+ **/
+namespace snapshot {
+constexpr std::array<char, 4> MAGIC{'J', 'B', 'T', 'S'};
+/**
+ * Has to be increased whenever the layout of any of the records below changes.
+ **/
+constexpr uint32_t VERSION = 1;
+/**
+ * Marks an absent option or definition.
+ **/
+constexpr uint32_t NONE = UINT32_MAX;
+
+struct StringRef {
+    uint32_t offset;
+    uint32_t size;
+};
+static_assert(sizeof(StringRef) == 8);
+
+struct Table {
+    uint32_t offset;
+    uint32_t count;
+};
+static_assert(sizeof(Table) == 8);
+
+struct Header {
+    std::array<char, 4> magic;
+    uint32_t version;
+    /**
+     * 64 bit FNV-1a hash of everything following the header.
+     **/
+    uint64_t checksum;
+    uint64_t size;
+    Table strings;
+    Table sources;
+    Table machines;
+    Table definitions;
+    Table products;
+    Table itemsOptions;
+    Table items;
+    Table minMaxOptions;
+    Table alerts;
+    Table names;
+};
+static_assert(sizeof(Header) == 104);
+
+/**
+ * A file the snapshot got created from. Used for detecting stale snapshots.
+ **/
+struct Source {
+    /**
+     * File name only. The file is expected inside the directory of the snapshot.
+     **/
+    StringRef name;
+    uint64_t size;
+    /**
+     * std::filesystem::last_write_time() since epoch.
+     **/
+    int64_t modified;
+};
+static_assert(sizeof(Source) == 24);
+
+/**
+ * Sorted by article number.
+ **/
+struct Machine {
+    uint32_t articleNumber;
+    uint32_t version;
+    StringRef name;
+    StringRef fileName;
+    /**
+     * Index into the definitions table or NONE in case the machine file was not found.
+     **/
+    uint32_t definition;
+    uint32_t reserved;
+};
+static_assert(sizeof(Machine) == 32);
+
+struct Definition {
+    StringRef dated;
+    Table products;
+    Table alerts;
+    /**
+     * Ranges of the names table.
+     **/
+    Table maintenanceCounters;
+    Table maintenancePercentages;
+};
+static_assert(sizeof(Definition) == 40);
+
+struct Product {
+    StringRef name;
+    StringRef code;
+    /**
+     * Indexes into the items options table or NONE.
+     **/
+    uint32_t strength;
+    uint32_t temperature;
+    /**
+     * Indexes into the min max options table or NONE.
+     **/
+    uint32_t waterAmount;
+    uint32_t milkFoamAmount;
+};
+static_assert(sizeof(Product) == 32);
+
+struct ItemsOption {
+    StringRef argument;
+    StringRef defaultValue;
+    Table items;
+};
+static_assert(sizeof(ItemsOption) == 24);
+
+struct Item {
+    StringRef name;
+    StringRef value;
+};
+static_assert(sizeof(Item) == 16);
+
+struct MinMaxOption {
+    StringRef argument;
+    uint8_t value;
+    uint8_t min;
+    uint8_t max;
+    uint8_t step;
+};
+static_assert(sizeof(MinMaxOption) == 12);
+
+struct Alert {
+    uint32_t bit;
+    StringRef name;
+    StringRef type;
+};
+static_assert(sizeof(Alert) == 20);
+}  // namespace snapshot
+
+/**
+ * Returns the path of the snapshot belonging to the given JOE_MACHINES.TXT (e.g. machinefiles/JOE_MACHINES.snapshot).
+ **/
+[[nodiscard]] std::filesystem::path to_snapshot_path(const std::filesystem::path& machinesPath);
+
+/**
+ * Read only view of a snapshot mapped into memory.
+ * All accessors return views into the mapped file and are only valid as long as the snapshot exists.
+ * Thread safe, since it never changes once opened.
+ **/
+class MachineSnapshot : public std::enable_shared_from_this<MachineSnapshot> {
+ private:
+    const uint8_t* data{nullptr};
+    size_t size{0};
+    const snapshot::Header* header{nullptr};
+
+    MachineSnapshot(const uint8_t* data, size_t size);
+
+    template <typename T>
+    [[nodiscard]] std::span<const T> get_table(const snapshot::Table& table) const;
+    template <typename T>
+    [[nodiscard]] std::span<const T> get_range(const snapshot::Table& table, const snapshot::Table& range) const;
+    [[nodiscard]] bool is_valid() const;
+
+ public:
+    MachineSnapshot(MachineSnapshot&&) = delete;
+    MachineSnapshot(const MachineSnapshot&) = delete;
+    MachineSnapshot& operator=(MachineSnapshot&&) = delete;
+    MachineSnapshot& operator=(const MachineSnapshot&) = delete;
+    ~MachineSnapshot();
+
+    /**
+     * Maps the given snapshot into memory.
+     * Returns nullptr and logs the reason in case the snapshot does not exist, is corrupted, has a different version
+     * or in case any of the files it got created from, found inside the directory of the snapshot, changed since then.
+     **/
+    [[nodiscard]] static std::shared_ptr<const MachineSnapshot> open(const std::filesystem::path& path);
+    /**
+     * Returns true in case any of the files the snapshot got created from, found inside the given directory, changed since then.
+     **/
+    [[nodiscard]] bool is_stale(const std::filesystem::path& directory) const;
+
+    /**
+     * Returns the string for the given reference or an empty string in case it is out of range.
+     **/
+    [[nodiscard]] std::string_view get_string(const snapshot::StringRef& ref) const;
+    [[nodiscard]] std::span<const snapshot::Source> get_sources() const;
+    [[nodiscard]] std::span<const snapshot::Machine> get_machines() const;
+    /**
+     * Return nullptr in case there is no such machine or definition.
+     **/
+    [[nodiscard]] const snapshot::Machine* find_machine(size_t articleNumber) const;
+    [[nodiscard]] const snapshot::Definition* find_definition(const snapshot::Machine& machine) const;
+    [[nodiscard]] std::span<const snapshot::Product> get_products(const snapshot::Definition& definition) const;
+    [[nodiscard]] std::span<const snapshot::Alert> get_alerts(const snapshot::Definition& definition) const;
+    [[nodiscard]] std::span<const snapshot::StringRef> get_maintenance_counters(const snapshot::Definition& definition) const;
+    [[nodiscard]] std::span<const snapshot::StringRef> get_maintenance_percentages(const snapshot::Definition& definition) const;
+    /**
+     * Return nullptr for snapshot::NONE.
+     **/
+    [[nodiscard]] const snapshot::ItemsOption* get_items_option(uint32_t index) const;
+    [[nodiscard]] const snapshot::MinMaxOption* get_min_max_option(uint32_t index) const;
+    [[nodiscard]] std::span<const snapshot::Item> get_items(const snapshot::ItemsOption& option) const;
+
+    /**
+     * Copies the machines out of the snapshot. Their names get interned into the given arena, which has to outlive the result.
+     **/
+    [[nodiscard]] Machines to_machines(Arena& arena) const;
+    /**
+     * Creates the definition for the given machine from the snapshot without touching the machine files.
+     * Strings are views into the mapped snapshot, which the result keeps alive. Only the items of the product options get stored inside the given arena.
+     * Returns nullptr in case the snapshot does not contain the machine file of the given machine.
+     **/
+    [[nodiscard]] std::shared_ptr<const JoeDefinition> to_joe_definition(std::shared_ptr<const Machine> machine, std::shared_ptr<Arena> arena = nullptr) const;
+};
+
+/**
+ * Writes a snapshot of the given machines and definitions to path.
+ * definitions holds one definition per machine file. Machines without a definition are stored without one.
+ * sources are the files the machines and definitions got loaded from, used for detecting stale snapshots.
+ * The snapshot gets written to a temporary file first, which then replaces path, so readers never see a partially written snapshot.
+ * Returns false and logs the reason in case writing failed.
+ **/
+bool write_snapshot(const std::filesystem::path& path, const Machines& machines, std::span<const std::shared_ptr<const JoeDefinition>> definitions, std::span<const std::filesystem::path> sources);
+/**
+ * Loads JOE_MACHINES.TXT and all machine files it references from the same directory and writes them as snapshot to path.
+ * Machine files that do not exist get skipped.
+ * Returns false and logs the reason in case writing failed.
+ **/
+bool compile_snapshot(const std::filesystem::path& machinesPath, const std::filesystem::path& path);
+//---------------------------------------------------------------------------
+}  // namespace jutta_bt_proto
+//---------------------------------------------------------------------------
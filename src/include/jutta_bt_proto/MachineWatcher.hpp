@@ -0,0 +1,79 @@
+#pragma once
+
+#include "jutta_bt_proto/MachineRegistry.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_set>
+
+//---------------------------------------------------------------------------
+namespace jutta_bt_proto {
+//---------------------------------------------------------------------------
+/**
+ * Watches the machine files of a MachineRegistry with inotify and publishes changes without restarting the process, e.g. after running extract_apk.sh again.
+ * Changes get collected until the directory stayed unchanged for settleTime, then the changed files get parsed and validated on the watcher thread.
+ * A changed JOE_MACHINES.TXT, snapshot or replaced directory results in MachineRegistry::refresh_machines(), a changed XML file in MachineRegistry::refresh_joe_definitions().
+ * Invalid files get logged and ignored, so the registry keeps serving the previous definitions.
+ * Connected coffee makers keep their definition and move to the new one on their next connect.
+ * Linux only.
+ **/
+class MachineWatcher {
+ public:
+    static constexpr std::chrono::milliseconds DEFAULT_SETTLE_TIME{500};
+
+ private:
+    MachineRegistry* registry;
+    std::chrono::milliseconds settleTime;
+    int inotifyFd{-1};
+    /**
+     * eventfd for waking up the watcher thread once it should stop.
+     **/
+    int stopFd{-1};
+    std::optional<std::thread> watcherThread{std::nullopt};
+    std::atomic<size_t> refreshCount{0};
+    std::atomic<size_t> failedRefreshCount{0};
+
+ public:
+    /**
+     * The registry has to outlive this instance.
+     **/
+    explicit MachineWatcher(MachineRegistry& registry, std::chrono::milliseconds settleTime = DEFAULT_SETTLE_TIME);
+    MachineWatcher(MachineWatcher&&) = delete;
+    MachineWatcher(const MachineWatcher&) = delete;
+    MachineWatcher& operator=(MachineWatcher&&) = delete;
+    MachineWatcher& operator=(const MachineWatcher&) = delete;
+    ~MachineWatcher();
+
+    /**
+     * Starts watching the directory of the current path of the registry on a background thread.
+     * Returns false in case it is already running, the machines are embedded or inotify is not available.
+     **/
+    bool start();
+    /**
+     * Stops watching and joins the watcher thread. Changes that did not settle yet get dropped.
+     **/
+    void stop();
+    [[nodiscard]] bool is_running() const;
+    /**
+     * Returns the number of successful and failed refreshes since construction.
+     **/
+    [[nodiscard]] size_t get_refresh_count() const;
+    [[nodiscard]] size_t get_failed_refresh_count() const;
+
+ private:
+    /**
+     * parentWatch is the watch descriptor of the parent of directory.
+     **/
+    void watcher_run(int parentWatch, std::filesystem::path directory, std::filesystem::path machinesPath);
+    /**
+     * Refreshes the registry for the given changed file names. An empty file name stands for the whole directory.
+     **/
+    void refresh(const std::unordered_set<std::string>& changed, const std::filesystem::path& machinesPath);
+};
+//---------------------------------------------------------------------------
+}  // namespace jutta_bt_proto
+//---------------------------------------------------------------------------
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "date/date.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+//---------------------------------------------------------------------------
+namespace jutta_bt_proto {
+//---------------------------------------------------------------------------
+struct ManufacturerData {
+    uint8_t key{0};
+    uint8_t bfMajVer{0};
+    uint8_t bfMinVer{0};
+    uint16_t articleNumber{0};
+    uint16_t machineNumber{0};
+    uint16_t serialNumber{0};
+    date::year_month_day machineProdDate{};
+    date::year_month_day machineProdDateUCHI{};
+    uint8_t unusedSecond{0};
+    uint8_t statusBits{0};
+} __attribute__((aligned(32)));
+
+/**
+ * Parses the manufacturer specific data from the advertisement send by the coffee maker.
+ * The data has to be at least 16 bytes long.
+ **/
+[[nodiscard]] ManufacturerData to_man_data(std::span<const uint8_t> data);
+/**
+ * Converts the given data to an uint16_t from little-endian.
+ **/
+[[nodiscard]] uint16_t to_uint16_t_little_endian(std::span<const uint8_t> data, size_t offset);
+/**
+ * Parses the given data as a date::year_month_day object.
+ **/
+[[nodiscard]] date::year_month_day to_ymd(std::span<const uint8_t> data, size_t offset);
+//---------------------------------------------------------------------------
+}  // namespace jutta_bt_proto
+//---------------------------------------------------------------------------
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "bt/ByteEncDecoder.hpp"
+#include "jutta_bt_proto/CoffeeMakerLoader.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+//---------------------------------------------------------------------------
+namespace jutta_bt_proto {
+//---------------------------------------------------------------------------
+/**
+ * Product commands encoded for the key of the current connection, ready to be written to the start product characteristic.
+ * Same as CoffeeMaker::write() with encode and overrideKey set.
+ * The default commands of all products get encoded once the key and products are known.
+ * Commands with adjusted options get encoded on first use and kept until they are the least recently used ones and the cache is full.
+ * Not thread safe.
+ **/
+class ProductCommandCache {
+ private:
+    struct Entry {
+        ProductCommand command{};
+        ProductCommand encoded{};
+        /**
+         * Value of useCounter on the last access. Used for evicting the least recently used variant.
+         **/
+        uint64_t lastUse{0};
+        bool valid{false};
+    } __attribute__((aligned(64)));
+
+    uint8_t key{0};
+    bt::CodecContext codec{0};
+    /**
+     * Default command for each product code.
+     **/
+    std::vector<Entry> defaults;
+    /**
+     * Commands with adjusted options.
+     **/
+    std::vector<Entry> variants;
+    uint64_t useCounter{0};
+    size_t hits{0};
+    size_t misses{0};
+
+ public:
+    static constexpr size_t DEFAULT_VARIANT_CAPACITY = 16;
+
+    explicit ProductCommandCache(size_t variantCapacity = DEFAULT_VARIANT_CAPACITY);
+
+    /**
+     * Encodes the default commands of all given products for the given key and drops all cached variants.
+     * Should be called whenever the key or the products change.
+     **/
+    void rebuild(const std::vector<Product>& products, uint8_t key);
+    /**
+     * Drops all cached commands.
+     **/
+    void clear();
+    /**
+     * Returns the given command encoded.
+     * The returned span stays valid until the next call to get(), rebuild() or clear().
+     **/
+    [[nodiscard]] std::span<const uint8_t> get(const ProductCommand& command);
+
+    [[nodiscard]] uint8_t get_key() const;
+    /**
+     * Number of get() calls served from the cache and the number of calls that had to encode.
+     **/
+    [[nodiscard]] size_t get_hits() const;
+    [[nodiscard]] size_t get_misses() const;
+
+ private:
+    void encode(Entry& entry, const ProductCommand& command) const;
+};
+//---------------------------------------------------------------------------
+}  // namespace jutta_bt_proto
+//---------------------------------------------------------------------------
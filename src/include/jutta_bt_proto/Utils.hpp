@@ -2,14 +2,84 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
 //---------------------------------------------------------------------------
 namespace jutta_bt_proto {
 //---------------------------------------------------------------------------
-std::string to_hex_string(const std::vector<uint8_t>& data);
-std::vector<uint8_t> from_hex_string(const std::string& hex);
+enum class HexError : uint8_t {
+    /**
+     * The output buffer is too small to hold the result.
+     **/
+    BUFFER_TOO_SMALL,
+    /**
+     * The hex string consists of an odd number of characters.
+     **/
+    ODD_LENGTH,
+    /**
+     * The hex string contains a character that is no hex digit.
+     **/
+    INVALID_CHARACTER
+};
+[[nodiscard]] std::string_view to_string(HexError error);
+
+/**
+ * Result of to_hex() and from_hex() modeled after std::expected<size_t, HexError>.
+ * On success it holds the number of elements written to the output buffer.
+ * Otherwise it holds the error and the position inside the input where it occurred.
+ **/
+class [[nodiscard]] HexResult {
+ private:
+    /**
+     * Number of elements written on success, position of the error otherwise.
+     **/
+    size_t val;
+    std::optional<HexError> err;
+
+    HexResult(size_t val, std::optional<HexError> err) : val(val), err(err) {}
+
+ public:
+    static HexResult success(size_t count);
+    static HexResult failure(HexError error, size_t position);
+
+    [[nodiscard]] bool has_value() const;
+    explicit operator bool() const;
+    /**
+     * Returns the number of elements written. Only valid in case has_value() is true.
+     **/
+    [[nodiscard]] size_t value() const;
+    /**
+     * Returns the error. Only valid in case has_value() is false.
+     **/
+    [[nodiscard]] HexError error() const;
+    /**
+     * Returns the position inside the input where the error occurred. Only valid in case has_value() is false.
+     **/
+    [[nodiscard]] size_t position() const;
+};
+
+/**
+ * Converts the given data to upper case hex and writes it to out without allocating.
+ * out has to hold at least data.size() * 2 characters.
+ **/
+HexResult to_hex(std::span<const uint8_t> data, std::span<char> out);
+/**
+ * Converts the given upper or lower case hex string to bytes and writes them to out without allocating.
+ * out has to hold at least hex.size() / 2 bytes.
+ * In case of an error out might be partially written.
+ **/
+HexResult from_hex(std::string_view hex, std::span<uint8_t> out);
+
+std::string to_hex_string(std::span<const uint8_t> data);
+/**
+ * Converts the given upper or lower case hex string to bytes.
+ * Returns an empty vector and logs an error in case hex is no valid hex string.
+ **/
+std::vector<uint8_t> from_hex_string(std::string_view hex);
 //---------------------------------------------------------------------------
 }  // namespace jutta_bt_proto
-//---------------------------------------------------------------------------
\ No newline at end of file
+//---------------------------------------------------------------------------
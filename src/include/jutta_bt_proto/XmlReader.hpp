@@ -0,0 +1,111 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <istream>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//---------------------------------------------------------------------------
+namespace jutta_bt_proto {
+//---------------------------------------------------------------------------
+struct XmlAttribute {
+    std::string name;
+    std::string value;
+} __attribute__((aligned(64)));
+
+/**
+ * Attributes of the current element. Only valid during the start element handler.
+ **/
+class XmlAttributes {
+ private:
+    std::span<const XmlAttribute> attributes;
+
+ public:
+    explicit XmlAttributes(std::span<const XmlAttribute> attributes);
+
+    /**
+     * Returns the value of the attribute with the given name or std::nullopt in case the element has no such attribute.
+     **/
+    [[nodiscard]] std::optional<std::string_view> get(std::string_view name) const;
+    [[nodiscard]] size_t size() const;
+};
+
+struct XmlError {
+    /**
+     * Position where the error got detected. Both start at 1.
+     **/
+    size_t line{0};
+    size_t column{0};
+    std::string message;
+} __attribute__((aligned(64)));
+
+/**
+ * Streaming (SAX style) XML reader.
+ * Reports elements and their attributes while reading the input in small chunks, so no document tree gets built in memory.
+ * Text, comments, processing instructions, CDATA sections and DOCTYPE declarations get skipped.
+ * Checks that tags are balanced and there is exactly one root element. Entities get replaced inside attribute values.
+ * Not thread safe.
+ **/
+class XmlReader {
+ public:
+    using StartElementHandler = std::function<void(std::string_view name, const XmlAttributes& attributes)>;
+    using EndElementHandler = std::function<void(std::string_view name)>;
+
+    static constexpr size_t BUFFER_SIZE = 4096;
+
+ private:
+    std::istream& in;
+    std::array<char, BUFFER_SIZE> buffer{};
+    size_t bufferPos{0};
+    size_t bufferSize{0};
+    size_t line{1};
+    size_t column{0};
+
+    std::vector<std::string> openElements{};
+    std::vector<XmlAttribute> attributes{};
+    size_t attributeCount{0};
+    std::string name{};
+    std::string entity{};
+    std::optional<XmlError> error{std::nullopt};
+
+    /**
+     * Returns the next character or std::nullopt at the end of the input.
+     **/
+    std::optional<char> next();
+    std::optional<char> peek();
+    bool skip_whitespace();
+    bool skip_until(std::string_view terminator);
+    bool read_name(std::string& result, std::optional<char> first);
+    bool read_attribute_value(std::string& result, char quote);
+    bool read_entity(std::string& result);
+    bool read_tag(const StartElementHandler& onStart, const EndElementHandler& onEnd);
+    bool read_end_tag(const EndElementHandler& onEnd);
+    bool read_special();
+
+ public:
+    explicit XmlReader(std::istream& in);
+
+    /**
+     * Reads the whole input and calls the handlers for each element.
+     * Empty elements (<A/>) trigger both handlers.
+     * Returns false in case the input is malformed or one of the handlers called fail(). See get_error() for the reason.
+     **/
+    bool parse(const StartElementHandler& onStart, const EndElementHandler& onEnd);
+    /**
+     * Stops parsing with the given error. Meant to be called from within the handlers.
+     **/
+    void fail(std::string message);
+    [[nodiscard]] const std::optional<XmlError>& get_error() const;
+    /**
+     * Names of all elements enclosing the current position starting with the root element.
+     **/
+    [[nodiscard]] std::span<const std::string> get_open_elements() const;
+};
+//---------------------------------------------------------------------------
+}  // namespace jutta_bt_proto
+//---------------------------------------------------------------------------
@@ -0,0 +1,69 @@
+#include "jutta_bt_proto/Arena.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string_view>
+
+//---------------------------------------------------------------------------
+namespace jutta_bt_proto {
+//---------------------------------------------------------------------------
+std::byte* Arena::allocate(size_t size, size_t alignment) {
+    // NOLINTNEXTLINE (cppcoreguidelines-pro-type-reinterpret-cast)
+    const auto address = reinterpret_cast<uintptr_t>(blockPos);
+    const size_t padding = blockPos ? ((alignment - (address % alignment)) % alignment) : 0;
+    if (!blockPos || padding + size > static_cast<size_t>(blockEnd - blockPos)) {
+        // Large values get a block of their own. new[] aligns for any fundamental type:
+        const size_t blockSize = std::max(BLOCK_SIZE, size);
+        blocks.push_back(std::make_unique_for_overwrite<std::byte[]>(blockSize));
+        blockPos = blocks.back().get();
+        blockEnd = blockPos + blockSize;
+        std::byte* result = blockPos;
+        blockPos += size;
+        this->size += size;
+        return result;
+    }
+    std::byte* result = blockPos + padding;
+    blockPos = result + size;
+    this->size += padding + size;
+    return result;
+}
+
+const std::byte* Arena::store_bytes(const void* data, size_t size, size_t alignment) {
+    const std::scoped_lock lock(mutex);
+    std::byte* result = allocate(size, alignment);
+    std::memcpy(result, data, size);
+    return result;
+}
+
+std::string_view Arena::intern(std::string_view str) {
+    if (str.empty()) {
+        return {};
+    }
+    const std::scoped_lock lock(mutex);
+    auto iter = strings.find(str);
+    if (iter != strings.end()) {
+        return *iter;
+    }
+    std::byte* data = allocate(str.size(), 1);
+    std::memcpy(data, str.data(), str.size());
+    // NOLINTNEXTLINE (cppcoreguidelines-pro-type-reinterpret-cast)
+    const std::string_view result(reinterpret_cast<const char*>(data), str.size());
+    strings.insert(result);
+    return result;
+}
+
+size_t Arena::get_string_count() const {
+    const std::scoped_lock lock(mutex);
+    return strings.size();
+}
+
+size_t Arena::get_size() const {
+    const std::scoped_lock lock(mutex);
+    return size;
+}
+//---------------------------------------------------------------------------
+}  // namespace jutta_bt_proto
+//---------------------------------------------------------------------------
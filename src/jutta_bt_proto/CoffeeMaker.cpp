@@ -1,18 +1,24 @@
 #include <gattlib.h>  // Include first since we have some structs forward declared
 
 #include "bt/ByteEncDecoder.hpp"
-#include "date/date.hpp"
+#include "bt/Uuid.hpp"
 #include "jutta_bt_proto/CoffeeMaker.hpp"
 #include "jutta_bt_proto/CoffeeMakerLoader.hpp"
+#include "jutta_bt_proto/FixedCommands.hpp"
+#include "jutta_bt_proto/HexView.hpp"
+#include "jutta_bt_proto/ManufacturerData.hpp"
 #include "jutta_bt_proto/Utils.hpp"
 #include "logger/Logger.hpp"
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <span>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <vector>
 #include <bluetooth/sdp.h>
@@ -21,6 +27,8 @@
 //---------------------------------------------------------------------------
 namespace jutta_bt_proto {
 //---------------------------------------------------------------------------
+static_assert(Alert::MAX_BIT == ((bt::MAX_ATTRIBUTE_SIZE - 1) * 8) - 1);
+
 RelevantUUIDs::RelevantUUIDs() noexcept {
     try {
         to_uuid("5a401523-ab2e-2548-c435-08c300000710", &DEFAULT_SERVICE_UUID);
@@ -50,16 +58,35 @@ void RelevantUUIDs::to_uuid(const std::string& s, uuid_t* uuid) {
 
 const RelevantUUIDs CoffeeMaker::RELEVANT_UUIDS{};
 
-CoffeeMaker::CoffeeMaker(std::string&& name, std::string&& addr) : bleDevice(
-                                                                       std::move(name),
-                                                                       std::move(addr),
-                                                                       [this](const std::vector<uint8_t>& data, const uuid_t& uuid) { this->on_characteristic_read(data, uuid); },
-                                                                       [this]() { this->on_connected(); },
-                                                                       [this]() { this->on_disconnected(); },
-                                                                       [this](const std::vector<uint8_t>& data, const uuid_t& uuid) { this->on_characteristic_read(data, uuid); }),
-                                                                   machines(load_machines("machinefiles/JOE_MACHINES.TXT")) {}
+CoffeeMaker::CoffeeMaker(std::string&& name, std::string&& addr) : CoffeeMaker(std::move(name), std::move(addr), MachineRegistry::get_instance()) {}
+
+CoffeeMaker::CoffeeMaker(std::string&& name, std::string&& addr, MachineRegistry& registry) : bleDevice(
+                                                                                                  std::move(name),
+                                                                                                  std::move(addr),
+                                                                                                  [this](std::span<const uint8_t> data, const uuid_t& uuid) { this->on_characteristic_read(data, uuid); },
+                                                                                                  [this]() { this->on_connected(); },
+                                                                                                  [this]() { this->on_disconnected(); },
+                                                                                                  [this](std::span<const uint8_t> data, const uuid_t& uuid) { this->on_characteristic_read(data, uuid); }),
+                                                                                              registry(&registry) {}
 
-std::string CoffeeMaker::parse_version(const std::vector<uint8_t>& data, size_t from, size_t to) {
+bool LastFrame::is_duplicate(std::span<const uint8_t> frame) {
+    if (valid && std::equal(frame.begin(), frame.end(), data.begin(), data.begin() + static_cast<std::ptrdiff_t>(size))) {
+        return true;
+    }
+    if (frame.size() > data.size()) {
+        // Too large to store, so it never counts as duplicate:
+        valid = false;
+        return false;
+    }
+    std::copy(frame.begin(), frame.end(), data.begin());
+    size = frame.size();
+    valid = true;
+    return false;
+}
+
+void LastFrame::reset() { valid = false; }
+
+std::string CoffeeMaker::parse_version(std::span<const uint8_t> data, size_t from, size_t to) {
     std::string result;
     for (size_t i = from; i <= to; i++) {
         if (data[i]) {
@@ -69,7 +96,7 @@ std::string CoffeeMaker::parse_version(const std::vector<uint8_t>& data, size_t
     return result;
 }
 
-void CoffeeMaker::parse_about_data(const std::vector<uint8_t>& data) {
+void CoffeeMaker::parse_about_data(std::span<const uint8_t> data) {
     std::string blueFrogVersion = parse_version(data, 27, 34);
     std::string coffeeMachineVersion = parse_version(data, 35, 50);
     if (blueFrogVersion != aboutData.blueFrogVersion || coffeeMachineVersion != aboutData.coffeeMachineVersion) {
@@ -84,28 +111,54 @@ void CoffeeMaker::parse_about_data(const std::vector<uint8_t>& data) {
     }
 }
 
-void CoffeeMaker::parse_machine_status(const std::vector<uint8_t>& data, uint8_t key) {
-    if (!joe) {
+std::span<const uint8_t> CoffeeMaker::decode(std::span<const uint8_t> data, const bt::CodecContext& codec, bt::AttributeBuffer& buffer) {
+    if (data.size() > buffer.size()) {
+        SPDLOG_WARN("Received {} bytes, which exceeds the maximum attribute size. Truncating to {} bytes.", data.size(), buffer.size());
+        data = data.first(buffer.size());
+    }
+    std::span<uint8_t> result(buffer.data(), data.size());
+    codec.enc_dec(data, result);
+    return result;
+}
+
+void CoffeeMaker::parse_machine_status(std::span<const uint8_t> data, const bt::CodecContext& codec) {
+    if (!joe || data.empty()) {
         return;
     }
 
-    std::vector<const Alert*> newAlerts;
-    std::vector<std::uint8_t> alertVec = bt::encDecBytes(data, key);
-    for (size_t i = 0; i < (alertVec.size() - 1) << 3; i++) {
-        size_t offsetAbs = (i >> 3) + 1;
-        size_t offsetByte = 7 - (i & 0b111);
-        if ((alertVec[offsetAbs] >> offsetByte) & 0b1) {
-            for (const Alert& alert : joe->alerts) {
-                if (alert.bit == i) {
-                    newAlerts.push_back(&alert);
-                }
-            }
+    bt::AttributeBuffer buffer{};
+    // The first byte is the key:
+    const std::span<const uint8_t> statusBits = decode(data, codec, buffer).subspan(1);
+    const std::span<const uint8_t> lastBits(lastStatusBits.data(), lastStatusBitsSize);
+    if (std::equal(statusBits.begin(), statusBits.end(), lastBits.begin(), lastBits.end())) {
+        return;
+    }
+
+    raisedAlerts.clear();
+    clearedAlerts.clear();
+    joe->definition->find_changed_alerts(lastBits, statusBits, raisedAlerts, clearedAlerts);
+    std::copy(statusBits.begin(), statusBits.end(), lastStatusBits.begin());
+    lastStatusBitsSize = statusBits.size();
+    if (raisedAlerts.empty() && clearedAlerts.empty()) {
+        // Only bits without an alert changed:
+        return;
+    }
+    if (joe->alertRaisedEventHandler) {
+        for (const Alert* alert : raisedAlerts) {
+            joe->alertRaisedEventHandler(*alert);
+        }
+    }
+    if (joe->alertClearedEventHandler) {
+        for (const Alert* alert : clearedAlerts) {
+            joe->alertClearedEventHandler(*alert);
         }
     }
 
+    newAlerts.clear();
+    joe->definition->find_alerts(statusBits, newAlerts);
     if (alerts != newAlerts) {
-        alerts.clear();
-        alerts.insert(alerts.end(), newAlerts.begin(), newAlerts.end());
+        // Swap instead of copying so both vectors keep their capacity:
+        alerts.swap(newAlerts);
 
         // Invoke the alerts event handler:
         if (joe->alertsChangedEventHandler) {
@@ -114,41 +167,41 @@ void CoffeeMaker::parse_machine_status(const std::vector<uint8_t>& data, uint8_t
     }
 }
 
-void CoffeeMaker::parse_product_progress(const std::vector<uint8_t>& data, uint8_t key) {
-    std::vector<std::uint8_t> actData = bt::encDecBytes(data, key);
+void CoffeeMaker::parse_product_progress(std::span<const uint8_t> data, const bt::CodecContext& codec) {
+    bt::AttributeBuffer buffer{};
+    [[maybe_unused]] std::span<const uint8_t> actData = decode(data, codec, buffer);
 }
 
 void CoffeeMaker::analyze_man_data() {
     parse_man_data(bleDevice.get_mam_data());
 }
 
-void CoffeeMaker::parse_man_data(const std::vector<uint8_t>& data) {
-    manData.key = data[0];
-    manData.bfMajVer = data[1];
-    manData.bfMinVer = data[2];
-    manData.articleNumber = to_uint16_t_little_endian(data, 4);
-    manData.machineNumber = to_uint16_t_little_endian(data, 6);
-    manData.serialNumber = to_uint16_t_little_endian(data, 8);
-    manData.machineProdDate = to_ymd(data, 10);
-    manData.machineProdDateUCHI = to_ymd(data, 12);
-    manData.unusedSecond = data[14];
-    manData.statusBits = data[15];
+void CoffeeMaker::parse_man_data(std::span<const uint8_t> data) {
+    manData = to_man_data(data);
+    if (codec.get_key() != manData.key) {
+        codec = bt::CodecContext(manData.key);
+    }
 
     // Invoke the manufacturer data event handler:
     if (manDataChangedEventHandler) {
         manDataChangedEventHandler(manData);
     }
 
-    // Load machine:
-    if (!machines.contains(manData.articleNumber)) {
+    // Load machine. Its machine file only gets parsed in case no other coffee maker of the same model did so before.
+    // Happens on every connect, so definitions refreshed in the meantime (see MachineWatcher) get picked up here:
+    std::shared_ptr<const JoeDefinition> definition = registry->get_joe_definition(manData.articleNumber);
+    if (!definition) {
         SPDLOG_ERROR("Coffee maker with article number '{}' not supported with the given machine files.", manData.articleNumber);
         // NOLINTNEXTLINE(concurrency-mt-unsafe)
         exit(-1);
     }
-    const Machine* machine = &(machines.at(manData.articleNumber));
-    joe = load_joe(machine);
+    joe = std::make_shared<Joe>(std::move(definition));
+    productCommands.rebuild(joe->definition->products, manData.key);
     alerts.clear();
-    SPDLOG_INFO("Found machine '{}' Version: {} with {} products.", machine->name, machine->version, joe->products.size());
+    lastStatusBitsSize = 0;
+    lastAboutFrame.reset();
+    lastStatusFrame.reset();
+    SPDLOG_INFO("Found machine '{}' Version: {} with {} products.", joe->definition->machine->name, joe->definition->machine->version, joe->definition->products.size());
 
     // Invoke the JOE event handler:
     if (joeChangedEventHandler) {
@@ -156,29 +209,33 @@ void CoffeeMaker::parse_man_data(const std::vector<uint8_t>& data) {
     }
 }
 
-void CoffeeMaker::parse_rx(const std::vector<uint8_t>& data, uint8_t key) {
-    std::vector<std::uint8_t> actData = bt::encDecBytes(data, key);
-    SPDLOG_INFO("Read from RX (dec hex): {}", to_hex_string(actData));
-    SPDLOG_INFO("Read from RX (dec str): {}", std::string(actData.begin(), actData.end()));
+void CoffeeMaker::parse_rx(std::span<const uint8_t> data, const bt::CodecContext& codec) {
+    // Each notification is encoded on its own, starting at the beginning of the key stream:
+    bt::AttributeBuffer buffer{};
+    std::span<const uint8_t> actData = decode(data, codec, buffer);
+    SPDLOG_INFO("Read from RX (dec hex): {}", HexView(actData));
+    // NOLINTNEXTLINE (cppcoreguidelines-pro-type-reinterpret-cast)
+    SPDLOG_INFO("Read from RX (dec str): {}", std::string_view(reinterpret_cast<const char*>(actData.data()), actData.size()));
 }
 
 /**
  * Parses the statistics command response and prints an error in case the response indicates an unsuccessful action.
  **/
-void CoffeeMaker::parse_statistics_command(const std::vector<uint8_t>& data, uint8_t key) {
-    std::vector<std::uint8_t> actData = bt::encDecBytes(data, key);
+void CoffeeMaker::parse_statistics_command(std::span<const uint8_t> data, const bt::CodecContext& codec) {
+    bt::AttributeBuffer buffer{};
+    std::span<const uint8_t> actData = decode(data, codec, buffer);
     // In case the received data starts with '0x0E', the statistics command has been successful.
     statDataReady = actData.size() > 1 && actData[0] == 0x0E;
 
     if (statDataReady) {
-        SPDLOG_DEBUG("Successful statistics command: {}", to_hex_string(actData));
+        SPDLOG_DEBUG("Successful statistics command: {}", HexView(actData));
     } else {
         SPDLOG_DEBUG("Statistics data not ready yet.");
     }
-    SPDLOG_TRACE("Statistics data received: {}", to_hex_string(actData));
+    SPDLOG_TRACE("Statistics data received: {}", HexView(actData));
 }
 
-size_t CoffeeMaker::get_stat_val(const std::vector<uint8_t>& data, size_t offset, size_t bytesPerVal) {
+size_t CoffeeMaker::get_stat_val(std::span<const uint8_t> data, size_t offset, size_t bytesPerVal) {
     const size_t valueOffset = offset * bytesPerVal;
     if (data.size() < valueOffset + bytesPerVal) {
         return 0;
@@ -193,9 +250,10 @@ size_t CoffeeMaker::get_stat_val(const std::vector<uint8_t>& data, size_t offset
     return result;
 }
 
-void CoffeeMaker::parse_statistics_data(const std::vector<uint8_t>& data, uint8_t key) {
-    std::vector<std::uint8_t> actData = bt::encDecBytes(data, key);
-    SPDLOG_DEBUG("Read statistics data: {}", to_hex_string(actData));
+void CoffeeMaker::parse_statistics_data(std::span<const uint8_t> data, const bt::CodecContext& codec) {
+    bt::AttributeBuffer buffer{};
+    std::span<const uint8_t> actData = decode(data, codec, buffer);
+    SPDLOG_DEBUG("Read statistics data: {}", HexView(actData));
 
     switch (statParserMode) {
         case StatParseMode::MAINTENANCE_COUNTER:
@@ -212,7 +270,7 @@ void CoffeeMaker::parse_statistics_data(const std::vector<uint8_t>& data, uint8_
     }
 }
 
-void CoffeeMaker::parse_maintainence_percent_data(const std::vector<uint8_t>& data) {
+void CoffeeMaker::parse_maintainence_percent_data(std::span<const uint8_t> data) {
     for (size_t i = 0; i < joe->maintenancePercentages.size(); i++) {
         joe->maintenancePercentages[i].percent = static_cast<uint8_t>(get_stat_val(data, i, 1));
         SPDLOG_DEBUG("{}: {}%", joe->maintenancePercentages[i].name, joe->maintenancePercentages[i].percent);
@@ -224,7 +282,7 @@ void CoffeeMaker::parse_maintainence_percent_data(const std::vector<uint8_t>& da
     }
 }
 
-void CoffeeMaker::parse_maintainence_counter_data(const std::vector<uint8_t>& data) {
+void CoffeeMaker::parse_maintainence_counter_data(std::span<const uint8_t> data) {
     for (size_t i = 0; i < joe->maintenanceCounters.size(); i++) {
         joe->maintenanceCounters[i].count = static_cast<uint16_t>(get_stat_val(data, i, 2));
         SPDLOG_DEBUG("{}: {}", joe->maintenanceCounters[i].name, joe->maintenanceCounters[i].count);
@@ -236,19 +294,20 @@ void CoffeeMaker::parse_maintainence_counter_data(const std::vector<uint8_t>& da
     }
 }
 
-void CoffeeMaker::parse_product_counter_data(const std::vector<uint8_t>& data) {
+void CoffeeMaker::parse_product_counter_data(std::span<const uint8_t> data) {
     joe->statTotalCount = get_stat_val(data, 0, 3);
     SPDLOG_INFO("Total number of products: {}", joe->statTotalCount);
 
-    for (Product& p : joe->products) {
-        size_t code = p.code_to_size_t();
-        size_t result = get_stat_val(data, code, 3);
+    const std::vector<size_t>& productCodes = joe->definition->productCodes;
+    const std::vector<Product>& products = joe->definition->products;
+    for (size_t i = 0; i < productCodes.size(); i++) {
+        size_t result = get_stat_val(data, productCodes[i], 3);
         if (result != 0xFFFF) {
-            p.statCounter = result;
-            SPDLOG_DEBUG("Product {}: {}", p.name, result);
+            joe->productStatCounters[i] = result;
+            SPDLOG_DEBUG("Product {}: {}", products[i].name, result);
         } else {
-            p.statCounter = 0;
-            SPDLOG_WARN("Product {} has invalid counter!", p.name);
+            joe->productStatCounters[i] = 0;
+            SPDLOG_WARN("Product {} has invalid counter!", products[i].name);
         }
     }
 
@@ -258,46 +317,64 @@ void CoffeeMaker::parse_product_counter_data(const std::vector<uint8_t>& data) {
     }
 }
 
-uint16_t CoffeeMaker::to_uint16_t_little_endian(const std::vector<uint8_t>& data, size_t offset) {
-    return (static_cast<uint16_t>(data[offset + 1]) << 8) | static_cast<uint16_t>(data[offset]);
-}
-
-date::year_month_day CoffeeMaker::to_ymd(const std::vector<uint8_t>& data, size_t offset) {
-    uint16_t date = to_uint16_t_little_endian(data, offset);
-    return date::year(((date & 65024) >> 9) + 1990) / ((date & 480) >> 5) / (date & 31);
+const CoffeeMaker::CharacteristicReadHandlers& CoffeeMaker::get_characteristic_read_handlers() {
+    static const CharacteristicReadHandlers handlers{
+        {bt::to_uuid128(RELEVANT_UUIDS.ABOUT_MACHINE_CHARACTERISTIC_UUID), &CoffeeMaker::on_about_read},
+        {bt::to_uuid128(RELEVANT_UUIDS.MACHINE_STATUS_CHARACTERISTIC_UUID), &CoffeeMaker::on_machine_status_read},
+        {bt::to_uuid128(RELEVANT_UUIDS.PRODUCT_PROGRESS_CHARACTERISTIC_UUID), &CoffeeMaker::on_product_progress_read},
+        {bt::to_uuid128(RELEVANT_UUIDS.UART_RX_CHARACTERISTIC_UUID), &CoffeeMaker::on_rx_read},
+        {bt::to_uuid128(RELEVANT_UUIDS.STATISTICS_COMMAND_CHARACTERISTIC_UUID), &CoffeeMaker::on_statistics_command_read},
+        {bt::to_uuid128(RELEVANT_UUIDS.STATISTICS_DATA_CHARACTERISTIC_UUID), &CoffeeMaker::on_statistics_data_read}};
+    return handlers;
 }
 
-void CoffeeMaker::on_characteristic_read(const std::vector<uint8_t>& data, const uuid_t& uuid) {
-    std::array<char, MAX_LEN_UUID_STR + 1> uuidStr{};
-    gattlib_uuid_to_string(&uuid, uuidStr.data(), uuidStr.size());
-    SPDLOG_TRACE("Received {} bytes of data from characteristic '{}'.", data.size(), uuidStr.data());
+void CoffeeMaker::on_characteristic_read(std::span<const uint8_t> data, const uuid_t& uuid) {
+    SPDLOG_TRACE("Received {} bytes of data from characteristic '{}'.", data.size(), bt::UuidView(uuid));
 
-    // About UUID:
-    if (gattlib_uuid_cmp(&uuid, &RELEVANT_UUIDS.ABOUT_MACHINE_CHARACTERISTIC_UUID) == GATTLIB_SUCCESS) {
-        parse_about_data(data);
-    }
-    // Machine status:
-    else if (gattlib_uuid_cmp(&uuid, &RELEVANT_UUIDS.MACHINE_STATUS_CHARACTERISTIC_UUID) == GATTLIB_SUCCESS) {
-        parse_machine_status(data, manData.key);
-    }
-    // Product progress:
-    else if (gattlib_uuid_cmp(&uuid, &RELEVANT_UUIDS.PRODUCT_PROGRESS_CHARACTERISTIC_UUID) == GATTLIB_SUCCESS) {
-        parse_product_progress(data, manData.key);
+    const CharacteristicReadHandlers& handlers = get_characteristic_read_handlers();
+    auto iter = handlers.find(bt::to_uuid128(uuid));
+    if (iter != handlers.end()) {
+        (this->*(iter->second))(data);
+        return;
     }
-    // RX:
-    else if (gattlib_uuid_cmp(&uuid, &RELEVANT_UUIDS.UART_RX_CHARACTERISTIC_UUID) == GATTLIB_SUCCESS) {
-        parse_rx(data, manData.key);
+
+    if (unknownCharacteristicReadEventHandler) {
+        unknownCharacteristicReadEventHandler(data, uuid);
+    } else {
+        SPDLOG_DEBUG("Ignoring {} bytes from unknown characteristic '{}'.", data.size(), bt::UuidView(uuid));
     }
-    // Statistics Command:
-    else if (gattlib_uuid_cmp(&uuid, &RELEVANT_UUIDS.STATISTICS_COMMAND_CHARACTERISTIC_UUID) == GATTLIB_SUCCESS) {
-        parse_statistics_command(data, manData.key);
+}
+
+void CoffeeMaker::on_about_read(std::span<const uint8_t> data) {
+    if (lastAboutFrame.is_duplicate(data)) {
+        skippedReads++;
+        return;
     }
-    // Statistics Data:
-    else if (gattlib_uuid_cmp(&uuid, &RELEVANT_UUIDS.STATISTICS_DATA_CHARACTERISTIC_UUID) == GATTLIB_SUCCESS) {
-        parse_statistics_data(data, manData.key);
-    } else {
-        // TODO print
+    parse_about_data(data);
+}
+
+void CoffeeMaker::on_machine_status_read(std::span<const uint8_t> data) {
+    if (lastStatusFrame.is_duplicate(data)) {
+        skippedReads++;
+        return;
     }
+    parse_machine_status(data, codec);
+}
+
+void CoffeeMaker::on_product_progress_read(std::span<const uint8_t> data) {
+    parse_product_progress(data, codec);
+}
+
+void CoffeeMaker::on_rx_read(std::span<const uint8_t> data) {
+    parse_rx(data, codec);
+}
+
+void CoffeeMaker::on_statistics_command_read(std::span<const uint8_t> data) {
+    parse_statistics_command(data, codec);
+}
+
+void CoffeeMaker::on_statistics_data_read(std::span<const uint8_t> data) {
+    parse_statistics_data(data, codec);
 }
 void CoffeeMaker::request_status() {
     bleDevice.read_characteristic(RELEVANT_UUIDS.MACHINE_STATUS_CHARACTERISTIC_UUID);
@@ -316,31 +393,39 @@ void CoffeeMaker::read_rx() {
 }
 
 void CoffeeMaker::write_tx(const std::string& s) {
-    const std::vector<uint8_t> data(s.begin(), s.end());
-    write_tx(data);
+    // NOLINTNEXTLINE (cppcoreguidelines-pro-type-reinterpret-cast)
+    write_tx(std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(s.data()), s.size()));
 }
 
-void CoffeeMaker::write_tx(const std::vector<uint8_t>& data) {
+void CoffeeMaker::write_tx(std::span<const uint8_t> data) {
     write(RELEVANT_UUIDS.UART_TX_CHARACTERISTIC_UUID, data, true, true);
 }
 
-bool CoffeeMaker::write(const uuid_t& characteristic, const std::vector<uint8_t>& data, bool encode, bool overrideKey) {
-    std::vector<uint8_t> encodedData = data;
-    if (encode) {
-        encodedData[0] = manData.key;
-        if (overrideKey) {
-            encodedData[encodedData.size() - 1] = manData.key;
-        }
-        encodedData = bt::encDecBytes(encodedData, manData.key);
+bool CoffeeMaker::write(const uuid_t& characteristic, std::span<const uint8_t> data, bool encode, bool overrideKey) {
+    if (!encode) {
+        SPDLOG_TRACE("Wrote: {}", HexView(data));
+        return bleDevice.write(characteristic, data);
+    }
+
+    if (data.empty() || data.size() > bt::MAX_ATTRIBUTE_SIZE) {
+        SPDLOG_ERROR("Unable to write {} bytes. Expected between 1 and {} bytes.", data.size(), bt::MAX_ATTRIBUTE_SIZE);
+        return false;
+    }
+    bt::AttributeBuffer buffer{};
+    std::span<uint8_t> encodedData(buffer.data(), data.size());
+    std::copy(data.begin(), data.end(), encodedData.begin());
+    encodedData[0] = manData.key;
+    if (overrideKey) {
+        encodedData[encodedData.size() - 1] = manData.key;
     }
-    SPDLOG_TRACE("Wrote: {}", to_hex_string(encodedData));
+    codec.enc_dec(encodedData);
+    SPDLOG_TRACE("Wrote: {}", HexView(encodedData));
     return bleDevice.write(characteristic, encodedData);
 }
 
 void CoffeeMaker::shutdown() {
     SPDLOG_DEBUG("Shutting down the coffee maker...");
-    static const std::vector<uint8_t> command{0x00, 0x46, 0x02};
-    write(RELEVANT_UUIDS.P_MODE_CHARACTERISTIC_UUID, command, true, false);
+    write(RELEVANT_UUIDS.P_MODE_CHARACTERISTIC_UUID, SHUTDOWN_FRAMES[manData.key], false, false);
 }
 
 void CoffeeMaker::request_coffee() {
@@ -352,18 +437,18 @@ void CoffeeMaker::request_coffee() {
 }
 
 void CoffeeMaker::request_coffee(const Product& product) {
-    const std::string commandHexStr = product.to_bt_command();
-    const std::vector<uint8_t> command = from_hex_string(commandHexStr);
-    write(RELEVANT_UUIDS.START_PRODUCT_CHARACTERISTIC_UUID, command, true, true);
+    request_coffee(product.command);
+}
+
+void CoffeeMaker::request_coffee(const ProductCommand& command) {
+    write(RELEVANT_UUIDS.START_PRODUCT_CHARACTERISTIC_UUID, productCommands.get(command), false, false);
 }
 
 void CoffeeMaker::append_prod_stat_bits(std::vector<uint8_t> data) const {
     std::array<uint8_t, 2> bArr{0};
 
-    for (const Product& p : joe->products) {
-        size_t code = p.code_to_size_t();
-
-        code /= 4;
+    for (const size_t productCode : joe->definition->productCodes) {
+        size_t code = productCode / 4;
         size_t arrOffset = code / 8;
         assert(arrOffset < bArr.size());
         bArr[arrOffset] |= (1 << (code % 8));
@@ -392,8 +477,7 @@ void CoffeeMaker::request_statistics(StatParseMode mode) {
 
 void CoffeeMaker::stay_in_ble() {
     SPDLOG_DEBUG("Sending stay in BLE mode...");
-    static const std::vector<uint8_t> command{0x00, 0x7F, 0x80};
-    write(RELEVANT_UUIDS.P_MODE_CHARACTERISTIC_UUID, command, true, false);
+    write(RELEVANT_UUIDS.P_MODE_CHARACTERISTIC_UUID, STAY_IN_BLE_FRAMES[manData.key], false, false);
 }
 
 void CoffeeMaker::on_connected() {
@@ -440,8 +524,7 @@ void CoffeeMaker::disconnect() {
         set_state(CoffeeMakerState::DISCONNECTING);
 
         // Send the disconnect command:
-        static const std::vector<uint8_t> command{0x00, 0x7F, 0x81};
-        write(RELEVANT_UUIDS.P_MODE_CHARACTERISTIC_UUID, command, true, false);
+        write(RELEVANT_UUIDS.P_MODE_CHARACTERISTIC_UUID, DISCONNECT_FRAMES[manData.key], false, false);
 
         // Join the heartbeat thread:
         assert(heartbeatThread);
@@ -462,6 +545,8 @@ const AboutData& CoffeeMaker::get_about_data() const { return aboutData; }
 
 const std::vector<const Alert*>& CoffeeMaker::get_alerts() const { return alerts; }
 
+size_t CoffeeMaker::get_skipped_reads() const { return skippedReads; }
+
 void CoffeeMaker::set_state(CoffeeMakerState state) {
     if (state != this->state) {
         this->state = state;
@@ -483,9 +568,8 @@ void CoffeeMaker::heartbeat_run() {
     SPDLOG_INFO("Heartbeat thread ready to be joined.");
 }
 
-std::vector<uint8_t> CoffeeMaker::build_stats_cmd(StatParseMode mode) {
-    std::vector<uint8_t> result;
-    result.resize(5);
+std::array<uint8_t, 5> CoffeeMaker::build_stats_cmd(StatParseMode mode) {
+    std::array<uint8_t, 5> result{};
     // Padding:
     result[0] = 0;
 
@@ -508,12 +592,12 @@ std::vector<uint8_t> CoffeeMaker::build_stats_cmd(StatParseMode mode) {
 }
 
 void CoffeeMaker::lock() {
-    write(RELEVANT_UUIDS.BARISTA_MODE_CHARACTERISTIC_UUID, {{0x00, 0x01}}, true, false);
+    write(RELEVANT_UUIDS.BARISTA_MODE_CHARACTERISTIC_UUID, LOCK_FRAMES[manData.key], false, false);
     SPDLOG_INFO("Coffee maker locked.");
 }
 
 void CoffeeMaker::unlock() {
-    write(RELEVANT_UUIDS.BARISTA_MODE_CHARACTERISTIC_UUID, {{0x00, 0x00}}, true, false);
+    write(RELEVANT_UUIDS.BARISTA_MODE_CHARACTERISTIC_UUID, UNLOCK_FRAMES[manData.key], false, false);
     SPDLOG_INFO("Coffee maker unlocked.");
 }
 
@@ -1,94 +1,286 @@
 #include "jutta_bt_proto/CoffeeMakerLoader.hpp"
 #include "io/csv.hpp"
 #include "jutta_bt_proto/Utils.hpp"
+#include "jutta_bt_proto/XmlReader.hpp"
 #include "logger/Logger.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <cassert>
+#include <charconv>
 #include <cstddef>
 #include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <istream>
 #include <memory>
 #include <optional>
-#include <sstream>
+#include <span>
 #include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
 #include <vector>
 #include <spdlog/spdlog.h>
-#include <tinyxml2.h>
 
 //---------------------------------------------------------------------------
 namespace jutta_bt_proto {
 //---------------------------------------------------------------------------
-void ItemsOption::to_bt_command(std::vector<std::string>& command) const {
-    if (argument[0] == 'F') {
-        std::string offsetStr = argument.substr(1);
-        std::istringstream iss(offsetStr);
-        size_t offset = 0;
-        iss >> offset;
-        command[offset - 1] = defaultValue;
-    } else {
+std::optional<uint8_t> to_command_offset(std::string_view argument) {
+    size_t offset = 0;
+    if (argument.size() < 2 || argument[0] != 'F' || std::from_chars(argument.data() + 1, argument.data() + argument.size(), offset).ptr != argument.data() + argument.size()) {
         SPDLOG_ERROR("Invalid argument when converting to a BT command '{}'", argument);
+        return std::nullopt;
     }
+    // F1 would be the product code. The first byte is the key.
+    if (offset < 2 || offset >= PRODUCT_COMMAND_SIZE) {
+        SPDLOG_ERROR("Argument '{}' out of range for a BT command.", argument);
+        return std::nullopt;
+    }
+    return static_cast<uint8_t>(offset);
 }
 
-void MinMaxOption::to_bt_command(std::vector<std::string>& command) const {
-    if (argument[0] == 'F') {
-        std::string offsetStr = argument.substr(1);
-        std::istringstream iss(offsetStr);
-        size_t offset = 0;
-        iss >> offset;
-        uint8_t v = value / step;
-        command[offset - 1] = to_hex_string(std::vector<uint8_t>{v});
-    } else {
-        SPDLOG_ERROR("Invalid argument when converting to a BT command '{}'", argument);
+size_t to_product_code(std::string_view hex) {
+    std::array<uint8_t, sizeof(size_t)> buffer{};
+    const HexResult result = from_hex(hex, buffer);
+    if (hex.empty() || !result) {
+        SPDLOG_ERROR("Invalid product code '{}'", hex);
+        return 0;
     }
+    size_t code = 0;
+    for (size_t i = 0; i < result.value(); i++) {
+        code <<= 8;
+        code |= buffer[i];
+    }
+    return code;
 }
 
-std::string Product::to_bt_command() const {
-    std::vector<std::string> command;
-    command.resize(17);
-    for (std::string& s : command) {
-        s = "00";
+uint8_t to_command_byte(std::string_view hex) {
+    uint8_t result = 0;
+    if (hex.size() != 2 || !from_hex(hex, std::span<uint8_t>(&result, 1))) {
+        SPDLOG_ERROR("Invalid value when converting to a BT command '{}'", hex);
+        return 0;
+    }
+    return result;
+}
+
+void ItemsOption::to_bt_command(ProductCommand& command) const {
+    to_bt_command(command, commandDefaultValue);
+}
+
+void ItemsOption::to_bt_command(ProductCommand& command, uint8_t value) const {
+    if (commandOffset) {
+        command[*commandOffset] = value;
+    }
+}
+
+void MinMaxOption::to_bt_command(ProductCommand& command) const {
+    to_bt_command(command, value);
+}
+
+void MinMaxOption::to_bt_command(ProductCommand& command, uint8_t amount) const {
+    if (commandOffset && step > 0) {
+        command[*commandOffset] = amount / step;
     }
+}
+
+void Product::compile_bt_command() {
+    command.fill(0);
+    optionsByOffset.fill(ProductOptionType::NONE);
 
     if (strength) {
         strength->to_bt_command(command);
+        if (strength->commandOffset) {
+            optionsByOffset[*strength->commandOffset] = ProductOptionType::STRENGTH;
+        }
     }
 
     if (temperature) {
         temperature->to_bt_command(command);
+        if (temperature->commandOffset) {
+            optionsByOffset[*temperature->commandOffset] = ProductOptionType::TEMPERATURE;
+        }
     }
 
     if (waterAmount) {
         waterAmount->to_bt_command(command);
+        if (waterAmount->commandOffset) {
+            optionsByOffset[*waterAmount->commandOffset] = ProductOptionType::WATER_AMOUNT;
+        }
     }
 
     if (milkFoamAmount) {
         milkFoamAmount->to_bt_command(command);
+        if (milkFoamAmount->commandOffset) {
+            optionsByOffset[*milkFoamAmount->commandOffset] = ProductOptionType::MILK_FOAM_AMOUNT;
+        }
     }
 
     // TODO: Add GRINDER_FREENESS
 
-    command[0] = code;
+    command[1] = to_command_byte(code);
+}
 
-    std::string result = "00";
-    for (const std::string& s : command) {
-        result += s;
-    }
+std::string Product::to_bt_command() const {
+    std::string result = to_hex_string(command);
     SPDLOG_DEBUG("Product command: {}", result);
     return result;
 }
 
-size_t Product::code_to_size_t() const {
-    std::vector<uint8_t> codeVec = from_hex_string(code);
-    size_t codeVal = 0;
-    for (const uint8_t c : codeVec) {
-        codeVal <<= 8;
-        codeVal |= c;
+size_t Product::code_to_size_t() const { return codeValue; }
+
+const ItemsOption* Product::find_items_option(size_t offset) const {
+    if (offset >= optionsByOffset.size()) {
+        return nullptr;
+    }
+    switch (optionsByOffset[offset]) {
+        case ProductOptionType::STRENGTH:
+            return &*strength;
+
+        case ProductOptionType::TEMPERATURE:
+            return &*temperature;
+
+        default:
+            return nullptr;
+    }
+}
+
+const MinMaxOption* Product::find_min_max_option(size_t offset) const {
+    if (offset >= optionsByOffset.size()) {
+        return nullptr;
+    }
+    switch (optionsByOffset[offset]) {
+        case ProductOptionType::WATER_AMOUNT:
+            return &*waterAmount;
+
+        case ProductOptionType::MILK_FOAM_AMOUNT:
+            return &*milkFoamAmount;
+
+        default:
+            return nullptr;
+    }
+}
+
+void JoeDefinition::build_indexes() {
+    productCodes.reserve(products.size());
+    for (size_t i = 0; i < products.size(); i++) {
+        productCodes.push_back(products[i].codeValue);
+        productsByCode.emplace(products[i].codeValue, i);
+        productsByName.emplace(products[i].name, i);
+    }
+
+    // Alerts for bits the machine status can not carry would never be raised and blow up the table below:
+    std::erase_if(alerts, [](const Alert& alert) {
+        if (alert.bit > Alert::MAX_BIT) {
+            SPDLOG_WARN("Ignoring alert '{}' for bit {}, which exceeds the maximum bit {}.", alert.name, alert.bit, Alert::MAX_BIT);
+            return true;
+        }
+        return false;
+    });
+
+    // Counting sort of the alerts by their bit, keeping the order of alerts with the same bit:
+    size_t bitCount = 0;
+    for (const Alert& alert : alerts) {
+        bitCount = std::max(bitCount, alert.bit + 1);
+    }
+    alertBitOffsets.assign(bitCount + 1, 0);
+    for (const Alert& alert : alerts) {
+        alertBitOffsets[alert.bit + 1]++;
+    }
+    for (size_t bit = 1; bit < alertBitOffsets.size(); bit++) {
+        alertBitOffsets[bit] += alertBitOffsets[bit - 1];
+    }
+    alertsByBit.resize(alerts.size());
+    std::vector<uint32_t> next(alertBitOffsets.begin(), alertBitOffsets.end() - 1);
+    for (const Alert& alert : alerts) {
+        alertsByBit[next[alert.bit]++] = &alert;
+    }
+}
+
+const Product* JoeDefinition::find_product_by_code(size_t code) const {
+    auto iter = productsByCode.find(code);
+    return iter == productsByCode.end() ? nullptr : &products[iter->second];
+}
+
+const Product* JoeDefinition::find_product_by_name(std::string_view name) const {
+    auto iter = productsByName.find(name);
+    return iter == productsByName.end() ? nullptr : &products[iter->second];
+}
+
+const Alert* JoeDefinition::find_alert_by_bit(size_t bit) const {
+    const std::span<const Alert* const> result = find_alerts_by_bit(bit);
+    return result.empty() ? nullptr : result.front();
+}
+
+std::span<const Alert* const> JoeDefinition::find_alerts_by_bit(size_t bit) const {
+    if (bit + 1 >= alertBitOffsets.size()) {
+        return {};
+    }
+    return std::span<const Alert* const>(alertsByBit).subspan(alertBitOffsets[bit], alertBitOffsets[bit + 1] - alertBitOffsets[bit]);
+}
+
+/**
+ * Loads the up to 8 status bytes starting at base big-endian, so status bit base * 8 + i becomes the i-th most significant bit of the result.
+ * Bytes past the end of statusBits count as zero.
+ **/
+inline uint64_t load_status_word(std::span<const uint8_t> statusBits, size_t base) {
+    uint64_t word = 0;
+    for (size_t i = base; i < base + 8; i++) {
+        word = (word << 8) | (i < statusBits.size() ? statusBits[i] : 0);
+    }
+    return word;
+}
+
+void JoeDefinition::find_alerts(std::span<const uint8_t> statusBits, std::vector<const Alert*>& result) const {
+    const size_t bitCount = alertBitOffsets.empty() ? 0 : alertBitOffsets.size() - 1;
+    // Bits without alerts do not need to be looked at:
+    statusBits = statusBits.first(std::min(statusBits.size(), (bitCount + 7) / 8));
+
+    for (size_t base = 0; base < statusBits.size(); base += 8) {
+        uint64_t word = load_status_word(statusBits, base);
+        while (word != 0) {
+            const auto i = static_cast<size_t>(std::countl_zero(word));
+            const std::span<const Alert* const> bitAlerts = find_alerts_by_bit((base * 8) + i);
+            result.insert(result.end(), bitAlerts.begin(), bitAlerts.end());
+            // Clear the bit we just handled:
+            word &= ~(uint64_t{1} << (63 - i));
+        }
+    }
+}
+
+void JoeDefinition::find_changed_alerts(std::span<const uint8_t> lastStatusBits, std::span<const uint8_t> statusBits, std::vector<const Alert*>& raised, std::vector<const Alert*>& cleared) const {
+    const size_t bitCount = alertBitOffsets.empty() ? 0 : alertBitOffsets.size() - 1;
+    // Bits without alerts do not need to be looked at:
+    const size_t size = std::min(std::max(statusBits.size(), lastStatusBits.size()), (bitCount + 7) / 8);
+
+    for (size_t base = 0; base < size; base += 8) {
+        const uint64_t word = load_status_word(statusBits, base);
+        uint64_t changed = word ^ load_status_word(lastStatusBits, base);
+        while (changed != 0) {
+            const auto i = static_cast<size_t>(std::countl_zero(changed));
+            const uint64_t mask = uint64_t{1} << (63 - i);
+            const std::span<const Alert* const> bitAlerts = find_alerts_by_bit((base * 8) + i);
+            std::vector<const Alert*>& result = (word & mask) ? raised : cleared;
+            result.insert(result.end(), bitAlerts.begin(), bitAlerts.end());
+            // Clear the bit we just handled:
+            changed &= ~mask;
+        }
     }
-    return codeVal;
 }
 
-std::unordered_map<size_t, const Machine> load_machines(const std::filesystem::path& path) {
+Joe::Joe(std::shared_ptr<const JoeDefinition> definition) : definition(std::move(definition)),
+                                                            productStatCounters(this->definition->products.size(), 0),
+                                                            maintenanceCounters(this->definition->maintenanceCounters),
+                                                            maintenancePercentages(this->definition->maintenancePercentages) {}
+
+size_t Joe::get_stat_counter(const Product& product) const {
+    assert(&product >= definition->products.data() && &product < definition->products.data() + definition->products.size());
+    return productStatCounters[static_cast<size_t>(&product - definition->products.data())];
+}
+
+Machines load_machines(const std::filesystem::path& path, Arena& arena) {
     SPDLOG_INFO("Loading machines...");
-    std::unordered_map<size_t, const Machine> result;
+    Machines result;
     io::CSVReader<4, io::trim_chars<' ', '\t'>, io::no_quote_escape<';'>> in(path);
     // Skip the first line:
     in.next_line();
@@ -97,143 +289,236 @@ std::unordered_map<size_t, const Machine> load_machines(const std::filesystem::p
     std::string fileName;
     uint8_t version = 0;
     while (in.read_row(articleNumber, name, fileName, version)) {
-        result.emplace(articleNumber, Machine(articleNumber, std::string{name}, std::string{fileName}, version));
+        result.emplace(articleNumber, Machine(articleNumber, arena.intern(name), arena.intern(fileName), version));
     }
     SPDLOG_INFO("Loaded {} machines.", result.size());
     return result;
 }
 
-std::optional<ItemsOption> load_items_option(const tinyxml2::XMLElement* option) {
-    std::string argument = option->Attribute("Argument");
-    std::string defaultValue = option->Attribute("Default");
-    std::vector<Item> items;
-    for (const tinyxml2::XMLElement* e = option->FirstChildElement("ITEM"); e != nullptr; e = e->NextSiblingElement("ITEM")) {
-        std::string name = e->Attribute("Name");
-        std::string value = e->Attribute("Value");
-        items.emplace_back(std::move(name), std::move(value));
-    }
-    return std::make_optional<ItemsOption>(std::move(argument), std::move(defaultValue), std::move(items));
-}
+/**
+ * Builds a JoeDefinition while the machine file gets streamed through the XmlReader in a single pass.
+ * Only the first of each product option and maintenance bank is used.
+ **/
+class JoeXmlParser {
+ private:
+    /**
+     * The product option currently collecting its items.
+     **/
+    enum class ItemsTarget : uint8_t {
+        NONE,
+        STRENGTH,
+        TEMPERATURE
+    };
 
-std::optional<MinMaxOption> load_min_max_option(const tinyxml2::XMLElement* option) {
-    std::string argument = option->Attribute("Argument");
-    uint8_t value = option->IntAttribute("Value");
-    uint8_t min = option->IntAttribute("Min");
-    uint8_t max = option->IntAttribute("Max");
-    uint8_t step = option->IntAttribute("Step");
-    return std::make_optional<MinMaxOption>(std::move(argument), value, min, max, step);
-}
+    enum class Bank : uint8_t {
+        NONE,
+        MAINTENANCE_COUNTER,
+        MAINTENANCE_PERCENT
+    };
 
-void load_products(std::vector<Product>* products, tinyxml2::XMLElement* joe) {
-    tinyxml2::XMLElement* productsXml = joe->FirstChildElement("PRODUCTS");
-    for (const tinyxml2::XMLElement* e = productsXml->FirstChildElement("PRODUCT"); e != nullptr; e = e->NextSiblingElement("PRODUCT")) {
-        std::string name = e->Attribute("Name");
-        std::string code = e->Attribute("Code");
+    XmlReader& reader;
+    Arena& arena;
 
-        // Strength:
-        std::optional<ItemsOption> strength;
-        const tinyxml2::XMLElement* strengthXml = e->FirstChildElement("COFFEE_STRENGTH");
-        if (strengthXml) {
-            strength = load_items_option(strengthXml);
-        }
+    std::optional<std::string_view> dated;
+    std::vector<Product> products;
+    std::vector<Alert> alerts;
+    std::vector<MaintenanceCounter> maintenanceCounters;
+    std::vector<MaintenancePercentage> maintenancePercentages;
 
-        // Temperature:
-        std::optional<ItemsOption> temperature;
-        const tinyxml2::XMLElement* temperatureXml = e->FirstChildElement("TEMPERATURE");
-        if (temperatureXml) {
-            temperature = load_items_option(temperatureXml);
-        }
+    // Current product:
+    std::string_view productName;
+    std::string_view productCode;
+    std::optional<ItemsOption> strength;
+    std::optional<ItemsOption> temperature;
+    std::optional<MinMaxOption> waterAmount;
+    std::optional<MinMaxOption> milkFoamAmount;
 
-        // Water amount:
-        std::optional<MinMaxOption> waterAmount;
-        const tinyxml2::XMLElement* waterAmountXml = e->FirstChildElement("WATER_AMOUNT");
-        if (waterAmountXml) {
-            waterAmount = load_min_max_option(waterAmountXml);
-        }
+    // Current items option:
+    ItemsTarget itemsTarget{ItemsTarget::NONE};
+    std::string_view itemsArgument;
+    std::string_view itemsDefaultValue;
+    std::vector<Item> items;
+
+    Bank bank{Bank::NONE};
+    bool maintenanceCountersDone{false};
+    bool maintenancePercentagesDone{false};
 
-        // Milk Foam Amount:
-        std::optional<MinMaxOption> milkFoamAmount;
-        const tinyxml2::XMLElement* milkFoamAmountXml = e->FirstChildElement("MILK_FOAM_AMOUNT");
-        if (milkFoamAmountXml) {
-            milkFoamAmount = load_min_max_option(milkFoamAmountXml);
+    std::optional<std::string_view> get_required(const XmlAttributes& attributes, std::string_view element, std::string_view name) {
+        std::optional<std::string_view> result = attributes.get(name);
+        if (!result) {
+            reader.fail("Missing attribute '" + std::string{name} + "' in '" + std::string{element} + "'.");
         }
+        return result;
+    }
 
-        products->emplace_back(std::move(name), std::move(code), std::move(strength), std::move(temperature), std::move(waterAmount), std::move(milkFoamAmount));
+    /**
+     * Missing integer attributes default to 0.
+     **/
+    template <typename T>
+    std::optional<T> get_int(const XmlAttributes& attributes, std::string_view element, std::string_view name) {
+        const std::optional<std::string_view> value = attributes.get(name);
+        if (!value) {
+            return T{0};
+        }
+        T result{0};
+        const std::from_chars_result parsed = std::from_chars(value->data(), value->data() + value->size(), result);
+        if (value->empty() || parsed.ec != std::errc{} || parsed.ptr != value->data() + value->size()) {
+            reader.fail("Invalid value '" + std::string{*value} + "' for attribute '" + std::string{name} + "' in '" + std::string{element} + "'.");
+            return std::nullopt;
+        }
+        return result;
     }
-}
 
-void load_alerts(std::vector<Alert>* alerts, tinyxml2::XMLElement* joe) {
-    tinyxml2::XMLElement* alertsXml = joe->FirstChildElement("ALERTS");
-    for (const tinyxml2::XMLElement* e = alertsXml->FirstChildElement("ALERT"); e != nullptr; e = e->NextSiblingElement("ALERT")) {
-        size_t bit = e->IntAttribute("Bit");
-        std::string name = e->Attribute("Name");
-        const char* typeCStr = e->Attribute("Type");
-        std::string type;
-        if (typeCStr) {
-            type = typeCStr;
+    void on_product_option(std::string_view name, const XmlAttributes& attributes) {
+        if (itemsTarget != ItemsTarget::NONE) {
+            return;
+        }
+        if ((name == "COFFEE_STRENGTH" && !strength) || (name == "TEMPERATURE" && !temperature)) {
+            const std::optional<std::string_view> argument = get_required(attributes, name, "Argument");
+            const std::optional<std::string_view> defaultValue = get_required(attributes, name, "Default");
+            if (argument && defaultValue) {
+                itemsTarget = name == "COFFEE_STRENGTH" ? ItemsTarget::STRENGTH : ItemsTarget::TEMPERATURE;
+                itemsArgument = arena.intern(*argument);
+                itemsDefaultValue = arena.intern(*defaultValue);
+                items.clear();
+            }
+        } else if ((name == "WATER_AMOUNT" && !waterAmount) || (name == "MILK_FOAM_AMOUNT" && !milkFoamAmount)) {
+            const std::optional<std::string_view> argument = get_required(attributes, name, "Argument");
+            const std::optional<uint8_t> value = get_int<uint8_t>(attributes, name, "Value");
+            const std::optional<uint8_t> min = get_int<uint8_t>(attributes, name, "Min");
+            const std::optional<uint8_t> max = get_int<uint8_t>(attributes, name, "Max");
+            const std::optional<uint8_t> step = get_int<uint8_t>(attributes, name, "Step");
+            if (argument && value && min && max && step) {
+                (name == "WATER_AMOUNT" ? waterAmount : milkFoamAmount).emplace(arena.intern(*argument), *value, *min, *max, *step);
+            }
         }
-        alerts->emplace_back(bit, std::move(name), std::move(type));
     }
-}
 
-void load_maintenance_counters(std::vector<MaintenanceCounter>& maintenanceCounters, tinyxml2::XMLElement* joe) {
-    tinyxml2::XMLElement* statisticXml = joe->FirstChildElement("STATISTIC");
-    assert(statisticXml);
-    tinyxml2::XMLElement* maintenanceXml = statisticXml->FirstChildElement("MAINTENANCEPAGE");
-    assert(maintenanceXml);
+    void on_maintenance_bank(const XmlAttributes& attributes) {
+        const std::optional<std::string_view> name = get_required(attributes, "BANK", "Name");
+        if (name == "Maintenance Counter" && !maintenanceCountersDone) {
+            bank = Bank::MAINTENANCE_COUNTER;
+        } else if (name == "Maintenance Percent" && !maintenancePercentagesDone) {
+            bank = Bank::MAINTENANCE_PERCENT;
+        }
+    }
 
-    for (const tinyxml2::XMLElement* bankXml = maintenanceXml->FirstChildElement("BANK"); bankXml != nullptr; bankXml = bankXml->NextSiblingElement("BANK")) {
-        std::string name = bankXml->Attribute("Name");
-        if (name == "Maintenance Counter") {
-            for (const tinyxml2::XMLElement* e = bankXml->FirstChildElement("TEXTITEM"); e != nullptr; e = e->NextSiblingElement("TEXTITEM")) {
-                std::string name = e->Attribute("Type");
-                maintenanceCounters.emplace_back(std::move(name), 0);
-            }
-            break;
+    void on_text_item(const XmlAttributes& attributes) {
+        if (bank == Bank::NONE) {
+            return;
+        }
+        const std::optional<std::string_view> type = get_required(attributes, "TEXTITEM", "Type");
+        if (!type) {
+            return;
+        }
+        if (bank == Bank::MAINTENANCE_COUNTER) {
+            maintenanceCounters.emplace_back(arena.intern(*type), 0);
+        } else {
+            maintenancePercentages.emplace_back(arena.intern(*type), 0);
         }
     }
-}
 
-void load_maintenance_percentages(std::vector<MaintenancePercentage>& maintenancePercentages, tinyxml2::XMLElement* joe) {
-    tinyxml2::XMLElement* statisticXml = joe->FirstChildElement("STATISTIC");
-    assert(statisticXml);
-    tinyxml2::XMLElement* maintenanceXml = statisticXml->FirstChildElement("MAINTENANCEPAGE");
-    assert(maintenanceXml);
+ public:
+    JoeXmlParser(XmlReader& reader, Arena& arena) : reader(reader),
+                                                    arena(arena) {}
 
-    for (const tinyxml2::XMLElement* bankXml = maintenanceXml->FirstChildElement("BANK"); bankXml != nullptr; bankXml = bankXml->NextSiblingElement("BANK")) {
-        std::string name = bankXml->Attribute("Name");
-        if (name == "Maintenance Percent") {
-            for (const tinyxml2::XMLElement* e = bankXml->FirstChildElement("TEXTITEM"); e != nullptr; e = e->NextSiblingElement("TEXTITEM")) {
-                std::string name = e->Attribute("Type");
-                maintenancePercentages.emplace_back(std::move(name), 0);
+    void on_start_element(std::string_view name, const XmlAttributes& attributes) {
+        const std::span<const std::string> path = reader.get_open_elements();
+        if (path.size() == 1) {
+            if (name != "JOE") {
+                reader.fail("Expected 'JOE' as root element, but found '" + std::string{name} + "'.");
+                return;
+            }
+            const std::optional<std::string_view> value = get_required(attributes, name, "dated");
+            if (value) {
+                dated = arena.intern(*value);
             }
-            break;
+        } else if (path.size() == 3 && path[1] == "PRODUCTS" && name == "PRODUCT") {
+            const std::optional<std::string_view> productNameValue = get_required(attributes, name, "Name");
+            const std::optional<std::string_view> productCodeValue = get_required(attributes, name, "Code");
+            if (productNameValue && productCodeValue) {
+                productName = arena.intern(*productNameValue);
+                productCode = arena.intern(*productCodeValue);
+            }
+        } else if (path.size() == 4 && path[1] == "PRODUCTS" && path[2] == "PRODUCT") {
+            on_product_option(name, attributes);
+        } else if (path.size() == 5 && itemsTarget != ItemsTarget::NONE && path[2] == "PRODUCT" && name == "ITEM") {
+            const std::optional<std::string_view> itemName = get_required(attributes, name, "Name");
+            const std::optional<std::string_view> itemValue = get_required(attributes, name, "Value");
+            if (itemName && itemValue) {
+                items.emplace_back(arena.intern(*itemName), arena.intern(*itemValue));
+            }
+        } else if (path.size() == 3 && path[1] == "ALERTS" && name == "ALERT") {
+            std::optional<size_t> bit = get_int<size_t>(attributes, name, "Bit");
+            if (bit && *bit > Alert::MAX_BIT) {
+                // The machine status can not carry it, so the snapshot and embedded tables could not store it either:
+                reader.fail("Invalid value '" + std::to_string(*bit) + "' for attribute 'Bit' in '" + std::string{name} + "'. Expected at most " + std::to_string(Alert::MAX_BIT) + ".");
+                bit = std::nullopt;
+            }
+            const std::optional<std::string_view> alertName = get_required(attributes, name, "Name");
+            if (bit && alertName) {
+                alerts.emplace_back(*bit, arena.intern(*alertName), arena.intern(attributes.get("Type").value_or("")));
+            }
+        } else if (path.size() == 4 && path[1] == "STATISTIC" && path[2] == "MAINTENANCEPAGE" && name == "BANK") {
+            on_maintenance_bank(attributes);
+        } else if (path.size() == 5 && path[1] == "STATISTIC" && path[3] == "BANK" && name == "TEXTITEM") {
+            on_text_item(attributes);
         }
     }
-}
-
-std::shared_ptr<Joe> load_joe(const Machine* machine) {
-    tinyxml2::XMLDocument doc;
-    std::string path = "machinefiles/" + machine->fileName + ".xml";
-    SPDLOG_INFO("Loading JOE from '{}'...", path);
-    tinyxml2::XMLError result = doc.LoadFile(path.c_str());
-    assert(result == tinyxml2::XML_SUCCESS);
-    tinyxml2::XMLElement* joe = doc.FirstChildElement("JOE");
 
-    std::string dated = joe->Attribute("dated");
-    std::vector<Product> products;
-    load_products(&products, joe);
-    std::vector<Alert> alerts;
-    load_alerts(&alerts, joe);
+    void on_end_element(std::string_view name) {
+        const std::span<const std::string> path = reader.get_open_elements();
+        if (path.size() == 4 && path[2] == "PRODUCT" && itemsTarget != ItemsTarget::NONE && (name == "COFFEE_STRENGTH" || name == "TEMPERATURE")) {
+            (itemsTarget == ItemsTarget::STRENGTH ? strength : temperature).emplace(itemsArgument, itemsDefaultValue, arena.store<Item>(items));
+            itemsTarget = ItemsTarget::NONE;
+            items.clear();
+        } else if (path.size() == 3 && path[1] == "PRODUCTS" && name == "PRODUCT") {
+            products.emplace_back(productName, productCode, strength, temperature, waterAmount, milkFoamAmount);
+            strength.reset();
+            temperature.reset();
+            waterAmount.reset();
+            milkFoamAmount.reset();
+        } else if (path.size() == 4 && path[1] == "STATISTIC" && name == "BANK") {
+            maintenanceCountersDone |= bank == Bank::MAINTENANCE_COUNTER;
+            maintenancePercentagesDone |= bank == Bank::MAINTENANCE_PERCENT;
+            bank = Bank::NONE;
+        }
+    }
 
-    std::vector<MaintenanceCounter> maintenanceCounters;
-    load_maintenance_counters(maintenanceCounters, joe);
+    std::shared_ptr<const JoeDefinition> to_joe_definition(std::shared_ptr<const Arena> arena, std::shared_ptr<const Machine> machine) {
+        return std::make_shared<const JoeDefinition>(std::move(arena), *dated, std::move(machine), std::move(products), std::move(alerts), std::move(maintenanceCounters), std::move(maintenancePercentages));
+    }
+};
 
-    std::vector<MaintenancePercentage> maintenancePercentages;
-    load_maintenance_percentages(maintenancePercentages, joe);
+std::shared_ptr<const JoeDefinition> load_joe(std::shared_ptr<const Machine> machine, std::istream& in, std::string_view name, std::shared_ptr<Arena> arena) {
+    if (!arena) {
+        arena = std::make_shared<Arena>();
+    }
+    XmlReader reader(in);
+    JoeXmlParser parser(reader, *arena);
+    const bool success = reader.parse([&parser](std::string_view element, const XmlAttributes& attributes) { parser.on_start_element(element, attributes); },
+                                      [&parser](std::string_view element) { parser.on_end_element(element); });
+    if (!success) {
+        const XmlError& error = *reader.get_error();
+        SPDLOG_ERROR("Failed to parse machine file '{}' at line {}, column {}: {}", name, error.line, error.column, error.message);
+        return nullptr;
+    }
+    return parser.to_joe_definition(std::move(arena), std::move(machine));
+}
 
-    SPDLOG_INFO("JOE loaded.");
-    return std::make_shared<Joe>(std::move(dated), machine, std::move(products), std::move(alerts), std::move(maintenanceCounters), std::move(maintenancePercentages));
+std::shared_ptr<const JoeDefinition> load_joe(std::shared_ptr<const Machine> machine, const std::filesystem::path& directory, std::shared_ptr<Arena> arena) {
+    const std::string path = (directory / (std::string{machine->fileName} + ".xml")).string();
+    SPDLOG_INFO("Loading JOE from '{}'...", path);
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        SPDLOG_ERROR("Failed to open machine file '{}'.", path);
+        return nullptr;
+    }
+    std::shared_ptr<const JoeDefinition> result = load_joe(std::move(machine), in, path, std::move(arena));
+    if (result) {
+        SPDLOG_INFO("JOE loaded.");
+    }
+    return result;
 }
 //---------------------------------------------------------------------------
 }  // namespace jutta_bt_proto
@@ -0,0 +1,30 @@
+#include "jutta_bt_proto/EmbeddedMachines.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <span>
+
+#ifdef JUTTA_BT_PROTO_EMBED_MACHINES
+// Generated from the machine files during the build:
+#include "jutta_bt_proto/EmbeddedMachineFiles.hpp"
+#endif
+
+// Kept apart from EmbeddedMachines.cpp, since jutta_machine_codegen uses it before the tables got generated.
+//---------------------------------------------------------------------------
+namespace jutta_bt_proto {
+//---------------------------------------------------------------------------
+std::span<const embedded::Machine> get_embedded_machines() {
+#ifdef JUTTA_BT_PROTO_EMBED_MACHINES
+    return embedded::machines::MACHINES;
+#else
+    return {};
+#endif
+}
+
+const embedded::Machine* find_embedded_machine(size_t articleNumber) {
+    const std::span<const embedded::Machine> machines = get_embedded_machines();
+    auto iter = std::lower_bound(machines.begin(), machines.end(), articleNumber, [](const embedded::Machine& machine, size_t articleNumber) { return machine.articleNumber < articleNumber; });
+    return iter != machines.end() && iter->articleNumber == articleNumber ? &*iter : nullptr;
+}
+//---------------------------------------------------------------------------
+}  // namespace jutta_bt_proto
+//---------------------------------------------------------------------------
@@ -0,0 +1,231 @@
+#include "jutta_bt_proto/EmbeddedMachines.hpp"
+#include "jutta_bt_proto/Arena.hpp"
+#include "jutta_bt_proto/CoffeeMakerLoader.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include <spdlog/fmt/fmt.h>
+
+//---------------------------------------------------------------------------
+namespace jutta_bt_proto {
+//---------------------------------------------------------------------------
+Machines to_machines(std::span<const embedded::Machine> machines) {
+    Machines result;
+    for (const embedded::Machine& machine : machines) {
+        result.emplace(machine.articleNumber, Machine(machine.articleNumber, machine.name, machine.fileName, machine.version));
+    }
+    return result;
+}
+
+std::shared_ptr<const JoeDefinition> load_joe(std::shared_ptr<const Machine> machine, const embedded::Definition& definition) {
+    // The strings are static, so the arena only holds the items:
+    const std::shared_ptr<Arena> arena = std::make_shared<Arena>();
+    std::vector<Item> items;
+    auto to_items_option = [&arena, &items](const embedded::ItemsOption* option) -> std::optional<ItemsOption> {
+        if (!option) {
+            return std::nullopt;
+        }
+        items.clear();
+        for (const embedded::Item& item : option->items) {
+            items.emplace_back(item.name, item.value);
+        }
+        return std::make_optional<ItemsOption>(option->argument, option->defaultValue, arena->store<Item>(items));
+    };
+    auto to_min_max_option = [](const embedded::MinMaxOption* option) -> std::optional<MinMaxOption> {
+        if (!option) {
+            return std::nullopt;
+        }
+        return std::make_optional<MinMaxOption>(option->argument, option->value, option->min, option->max, option->step);
+    };
+
+    std::vector<Product> products;
+    products.reserve(definition.products.size());
+    for (const embedded::Product& product : definition.products) {
+        products.emplace_back(product.name, product.code, to_items_option(product.strength), to_items_option(product.temperature), to_min_max_option(product.waterAmount), to_min_max_option(product.milkFoamAmount));
+    }
+
+    std::vector<Alert> alerts;
+    alerts.reserve(definition.alerts.size());
+    for (const embedded::Alert& alert : definition.alerts) {
+        alerts.emplace_back(alert.bit, alert.name, alert.type);
+    }
+
+    std::vector<MaintenanceCounter> maintenanceCounters;
+    for (const std::string_view name : definition.maintenanceCounters) {
+        maintenanceCounters.emplace_back(name, 0);
+    }
+
+    std::vector<MaintenancePercentage> maintenancePercentages;
+    for (const std::string_view name : definition.maintenancePercentages) {
+        maintenancePercentages.emplace_back(name, 0);
+    }
+
+    return std::make_shared<const JoeDefinition>(arena, definition.dated, std::move(machine), std::move(products), std::move(alerts), std::move(maintenanceCounters), std::move(maintenancePercentages));
+}
+
+/**
+ * Returns the given string as C++ string literal.
+ * Uses octal escapes for everything except printable ASCII, since they can not swallow the following characters like hex escapes.
+ **/
+std::string to_cpp_string(std::string_view str) {
+    std::string result = "\"";
+    for (const char c : str) {
+        const auto b = static_cast<uint8_t>(c);
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += c;
+        } else if (b >= 0x20 && b < 0x7F) {
+            result += c;
+        } else {
+            fmt::format_to(std::back_inserter(result), "\\{:03o}", b);
+        }
+    }
+    result += '"';
+    return result;
+}
+
+/**
+ * Returns a valid and unique C++ identifier for the given machine file name.
+ **/
+std::string to_cpp_identifier(std::string_view fileName, std::unordered_set<std::string>& used) {
+    std::string result;
+    for (const char c : fileName) {
+        result += std::isalnum(static_cast<unsigned char>(c)) ? c : '_';
+    }
+    if (result.empty() || std::isdigit(static_cast<unsigned char>(result.front()))) {
+        result.insert(0, "M_");
+    }
+    std::string unique = result;
+    for (size_t i = 2; !used.insert(unique).second; i++) {
+        unique = result + "_" + std::to_string(i);
+    }
+    return unique;
+}
+
+/**
+ * Writes the tables of a single definition into their own namespace followed by the definition itself.
+ **/
+void append_definition(std::string& out, const JoeDefinition& definition, std::string_view identifier) {
+    auto out_iter = std::back_inserter(out);
+    fmt::format_to(out_iter, "namespace {}_tables {{\n", identifier);
+
+    size_t itemsOptionCount = 0;
+    auto append_items_option = [&out, &out_iter, &itemsOptionCount](const std::optional<ItemsOption>& option) -> std::string {
+        if (!option) {
+            return "nullptr";
+        }
+        const size_t index = itemsOptionCount++;
+        fmt::format_to(out_iter, "inline constexpr std::array<Item, {}> ITEMS_{}{{{{", option->items.size(), index);
+        for (size_t i = 0; i < option->items.size(); i++) {
+            fmt::format_to(out_iter, "{}{{{}, {}}}", i == 0 ? "" : ", ", to_cpp_string(option->items[i].name), to_cpp_string(option->items[i].value));
+        }
+        out += "}};\n";
+        fmt::format_to(out_iter, "inline constexpr ItemsOption ITEMS_OPTION_{}{{{}, {}, ITEMS_{}}};\n", index, to_cpp_string(option->argument), to_cpp_string(option->defaultValue), index);
+        return fmt::format("&ITEMS_OPTION_{}", index);
+    };
+    size_t minMaxOptionCount = 0;
+    auto append_min_max_option = [&out_iter, &minMaxOptionCount](const std::optional<MinMaxOption>& option) -> std::string {
+        if (!option) {
+            return "nullptr";
+        }
+        const size_t index = minMaxOptionCount++;
+        fmt::format_to(out_iter, "inline constexpr MinMaxOption MIN_MAX_OPTION_{}{{{}, {}, {}, {}, {}}};\n", index, to_cpp_string(option->argument), option->value, option->min, option->max, option->step);
+        return fmt::format("&MIN_MAX_OPTION_{}", index);
+    };
+
+    std::vector<std::string> products;
+    products.reserve(definition.products.size());
+    for (const Product& product : definition.products) {
+        const std::string strength = append_items_option(product.strength);
+        const std::string temperature = append_items_option(product.temperature);
+        const std::string waterAmount = append_min_max_option(product.waterAmount);
+        const std::string milkFoamAmount = append_min_max_option(product.milkFoamAmount);
+        products.push_back(fmt::format("{{{}, {}, {}, {}, {}, {}}}", to_cpp_string(product.name), to_cpp_string(product.code), strength, temperature, waterAmount, milkFoamAmount));
+    }
+    fmt::format_to(out_iter, "inline constexpr std::array<Product, {}> PRODUCTS{{{{", products.size());
+    for (size_t i = 0; i < products.size(); i++) {
+        fmt::format_to(out_iter, "{}\n    {}", i == 0 ? "" : ",", products[i]);
+    }
+    out += "}};\n";
+
+    fmt::format_to(out_iter, "inline constexpr std::array<Alert, {}> ALERTS{{{{", definition.alerts.size());
+    for (size_t i = 0; i < definition.alerts.size(); i++) {
+        const Alert& alert = definition.alerts[i];
+        fmt::format_to(out_iter, "{}\n    {{{}, {}, {}}}", i == 0 ? "" : ",", alert.bit, to_cpp_string(alert.name), to_cpp_string(alert.type));
+    }
+    out += "}};\n";
+
+    fmt::format_to(out_iter, "inline constexpr std::array<std::string_view, {}> MAINTENANCE_COUNTERS{{", definition.maintenanceCounters.size());
+    for (size_t i = 0; i < definition.maintenanceCounters.size(); i++) {
+        fmt::format_to(out_iter, "{}{}", i == 0 ? "" : ", ", to_cpp_string(definition.maintenanceCounters[i].name));
+    }
+    out += "};\n";
+    fmt::format_to(out_iter, "inline constexpr std::array<std::string_view, {}> MAINTENANCE_PERCENTAGES{{", definition.maintenancePercentages.size());
+    for (size_t i = 0; i < definition.maintenancePercentages.size(); i++) {
+        fmt::format_to(out_iter, "{}{}", i == 0 ? "" : ", ", to_cpp_string(definition.maintenancePercentages[i].name));
+    }
+    out += "};\n";
+
+    fmt::format_to(out_iter, "}}  // namespace {0}_tables\n"
+                             "inline constexpr Definition {0}{{{1}, {2}, {0}_tables::PRODUCTS, {0}_tables::ALERTS, {0}_tables::MAINTENANCE_COUNTERS, {0}_tables::MAINTENANCE_PERCENTAGES}};\n\n",
+                   identifier, to_cpp_string(definition.machine->fileName), to_cpp_string(definition.dated));
+}
+
+std::string to_embedded_header(const Machines& machines, std::span<const std::shared_ptr<const JoeDefinition>> definitions, std::string_view nameSpace) {
+    std::string out = fmt::format("// Generated by jutta_machine_codegen from JOE_MACHINES.TXT and the machine files it references. Do not edit.\n"
+                                  "#pragma once\n\n"
+                                  "#include \"jutta_bt_proto/EmbeddedMachines.hpp\"\n"
+                                  "#include <array>\n"
+                                  "#include <string_view>\n\n"
+                                  "//---------------------------------------------------------------------------\n"
+                                  "namespace {} {{\n"
+                                  "//---------------------------------------------------------------------------\n",
+                                  nameSpace);
+
+    std::unordered_set<std::string> usedIdentifiers;
+    std::unordered_map<std::string_view, std::string> identifiersByFileName;
+    for (const std::shared_ptr<const JoeDefinition>& definition : definitions) {
+        if (!definition || !definition->machine || identifiersByFileName.contains(definition->machine->fileName)) {
+            continue;
+        }
+        std::string identifier = to_cpp_identifier(definition->machine->fileName, usedIdentifiers);
+        append_definition(out, *definition, identifier);
+        identifiersByFileName.emplace(definition->machine->fileName, std::move(identifier));
+    }
+
+    // Sorted, so machines can be found by binary search:
+    std::vector<const Machine*> sorted;
+    sorted.reserve(machines.size());
+    for (const auto& [articleNumber, machine] : machines) {
+        sorted.push_back(&machine);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const Machine* a, const Machine* b) { return a->articleNumber < b->articleNumber; });
+
+    auto out_iter = std::back_inserter(out);
+    fmt::format_to(out_iter, "inline constexpr std::array<Machine, {}> MACHINES{{{{", sorted.size());
+    for (size_t i = 0; i < sorted.size(); i++) {
+        const Machine& machine = *sorted[i];
+        auto iter = identifiersByFileName.find(machine.fileName);
+        fmt::format_to(out_iter, "{}\n    {{{}, {}, {}, {}, {}}}", i == 0 ? "" : ",", machine.articleNumber, to_cpp_string(machine.name), to_cpp_string(machine.fileName), machine.version, iter == identifiersByFileName.end() ? "nullptr" : "&" + iter->second);
+    }
+    fmt::format_to(out_iter, "}}}};\n"
+                             "//---------------------------------------------------------------------------\n"
+                             "}}  // namespace {}\n"
+                             "//---------------------------------------------------------------------------\n",
+                   nameSpace);
+    return out;
+}
+//---------------------------------------------------------------------------
+}  // namespace jutta_bt_proto
+//---------------------------------------------------------------------------
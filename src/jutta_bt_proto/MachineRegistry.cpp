@@ -0,0 +1,429 @@
+#include "jutta_bt_proto/MachineRegistry.hpp"
+#include "jutta_bt_proto/EmbeddedMachines.hpp"
+#include "logger/Logger.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <spdlog/spdlog.h>
+
+//---------------------------------------------------------------------------
+namespace jutta_bt_proto {
+//---------------------------------------------------------------------------
+MachineRegistry::MachineRegistry(std::filesystem::path path) : path(std::move(path)) {}
+
+MachineRegistry& MachineRegistry::get_instance() {
+    static MachineRegistry instance;
+    return instance;
+}
+
+void MachineRegistry::set_path(std::filesystem::path path) {
+    const std::scoped_lock lock(mutex);
+    if (path == this->path) {
+        return;
+    }
+    this->path = std::move(path);
+    machines = nullptr;
+    snapshot = nullptr;
+    clear_joe_definitions();
+}
+
+std::filesystem::path MachineRegistry::get_path() const {
+    const std::scoped_lock lock(mutex);
+    return path;
+}
+
+std::shared_ptr<const Machines> MachineRegistry::get_machines() {
+    const std::scoped_lock lock(mutex);
+    if (!machines) {
+        load();
+    }
+    return machines;
+}
+
+std::shared_ptr<const Machines> MachineRegistry::reload() {
+    const std::scoped_lock lock(mutex);
+    load();
+    clear_joe_definitions();
+    return machines;
+}
+
+/**
+ * Machines together with the arena their names are stored in.
+ **/
+struct ArenaMachines {
+    std::shared_ptr<const Arena> arena;
+    Machines machines;
+} __attribute__((aligned(64)));
+
+void MachineRegistry::load() {
+    embedded = path == DEFAULT_PATH && !get_embedded_machines().empty();
+    if (embedded) {
+        snapshot = nullptr;
+        machines = std::make_shared<const Machines>(to_machines(get_embedded_machines()));
+        SPDLOG_INFO("Using {} embedded machines.", machines->size());
+        return;
+    }
+
+    snapshot = MachineSnapshot::open(to_snapshot_path(path));
+    // Start a new arena, so the previous one gets freed once nobody uses the old machines and definitions any more:
+    arena = std::make_shared<Arena>();
+    const std::shared_ptr<ArenaMachines> loaded = std::make_shared<ArenaMachines>(ArenaMachines{arena, snapshot ? snapshot->to_machines(*arena) : load_machines(path, *arena)});
+    // Keep the arena alive as long as anyone holds on to the machines:
+    machines = std::shared_ptr<const Machines>(loaded, &loaded->machines);
+}
+
+std::shared_ptr<const MachineSnapshot> MachineRegistry::get_snapshot() {
+    const std::scoped_lock lock(mutex);
+    if (!machines) {
+        load();
+    }
+    return snapshot;
+}
+
+bool MachineRegistry::is_embedded() {
+    const std::scoped_lock lock(mutex);
+    if (!machines) {
+        load();
+    }
+    return embedded;
+}
+
+std::shared_ptr<const Arena> MachineRegistry::get_arena() const { return get_current_arena(); }
+
+std::shared_ptr<Arena> MachineRegistry::get_current_arena() const {
+    const std::scoped_lock lock(mutex);
+    return arena;
+}
+
+bool MachineRegistry::is_loaded() const {
+    const std::scoped_lock lock(mutex);
+    return machines != nullptr;
+}
+
+std::shared_ptr<const Machine> MachineRegistry::get_machine(size_t articleNumber) {
+    const std::shared_ptr<const Machines> machines = get_machines();
+    auto iter = machines->find(articleNumber);
+    if (iter == machines->end()) {
+        return nullptr;
+    }
+    // Keep all machines alive as long as one of them is in use:
+    return std::shared_ptr<const Machine>(machines, &iter->second);
+}
+
+std::shared_ptr<const JoeDefinition> MachineRegistry::get_joe_definition(size_t articleNumber) {
+    // NOLINTNEXTLINE (altera-id-dependent-backward-branch)
+    while (true) {
+        size_t loadGeneration = 0;
+        {
+            const std::scoped_lock lock(definitionsMutex);
+            auto iter = definitions.find(articleNumber);
+            if (iter != definitions.end()) {
+                return iter->second;
+            }
+            loadGeneration = generation;
+        }
+
+        std::shared_ptr<const Machine> machine = get_machine(articleNumber);
+        if (!machine) {
+            return nullptr;
+        }
+        // Parse without holding the lock, so other models can be looked up in the meantime:
+        bool fromSnapshot = false;
+        std::shared_ptr<const JoeDefinition> definition = load_joe_definition(std::move(machine), fromSnapshot);
+        if (!definition) {
+            return nullptr;
+        }
+        definition = cache_joe_definition(std::move(definition), loadGeneration);
+        if (definition) {
+            return definition;
+        }
+        SPDLOG_DEBUG("Machines changed while loading the definition for article number {}. Loading it again.", articleNumber);
+    }
+}
+
+std::shared_ptr<const JoeDefinition> MachineRegistry::cache_joe_definition(std::shared_ptr<const JoeDefinition> definition, size_t loadGeneration) {
+    const std::scoped_lock lock(definitionsMutex);
+    if (generation != loadGeneration) {
+        return nullptr;
+    }
+    // In case someone else was faster, use their definition:
+    return definitions.try_emplace(definition->machine->articleNumber, std::move(definition)).first->second;
+}
+
+std::shared_ptr<const JoeDefinition> MachineRegistry::load_joe_definition(std::shared_ptr<const Machine> machine, bool& fromSnapshot) {
+    fromSnapshot = false;
+    if (is_embedded()) {
+        const embedded::Machine* embeddedMachine = find_embedded_machine(machine->articleNumber);
+        if (!embeddedMachine || !embeddedMachine->definition) {
+            SPDLOG_ERROR("No embedded machine file for '{}'.", machine->name);
+            return nullptr;
+        }
+        return load_joe(std::move(machine), *embeddedMachine->definition);
+    }
+
+    // In case the machines get replaced in the meantime, the definition does not get cached (see generation):
+    return load_joe_definition(std::move(machine), get_snapshot(), get_path().parent_path(), get_current_arena(), fromSnapshot);
+}
+
+std::shared_ptr<const JoeDefinition> MachineRegistry::load_joe_definition(std::shared_ptr<const Machine> machine, const std::shared_ptr<const MachineSnapshot>& snapshot, const std::filesystem::path& directory, const std::shared_ptr<Arena>& arena, bool& fromSnapshot) {
+    fromSnapshot = false;
+    if (snapshot) {
+        std::shared_ptr<const JoeDefinition> definition = snapshot->to_joe_definition(machine, arena);
+        if (definition) {
+            fromSnapshot = true;
+            return definition;
+        }
+    }
+
+    const std::filesystem::path xmlPath = directory / (std::string{machine->fileName} + ".xml");
+    if (!std::filesystem::exists(xmlPath)) {
+        SPDLOG_ERROR("Machine file '{}' for '{}' not found.", xmlPath.string(), machine->name);
+        return nullptr;
+    }
+    return load_joe(std::move(machine), directory, arena);
+}
+
+std::vector<PreloadResult> MachineRegistry::preload(size_t threadCount) {
+    size_t loadGeneration = 0;
+    {
+        const std::scoped_lock lock(definitionsMutex);
+        loadGeneration = generation;
+    }
+    const std::shared_ptr<const Machines> allMachines = get_machines();
+    std::vector<std::shared_ptr<const Machine>> pending;
+    {
+        const std::scoped_lock lock(definitionsMutex);
+        for (const auto& [articleNumber, machine] : *allMachines) {
+            if (!definitions.contains(articleNumber)) {
+                pending.emplace_back(allMachines, &machine);
+            }
+        }
+    }
+
+    // In case the machines get replaced in the meantime, the definitions do not get cached (see generation):
+    const bool embeddedMachines = is_embedded();
+    const std::shared_ptr<const MachineSnapshot> currentSnapshot = embeddedMachines ? nullptr : get_snapshot();
+    const std::filesystem::path directory = get_path().parent_path();
+
+    SPDLOG_INFO("Preloading {} machine definitions on {} threads...", pending.size(), threadCount);
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<PreloadResult> results(pending.size());
+    std::atomic<size_t> next{0};
+    auto worker = [this, &pending, &results, &next, loadGeneration, embeddedMachines, &currentSnapshot, &directory]() {
+        // Each thread stores its strings inside an arena of its own instead of contending for the lock of the shared one.
+        // Strings used by multiple models get stored once per thread instead of once per preload.
+        const std::shared_ptr<Arena> threadArena = std::make_shared<Arena>();
+        for (size_t i = next++; i < pending.size(); i = next++) {
+            const std::chrono::steady_clock::time_point loadStart = std::chrono::steady_clock::now();
+            PreloadResult& result = results[i];
+            result.articleNumber = pending[i]->articleNumber;
+            result.fileName = pending[i]->fileName;
+            std::shared_ptr<const JoeDefinition> definition = embeddedMachines ? load_joe_definition(pending[i], result.fromSnapshot) : load_joe_definition(pending[i], currentSnapshot, directory, threadArena, result.fromSnapshot);
+            result.success = definition != nullptr;
+            if (definition && !cache_joe_definition(std::move(definition), loadGeneration)) {
+                SPDLOG_INFO("Not caching the preloaded definition for article number {}, since the machines changed in the meantime.", result.articleNumber);
+            }
+            result.duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - loadStart);
+            SPDLOG_INFO("Preloaded '{}' for article number {} in {} ms{}.", result.fileName, result.articleNumber, static_cast<double>(result.duration.count()) / 1000, result.success ? "" : " (failed)");
+        }
+    };
+
+    threadCount = std::clamp<size_t>(threadCount, 1, std::max<size_t>(pending.size(), 1));
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount - 1);
+    for (size_t i = 1; i < threadCount; i++) {
+        threads.emplace_back(worker);
+    }
+    // The calling thread helps as well:
+    worker();
+    for (std::thread& t : threads) {
+        t.join();
+    }
+
+    const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    const auto failed = static_cast<size_t>(std::count_if(results.begin(), results.end(), [](const PreloadResult& result) { return !result.success; }));
+    SPDLOG_INFO("Preloaded {} machine definitions in {} ms. {} failed.", results.size() - failed, duration.count(), failed);
+    return results;
+}
+
+void MachineRegistry::clear_joe_definitions() {
+    const std::scoped_lock lock(definitionsMutex);
+    definitions.clear();
+    generation++;
+}
+
+size_t MachineRegistry::get_joe_definition_count() const {
+    const std::scoped_lock lock(definitionsMutex);
+    return definitions.size();
+}
+
+bool MachineRegistry::refresh_machines() {
+    std::filesystem::path currentPath;
+    {
+        const std::scoped_lock lock(mutex);
+        if (embedded) {
+            SPDLOG_WARN("Embedded machines do not get refreshed.");
+            return false;
+        }
+        currentPath = path;
+    }
+
+    // Parse without holding any lock, so lookups keep using the current machines in the meantime:
+    // The new machines and definitions get an arena of their own, so the old one gets freed once nobody uses them any more:
+    const std::shared_ptr<Arena> newArena = std::make_shared<Arena>();
+    std::shared_ptr<const MachineSnapshot> newSnapshot;
+    std::shared_ptr<ArenaMachines> loaded;
+    try {
+        newSnapshot = MachineSnapshot::open(to_snapshot_path(currentPath));
+        loaded = std::make_shared<ArenaMachines>(ArenaMachines{newArena, newSnapshot ? newSnapshot->to_machines(*newArena) : load_machines(currentPath, *newArena)});
+    } catch (const std::exception& e) {
+        SPDLOG_WARN("Failed to refresh machines from '{}': {}", currentPath.string(), e.what());
+        return false;
+    }
+    if (loaded->machines.empty()) {
+        SPDLOG_WARN("Not refreshing machines, since '{}' does not contain any.", currentPath.string());
+        return false;
+    }
+    const std::shared_ptr<const Machines> newMachines(loaded, &loaded->machines);
+
+    // The cached definitions refer to the old machines, so all of them get parsed again:
+    std::vector<size_t> cached;
+    {
+        const std::scoped_lock lock(definitionsMutex);
+        cached.reserve(definitions.size());
+        for (const auto& [articleNumber, definition] : definitions) {
+            cached.push_back(articleNumber);
+        }
+    }
+    std::unordered_map<size_t, std::shared_ptr<const JoeDefinition>> newDefinitions;
+    for (const size_t articleNumber : cached) {
+        auto iter = newMachines->find(articleNumber);
+        if (iter == newMachines->end()) {
+            SPDLOG_INFO("Machine with article number {} got removed.", articleNumber);
+            continue;
+        }
+        bool fromSnapshot = false;
+        std::shared_ptr<const JoeDefinition> definition = load_joe_definition(std::shared_ptr<const Machine>(newMachines, &iter->second), newSnapshot, currentPath.parent_path(), newArena, fromSnapshot);
+        if (!definition || !validate_joe_definition(*definition)) {
+            SPDLOG_WARN("Not refreshing machines, since the machine file '{}' is invalid.", iter->second.fileName);
+            return false;
+        }
+        newDefinitions.emplace(articleNumber, std::move(definition));
+    }
+
+    // Publish machines and definitions together:
+    const std::scoped_lock lock(mutex, definitionsMutex);
+    if (path != currentPath) {
+        SPDLOG_INFO("Dropping refreshed machines, since the path changed in the meantime.");
+        return false;
+    }
+    machines = newMachines;
+    snapshot = newSnapshot;
+    arena = newArena;
+    definitions = std::move(newDefinitions);
+    generation++;
+    SPDLOG_INFO("Refreshed {} machines and {} machine definitions.", machines->size(), definitions.size());
+    return true;
+}
+
+bool MachineRegistry::refresh_joe_definitions(std::string_view fileName) {
+    std::filesystem::path directory;
+    std::shared_ptr<const MachineSnapshot> currentSnapshot;
+    {
+        const std::scoped_lock lock(mutex);
+        if (embedded) {
+            SPDLOG_WARN("Embedded machines do not get refreshed.");
+            return false;
+        }
+        directory = path.parent_path();
+        currentSnapshot = snapshot;
+    }
+
+    // The snapshot still contains the old definition, so stop using it:
+    if (currentSnapshot && currentSnapshot->is_stale(directory)) {
+        // Definitions still being loaded from it are outdated as well:
+        const std::scoped_lock lock(mutex, definitionsMutex);
+        if (snapshot == currentSnapshot) {
+            snapshot = nullptr;
+            generation++;
+        }
+    }
+
+    std::vector<std::shared_ptr<const JoeDefinition>> cached;
+    {
+        const std::scoped_lock lock(definitionsMutex);
+        for (const auto& [articleNumber, definition] : definitions) {
+            if (definition->machine->fileName == fileName) {
+                cached.push_back(definition);
+            }
+        }
+    }
+
+    // Parse without holding any lock, so coffee makers keep getting served the current definitions in the meantime.
+    // They get an arena of their own, so refreshing a file again and again does not grow the arena of the machines:
+    const std::shared_ptr<Arena> newArena = std::make_shared<Arena>();
+    std::vector<std::shared_ptr<const JoeDefinition>> refreshed;
+    refreshed.reserve(cached.size());
+    for (const std::shared_ptr<const JoeDefinition>& definition : cached) {
+        bool fromSnapshot = false;
+        std::shared_ptr<const JoeDefinition> newDefinition = load_joe_definition(definition->machine, nullptr, directory, newArena, fromSnapshot);
+        if (!newDefinition || !validate_joe_definition(*newDefinition)) {
+            SPDLOG_WARN("Keeping the current definition of '{}', since the machine file '{}' is invalid.", definition->machine->name, fileName);
+            return false;
+        }
+        refreshed.push_back(std::move(newDefinition));
+    }
+
+    const std::scoped_lock lock(definitionsMutex);
+    // Definitions of this file still being loaded might come from the old file or snapshot:
+    generation++;
+    for (size_t i = 0; i < cached.size(); i++) {
+        auto iter = definitions.find(cached[i]->machine->articleNumber);
+        // Skip it in case it got replaced or dropped in the meantime:
+        if (iter != definitions.end() && iter->second == cached[i]) {
+            iter->second = std::move(refreshed[i]);
+        }
+    }
+    SPDLOG_INFO("Refreshed {} machine definitions from '{}'.", cached.size(), fileName);
+    return true;
+}
+
+/**
+ * Returns true in case the given option value lies within its range.
+ **/
+bool is_in_range(const std::optional<MinMaxOption>& option) {
+    return !option || (option->min <= option->max && option->value >= option->min && option->value <= option->max);
+}
+
+bool validate_joe_definition(const JoeDefinition& definition) {
+    if (definition.products.empty()) {
+        SPDLOG_WARN("Machine file '{}' does not contain any products.", definition.machine->fileName);
+        return false;
+    }
+    for (const Product& product : definition.products) {
+        if (definition.find_product_by_code(product.codeValue) != &product) {
+            SPDLOG_WARN("Machine file '{}' contains the product code '{}' more than once.", definition.machine->fileName, product.code);
+            return false;
+        }
+        if (!is_in_range(product.waterAmount) || !is_in_range(product.milkFoamAmount)) {
+            SPDLOG_WARN("Machine file '{}' contains an out of range option for '{}'.", definition.machine->fileName, product.name);
+            return false;
+        }
+    }
+    return true;
+}
+//---------------------------------------------------------------------------
+}  // namespace jutta_bt_proto
+//---------------------------------------------------------------------------
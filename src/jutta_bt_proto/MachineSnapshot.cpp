@@ -0,0 +1,495 @@
+#include "jutta_bt_proto/MachineSnapshot.hpp"
+#include "jutta_bt_proto/CoffeeMakerLoader.hpp"
+#include "logger/Logger.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <spdlog/spdlog.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//---------------------------------------------------------------------------
+namespace jutta_bt_proto {
+//---------------------------------------------------------------------------
+/**
+ * 64 bit FNV-1a hash.
+ **/
+uint64_t to_checksum(std::span<const uint8_t> data) {
+    uint64_t result = 0xCBF29CE484222325;
+    for (const uint8_t b : data) {
+        result ^= b;
+        result *= 0x100000001B3;
+    }
+    return result;
+}
+
+int64_t to_modified(const std::filesystem::file_time_type& time) {
+    return static_cast<int64_t>(time.time_since_epoch().count());
+}
+
+std::filesystem::path to_snapshot_path(const std::filesystem::path& machinesPath) {
+    return std::filesystem::path(machinesPath).replace_extension(".snapshot");
+}
+
+MachineSnapshot::MachineSnapshot(const uint8_t* data, size_t size) : data(data),
+                                                                     size(size),
+                                                                     // NOLINTNEXTLINE (cppcoreguidelines-pro-type-reinterpret-cast)
+                                                                     header(reinterpret_cast<const snapshot::Header*>(data)) {}
+
+MachineSnapshot::~MachineSnapshot() {
+    // NOLINTNEXTLINE (cppcoreguidelines-pro-type-const-cast)
+    munmap(const_cast<uint8_t*>(data), size);
+}
+
+std::shared_ptr<const MachineSnapshot> MachineSnapshot::open(const std::filesystem::path& path) {
+    // NOLINTNEXTLINE (cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        SPDLOG_INFO("No machine snapshot found at '{}'.", path.string());
+        return nullptr;
+    }
+
+    struct stat fileStat {};
+    if (fstat(fd, &fileStat) != 0 || static_cast<size_t>(fileStat.st_size) < sizeof(snapshot::Header)) {
+        SPDLOG_WARN("Machine snapshot '{}' is too small. Ignoring it.", path.string());
+        close(fd);
+        return nullptr;
+    }
+    const auto size = static_cast<size_t>(fileStat.st_size);
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid after closing the file:
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        SPDLOG_WARN("Failed to map machine snapshot '{}' into memory. Ignoring it.", path.string());
+        return nullptr;
+    }
+
+    // The constructor is private, so std::make_shared is not available:
+    std::shared_ptr<const MachineSnapshot> result(new MachineSnapshot(static_cast<const uint8_t*>(mapped), size));
+    if (!result->is_valid()) {
+        SPDLOG_WARN("Machine snapshot '{}' is invalid. Ignoring it.", path.string());
+        return nullptr;
+    }
+    if (result->is_stale(path.parent_path())) {
+        SPDLOG_WARN("Machine snapshot '{}' is older than the machine files. Ignoring it.", path.string());
+        return nullptr;
+    }
+    SPDLOG_INFO("Loaded machine snapshot '{}' with {} machines.", path.string(), result->get_machines().size());
+    return result;
+}
+
+template <typename T>
+std::span<const T> MachineSnapshot::get_table(const snapshot::Table& table) const {
+    // Bounds and alignment got checked by is_valid():
+    // NOLINTNEXTLINE (cppcoreguidelines-pro-type-reinterpret-cast, cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    return std::span<const T>(reinterpret_cast<const T*>(data + table.offset), table.count);
+}
+
+template <typename T>
+std::span<const T> MachineSnapshot::get_range(const snapshot::Table& table, const snapshot::Table& range) const {
+    if (range.offset > table.count || range.count > table.count - range.offset) {
+        return {};
+    }
+    return get_table<T>(table).subspan(range.offset, range.count);
+}
+
+template <typename T>
+bool is_table_valid(const snapshot::Table& table, size_t size) {
+    return table.offset % alignof(T) == 0 && table.offset <= size && table.count <= (size - table.offset) / sizeof(T);
+}
+
+bool MachineSnapshot::is_valid() const {
+    if (header->magic != snapshot::MAGIC) {
+        SPDLOG_WARN("Invalid machine snapshot magic.");
+        return false;
+    }
+    if (header->version != snapshot::VERSION) {
+        SPDLOG_WARN("Unsupported machine snapshot version {}. Expected {}.", header->version, snapshot::VERSION);
+        return false;
+    }
+    if (header->size != size) {
+        SPDLOG_WARN("Machine snapshot got truncated. Expected {} bytes, but found {}.", header->size, size);
+        return false;
+    }
+    if (header->checksum != to_checksum(std::span<const uint8_t>(data, size).subspan(sizeof(snapshot::Header)))) {
+        SPDLOG_WARN("Machine snapshot checksum mismatch.");
+        return false;
+    }
+    if (!is_table_valid<char>(header->strings, size) || !is_table_valid<snapshot::Source>(header->sources, size) || !is_table_valid<snapshot::Machine>(header->machines, size) || !is_table_valid<snapshot::Definition>(header->definitions, size) || !is_table_valid<snapshot::Product>(header->products, size) || !is_table_valid<snapshot::ItemsOption>(header->itemsOptions, size) || !is_table_valid<snapshot::Item>(header->items, size) || !is_table_valid<snapshot::MinMaxOption>(header->minMaxOptions, size) || !is_table_valid<snapshot::Alert>(header->alerts, size) || !is_table_valid<snapshot::StringRef>(header->names, size)) {
+        SPDLOG_WARN("Machine snapshot table out of bounds.");
+        return false;
+    }
+    return true;
+}
+
+bool MachineSnapshot::is_stale(const std::filesystem::path& directory) const {
+    for (const snapshot::Source& source : get_sources()) {
+        const std::filesystem::path path = directory / get_string(source.name);
+        std::error_code ec;
+        const std::filesystem::file_time_type modified = std::filesystem::last_write_time(path, ec);
+        if (ec) {
+            // Deployed without the machine files:
+            continue;
+        }
+        const uintmax_t fileSize = std::filesystem::file_size(path, ec);
+        if (ec || fileSize != source.size || to_modified(modified) != source.modified) {
+            SPDLOG_INFO("'{}' changed since the machine snapshot got created.", path.string());
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string_view MachineSnapshot::get_string(const snapshot::StringRef& ref) const {
+    const std::span<const char> strings = get_table<char>(header->strings);
+    if (ref.offset > strings.size() || ref.size > strings.size() - ref.offset) {
+        return {};
+    }
+    return std::string_view(strings.data() + ref.offset, ref.size);
+}
+
+std::span<const snapshot::Source> MachineSnapshot::get_sources() const {
+    return get_table<snapshot::Source>(header->sources);
+}
+
+std::span<const snapshot::Machine> MachineSnapshot::get_machines() const {
+    return get_table<snapshot::Machine>(header->machines);
+}
+
+const snapshot::Machine* MachineSnapshot::find_machine(size_t articleNumber) const {
+    const std::span<const snapshot::Machine> machines = get_machines();
+    auto iter = std::lower_bound(machines.begin(), machines.end(), articleNumber, [](const snapshot::Machine& machine, size_t articleNumber) { return machine.articleNumber < articleNumber; });
+    return iter != machines.end() && iter->articleNumber == articleNumber ? &*iter : nullptr;
+}
+
+const snapshot::Definition* MachineSnapshot::find_definition(const snapshot::Machine& machine) const {
+    const std::span<const snapshot::Definition> definitions = get_table<snapshot::Definition>(header->definitions);
+    return machine.definition < definitions.size() ? &definitions[machine.definition] : nullptr;
+}
+
+std::span<const snapshot::Product> MachineSnapshot::get_products(const snapshot::Definition& definition) const {
+    return get_range<snapshot::Product>(header->products, definition.products);
+}
+
+std::span<const snapshot::Alert> MachineSnapshot::get_alerts(const snapshot::Definition& definition) const {
+    return get_range<snapshot::Alert>(header->alerts, definition.alerts);
+}
+
+std::span<const snapshot::StringRef> MachineSnapshot::get_maintenance_counters(const snapshot::Definition& definition) const {
+    return get_range<snapshot::StringRef>(header->names, definition.maintenanceCounters);
+}
+
+std::span<const snapshot::StringRef> MachineSnapshot::get_maintenance_percentages(const snapshot::Definition& definition) const {
+    return get_range<snapshot::StringRef>(header->names, definition.maintenancePercentages);
+}
+
+const snapshot::ItemsOption* MachineSnapshot::get_items_option(uint32_t index) const {
+    const std::span<const snapshot::ItemsOption> options = get_table<snapshot::ItemsOption>(header->itemsOptions);
+    return index < options.size() ? &options[index] : nullptr;
+}
+
+const snapshot::MinMaxOption* MachineSnapshot::get_min_max_option(uint32_t index) const {
+    const std::span<const snapshot::MinMaxOption> options = get_table<snapshot::MinMaxOption>(header->minMaxOptions);
+    return index < options.size() ? &options[index] : nullptr;
+}
+
+std::span<const snapshot::Item> MachineSnapshot::get_items(const snapshot::ItemsOption& option) const {
+    return get_range<snapshot::Item>(header->items, option.items);
+}
+
+Machines MachineSnapshot::to_machines(Arena& arena) const {
+    Machines result;
+    for (const snapshot::Machine& machine : get_machines()) {
+        result.emplace(machine.articleNumber, Machine(machine.articleNumber, arena.intern(get_string(machine.name)), arena.intern(get_string(machine.fileName)), static_cast<uint8_t>(machine.version)));
+    }
+    return result;
+}
+
+std::shared_ptr<const JoeDefinition> MachineSnapshot::to_joe_definition(std::shared_ptr<const Machine> machine, std::shared_ptr<Arena> arena) const {
+    const snapshot::Machine* snapshotMachine = find_machine(machine->articleNumber);
+    if (!snapshotMachine || get_string(snapshotMachine->fileName) != machine->fileName) {
+        return nullptr;
+    }
+    const snapshot::Definition* definition = find_definition(*snapshotMachine);
+    if (!definition) {
+        return nullptr;
+    }
+    if (!arena) {
+        arena = std::make_shared<Arena>();
+    }
+
+    auto to_items_option = [this, &arena](uint32_t index) -> std::optional<ItemsOption> {
+        const snapshot::ItemsOption* option = get_items_option(index);
+        if (!option) {
+            return std::nullopt;
+        }
+        std::vector<Item> items;
+        for (const snapshot::Item& item : get_items(*option)) {
+            items.emplace_back(get_string(item.name), get_string(item.value));
+        }
+        return std::make_optional<ItemsOption>(get_string(option->argument), get_string(option->defaultValue), arena->store<Item>(items));
+    };
+    auto to_min_max_option = [this, &arena](uint32_t index) -> std::optional<MinMaxOption> {
+        const snapshot::MinMaxOption* option = get_min_max_option(index);
+        if (!option) {
+            return std::nullopt;
+        }
+        return std::make_optional<MinMaxOption>(get_string(option->argument), option->value, option->min, option->max, option->step);
+    };
+
+    std::vector<Product> products;
+    products.reserve(get_products(*definition).size());
+    for (const snapshot::Product& product : get_products(*definition)) {
+        products.emplace_back(get_string(product.name), get_string(product.code), to_items_option(product.strength), to_items_option(product.temperature), to_min_max_option(product.waterAmount), to_min_max_option(product.milkFoamAmount));
+    }
+
+    std::vector<Alert> alerts;
+    alerts.reserve(get_alerts(*definition).size());
+    for (const snapshot::Alert& alert : get_alerts(*definition)) {
+        alerts.emplace_back(alert.bit, get_string(alert.name), get_string(alert.type));
+    }
+
+    std::vector<MaintenanceCounter> maintenanceCounters;
+    for (const snapshot::StringRef& name : get_maintenance_counters(*definition)) {
+        maintenanceCounters.emplace_back(get_string(name), 0);
+    }
+
+    std::vector<MaintenancePercentage> maintenancePercentages;
+    for (const snapshot::StringRef& name : get_maintenance_percentages(*definition)) {
+        maintenancePercentages.emplace_back(get_string(name), 0);
+    }
+
+    // Keep the mapping alive, since all strings point into it:
+    return std::make_shared<const JoeDefinition>(std::move(arena), get_string(definition->dated), std::move(machine), std::move(products), std::move(alerts), std::move(maintenanceCounters), std::move(maintenancePercentages), shared_from_this());
+}
+
+/**
+ * Collects all records and strings of a snapshot before writing it out.
+ **/
+class SnapshotWriter {
+ private:
+    std::vector<char> strings;
+    std::unordered_map<std::string, snapshot::StringRef> stringRefs;
+    std::vector<snapshot::Source> sources;
+    std::vector<snapshot::Machine> machines;
+    std::vector<snapshot::Definition> definitions;
+    std::vector<snapshot::Product> products;
+    std::vector<snapshot::ItemsOption> itemsOptions;
+    std::vector<snapshot::Item> items;
+    std::vector<snapshot::MinMaxOption> minMaxOptions;
+    std::vector<snapshot::Alert> alerts;
+    std::vector<snapshot::StringRef> names;
+
+    template <typename T>
+    static snapshot::Table append_table(std::vector<uint8_t>& out, const std::vector<T>& table) {
+        // Keep every table 8 byte aligned:
+        out.resize((out.size() + 7) & ~size_t{7});
+        const snapshot::Table result{static_cast<uint32_t>(out.size()), static_cast<uint32_t>(table.size())};
+        const size_t bytes = table.size() * sizeof(T);
+        out.resize(out.size() + bytes);
+        if (bytes > 0) {
+            std::memcpy(&out[result.offset], table.data(), bytes);
+        }
+        return result;
+    }
+
+    static snapshot::Table to_range(size_t begin, size_t end) {
+        return snapshot::Table{static_cast<uint32_t>(begin), static_cast<uint32_t>(end - begin)};
+    }
+
+    uint32_t add_items_option(const std::optional<ItemsOption>& option) {
+        if (!option) {
+            return snapshot::NONE;
+        }
+        const size_t firstItem = items.size();
+        for (const Item& item : option->items) {
+            items.push_back(snapshot::Item{add_string(item.name), add_string(item.value)});
+        }
+        itemsOptions.push_back(snapshot::ItemsOption{add_string(option->argument), add_string(option->defaultValue), to_range(firstItem, items.size())});
+        return static_cast<uint32_t>(itemsOptions.size() - 1);
+    }
+
+    uint32_t add_min_max_option(const std::optional<MinMaxOption>& option) {
+        if (!option) {
+            return snapshot::NONE;
+        }
+        minMaxOptions.push_back(snapshot::MinMaxOption{add_string(option->argument), option->value, option->min, option->max, option->step});
+        return static_cast<uint32_t>(minMaxOptions.size() - 1);
+    }
+
+ public:
+    snapshot::StringRef add_string(std::string_view str) {
+        auto iter = stringRefs.find(std::string{str});
+        if (iter != stringRefs.end()) {
+            return iter->second;
+        }
+        const snapshot::StringRef result{static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(str.size())};
+        strings.insert(strings.end(), str.begin(), str.end());
+        stringRefs.emplace(std::string{str}, result);
+        return result;
+    }
+
+    bool add_source(const std::filesystem::path& path) {
+        std::error_code ec;
+        const std::filesystem::file_time_type modified = std::filesystem::last_write_time(path, ec);
+        if (ec) {
+            SPDLOG_ERROR("Failed to get the modification time of '{}': {}", path.string(), ec.message());
+            return false;
+        }
+        const uintmax_t size = std::filesystem::file_size(path, ec);
+        if (ec) {
+            SPDLOG_ERROR("Failed to get the size of '{}': {}", path.string(), ec.message());
+            return false;
+        }
+        sources.push_back(snapshot::Source{add_string(path.filename().string()), size, to_modified(modified)});
+        return true;
+    }
+
+    void add_machine(const Machine& machine, uint32_t definition) {
+        machines.push_back(snapshot::Machine{static_cast<uint32_t>(machine.articleNumber), machine.version, add_string(machine.name), add_string(machine.fileName), definition, 0});
+    }
+
+    uint32_t add_definition(const JoeDefinition& definition) {
+        const size_t firstProduct = products.size();
+        for (const Product& product : definition.products) {
+            const uint32_t strength = add_items_option(product.strength);
+            const uint32_t temperature = add_items_option(product.temperature);
+            const uint32_t waterAmount = add_min_max_option(product.waterAmount);
+            const uint32_t milkFoamAmount = add_min_max_option(product.milkFoamAmount);
+            products.push_back(snapshot::Product{add_string(product.name), add_string(product.code), strength, temperature, waterAmount, milkFoamAmount});
+        }
+
+        const size_t firstAlert = alerts.size();
+        // Definitions never contain larger bits (see Alert::MAX_BIT), so the cast below does not truncate:
+        static_assert(Alert::MAX_BIT <= UINT32_MAX);
+        for (const Alert& alert : definition.alerts) {
+            alerts.push_back(snapshot::Alert{static_cast<uint32_t>(alert.bit), add_string(alert.name), add_string(alert.type)});
+        }
+
+        const size_t firstCounter = names.size();
+        for (const MaintenanceCounter& counter : definition.maintenanceCounters) {
+            names.push_back(add_string(counter.name));
+        }
+        const size_t firstPercentage = names.size();
+        for (const MaintenancePercentage& percentage : definition.maintenancePercentages) {
+            names.push_back(add_string(percentage.name));
+        }
+
+        definitions.push_back(snapshot::Definition{add_string(definition.dated), to_range(firstProduct, products.size()), to_range(firstAlert, alerts.size()), to_range(firstCounter, firstPercentage), to_range(firstPercentage, names.size())});
+        return static_cast<uint32_t>(definitions.size() - 1);
+    }
+
+    [[nodiscard]] std::vector<uint8_t> to_bytes() {
+        // Allows binary searching for article numbers:
+        std::sort(machines.begin(), machines.end(), [](const snapshot::Machine& a, const snapshot::Machine& b) { return a.articleNumber < b.articleNumber; });
+
+        std::vector<uint8_t> out(sizeof(snapshot::Header));
+        snapshot::Header header{};
+        header.magic = snapshot::MAGIC;
+        header.version = snapshot::VERSION;
+        header.strings = append_table(out, strings);
+        header.sources = append_table(out, sources);
+        header.machines = append_table(out, machines);
+        header.definitions = append_table(out, definitions);
+        header.products = append_table(out, products);
+        header.itemsOptions = append_table(out, itemsOptions);
+        header.items = append_table(out, items);
+        header.minMaxOptions = append_table(out, minMaxOptions);
+        header.alerts = append_table(out, alerts);
+        header.names = append_table(out, names);
+        header.size = out.size();
+        header.checksum = to_checksum(std::span<const uint8_t>(out).subspan(sizeof(snapshot::Header)));
+        std::memcpy(out.data(), &header, sizeof(header));
+        return out;
+    }
+};
+
+bool write_snapshot(const std::filesystem::path& path, const Machines& machines, std::span<const std::shared_ptr<const JoeDefinition>> definitions, std::span<const std::filesystem::path> sources) {
+    SnapshotWriter writer;
+    for (const std::filesystem::path& source : sources) {
+        if (!writer.add_source(source)) {
+            return false;
+        }
+    }
+
+    std::unordered_map<std::string_view, uint32_t> definitionsByFileName;
+    for (const std::shared_ptr<const JoeDefinition>& definition : definitions) {
+        if (!definition || !definition->machine) {
+            SPDLOG_WARN("Skipping definition without machine.");
+            continue;
+        }
+        if (!definitionsByFileName.contains(definition->machine->fileName)) {
+            definitionsByFileName.emplace(definition->machine->fileName, writer.add_definition(*definition));
+        }
+    }
+    for (const auto& [articleNumber, machine] : machines) {
+        auto iter = definitionsByFileName.find(machine.fileName);
+        writer.add_machine(machine, iter == definitionsByFileName.end() ? snapshot::NONE : iter->second);
+    }
+    const std::vector<uint8_t> bytes = writer.to_bytes();
+
+    std::filesystem::path tmpPath = path;
+    tmpPath += ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        // NOLINTNEXTLINE (cppcoreguidelines-pro-type-reinterpret-cast)
+        out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        if (!out) {
+            SPDLOG_ERROR("Failed to write machine snapshot '{}'.", tmpPath.string());
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec) {
+        SPDLOG_ERROR("Failed to move machine snapshot to '{}': {}", path.string(), ec.message());
+        return false;
+    }
+    SPDLOG_INFO("Wrote machine snapshot '{}' with {} machines ({} bytes).", path.string(), machines.size(), bytes.size());
+    return true;
+}
+
+bool compile_snapshot(const std::filesystem::path& machinesPath, const std::filesystem::path& path) {
+    if (!std::filesystem::exists(machinesPath)) {
+        SPDLOG_ERROR("Machine file '{}' not found.", machinesPath.string());
+        return false;
+    }
+    const std::filesystem::path directory = machinesPath.parent_path();
+    const std::shared_ptr<Arena> arena = std::make_shared<Arena>();
+    const Machines machines = load_machines(machinesPath, *arena);
+
+    std::vector<std::shared_ptr<const JoeDefinition>> definitions;
+    std::vector<std::filesystem::path> sources{machinesPath};
+    std::unordered_set<std::string_view> fileNames;
+    for (const auto& [articleNumber, machine] : machines) {
+        if (!fileNames.insert(machine.fileName).second) {
+            continue;
+        }
+        const std::filesystem::path xmlPath = directory / (std::string{machine.fileName} + ".xml");
+        if (!std::filesystem::exists(xmlPath)) {
+            SPDLOG_WARN("Machine file '{}' for '{}' not found. Skipping it.", xmlPath.string(), machine.name);
+            continue;
+        }
+        definitions.push_back(load_joe(std::make_shared<const Machine>(machine), directory, arena));
+        sources.push_back(xmlPath);
+    }
+    return write_snapshot(path, machines, definitions, sources);
+}
+//---------------------------------------------------------------------------
+}  // namespace jutta_bt_proto
+//---------------------------------------------------------------------------
@@ -0,0 +1,183 @@
+#include "jutta_bt_proto/MachineWatcher.hpp"
+#include "jutta_bt_proto/MachineSnapshot.hpp"
+#include "logger/Logger.hpp"
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <poll.h>
+#include <spdlog/spdlog.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+//---------------------------------------------------------------------------
+namespace jutta_bt_proto {
+//---------------------------------------------------------------------------
+/**
+ * Events of the machine files directory, which might change a machine file.
+ **/
+constexpr uint32_t DIRECTORY_EVENTS = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_ONLYDIR;
+/**
+ * Events of its parent directory, which might replace the whole machine files directory (e.g. extract_apk.sh).
+ **/
+constexpr uint32_t PARENT_EVENTS = IN_CREATE | IN_MOVED_TO | IN_ONLYDIR;
+
+MachineWatcher::MachineWatcher(MachineRegistry& registry, std::chrono::milliseconds settleTime) : registry(&registry),
+                                                                                                 settleTime(settleTime) {}
+
+MachineWatcher::~MachineWatcher() { stop(); }
+
+bool MachineWatcher::start() {
+    if (watcherThread) {
+        return false;
+    }
+    if (registry->is_embedded()) {
+        SPDLOG_WARN("Not watching the machine files, since the machines are embedded.");
+        return false;
+    }
+
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (inotifyFd < 0 || stopFd < 0) {
+        SPDLOG_ERROR("Failed to set up watching the machine files: {}", std::strerror(errno));
+        stop();
+        return false;
+    }
+
+    std::filesystem::path machinesPath = std::filesystem::absolute(registry->get_path());
+    std::filesystem::path directory = machinesPath.parent_path();
+    const int parentWatch = inotify_add_watch(inotifyFd, directory.parent_path().c_str(), PARENT_EVENTS);
+    if (parentWatch < 0) {
+        SPDLOG_ERROR("Failed to watch '{}': {}", directory.parent_path().string(), std::strerror(errno));
+        stop();
+        return false;
+    }
+    // Might not exist yet, in this case it gets watched once it got created:
+    if (inotify_add_watch(inotifyFd, directory.c_str(), DIRECTORY_EVENTS) < 0) {
+        SPDLOG_WARN("Failed to watch '{}': {}", directory.string(), std::strerror(errno));
+    }
+
+    SPDLOG_INFO("Watching the machine files in '{}' for changes.", directory.string());
+    watcherThread = std::make_optional<std::thread>(&MachineWatcher::watcher_run, this, parentWatch, std::move(directory), std::move(machinesPath));
+    return true;
+}
+
+void MachineWatcher::stop() {
+    if (watcherThread) {
+        const uint64_t value = 1;
+        if (write(stopFd, &value, sizeof(value)) != sizeof(value)) {
+            SPDLOG_ERROR("Failed to stop the machine file watcher: {}", std::strerror(errno));
+        }
+        watcherThread->join();
+        watcherThread = std::nullopt;
+        SPDLOG_INFO("Stopped watching the machine files.");
+    }
+    if (inotifyFd >= 0) {
+        close(inotifyFd);
+        inotifyFd = -1;
+    }
+    if (stopFd >= 0) {
+        close(stopFd);
+        stopFd = -1;
+    }
+}
+
+bool MachineWatcher::is_running() const { return watcherThread.has_value(); }
+
+size_t MachineWatcher::get_refresh_count() const { return refreshCount; }
+
+size_t MachineWatcher::get_failed_refresh_count() const { return failedRefreshCount; }
+
+void MachineWatcher::watcher_run(int parentWatch, std::filesystem::path directory, std::filesystem::path machinesPath) {
+    SPDLOG_INFO("Machine file watcher thread started.");
+    const std::string directoryName = directory.filename().string();
+    std::unordered_set<std::string> changed;
+    alignas(inotify_event) std::array<char, 4096> buffer{};
+    std::array<pollfd, 2> fds{pollfd{inotifyFd, POLLIN, 0}, pollfd{stopFd, POLLIN, 0}};
+    // NOLINTNEXTLINE (altera-id-dependent-backward-branch)
+    while (true) {
+        // Wait until nothing changed for settleTime before refreshing, since the files usually get replaced one after another:
+        const int timeout = changed.empty() ? -1 : static_cast<int>(settleTime.count());
+        const int ready = poll(fds.data(), fds.size(), timeout);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            SPDLOG_ERROR("Polling for machine file changes failed: {}", std::strerror(errno));
+            break;
+        }
+        if (fds[1].revents & POLLIN) {
+            break;
+        }
+        if (ready == 0) {
+            refresh(changed, machinesPath);
+            changed.clear();
+            continue;
+        }
+
+        const ssize_t size = read(inotifyFd, buffer.data(), buffer.size());
+        if (size <= 0) {
+            continue;
+        }
+        for (ssize_t offset = 0; offset < size;) {
+            // NOLINTNEXTLINE (cppcoreguidelines-pro-type-reinterpret-cast, cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            const auto* event = reinterpret_cast<const inotify_event*>(buffer.data() + offset);
+            offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+            if (event->mask & IN_Q_OVERFLOW) {
+                changed.insert("");
+                continue;
+            }
+            if (event->len == 0) {
+                continue;
+            }
+            // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-array-to-pointer-decay, hicpp-no-array-decay)
+            const std::string name(event->name);
+            if (event->wd == parentWatch) {
+                if ((event->mask & IN_ISDIR) && name == directoryName) {
+                    // The directory got replaced. Watch the new one and refresh everything:
+                    if (inotify_add_watch(inotifyFd, directory.c_str(), DIRECTORY_EVENTS) < 0) {
+                        SPDLOG_WARN("Failed to watch '{}': {}", directory.string(), std::strerror(errno));
+                    }
+                    changed.insert("");
+                }
+            } else if (!(event->mask & IN_ISDIR)) {
+                changed.insert(name);
+            }
+        }
+    }
+    SPDLOG_INFO("Machine file watcher thread ready to be joined.");
+}
+
+void MachineWatcher::refresh(const std::unordered_set<std::string>& changed, const std::filesystem::path& machinesPath) {
+    auto count = [this](bool success) {
+        if (success) {
+            refreshCount++;
+        } else {
+            failedRefreshCount++;
+        }
+    };
+
+    if (changed.contains("") || changed.contains(machinesPath.filename().string()) || changed.contains(to_snapshot_path(machinesPath).filename().string())) {
+        SPDLOG_INFO("Machine files changed. Refreshing all machines...");
+        count(registry->refresh_machines());
+        return;
+    }
+    for (const std::string& name : changed) {
+        const std::filesystem::path file(name);
+        if (file.extension() == ".xml") {
+            SPDLOG_INFO("Machine file '{}' changed. Refreshing its definitions...", name);
+            count(registry->refresh_joe_definitions(file.stem().string()));
+        }
+    }
+}
+//---------------------------------------------------------------------------
+}  // namespace jutta_bt_proto
+//---------------------------------------------------------------------------
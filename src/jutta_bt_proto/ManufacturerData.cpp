@@ -0,0 +1,37 @@
+#include "jutta_bt_proto/ManufacturerData.hpp"
+#include "date/date.hpp"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+//---------------------------------------------------------------------------
+namespace jutta_bt_proto {
+//---------------------------------------------------------------------------
+ManufacturerData to_man_data(std::span<const uint8_t> data) {
+    assert(data.size() >= 16);
+    ManufacturerData result;
+    result.key = data[0];
+    result.bfMajVer = data[1];
+    result.bfMinVer = data[2];
+    result.articleNumber = to_uint16_t_little_endian(data, 4);
+    result.machineNumber = to_uint16_t_little_endian(data, 6);
+    result.serialNumber = to_uint16_t_little_endian(data, 8);
+    result.machineProdDate = to_ymd(data, 10);
+    result.machineProdDateUCHI = to_ymd(data, 12);
+    result.unusedSecond = data[14];
+    result.statusBits = data[15];
+    return result;
+}
+
+uint16_t to_uint16_t_little_endian(std::span<const uint8_t> data, size_t offset) {
+    return (static_cast<uint16_t>(data[offset + 1]) << 8) | static_cast<uint16_t>(data[offset]);
+}
+
+date::year_month_day to_ymd(std::span<const uint8_t> data, size_t offset) {
+    uint16_t date = to_uint16_t_little_endian(data, offset);
+    return date::year(((date & 65024) >> 9) + 1990) / ((date & 480) >> 5) / (date & 31);
+}
+//---------------------------------------------------------------------------
+}  // namespace jutta_bt_proto
+//---------------------------------------------------------------------------
@@ -0,0 +1,79 @@
+#include "jutta_bt_proto/ProductCommandCache.hpp"
+#include "bt/ByteEncDecoder.hpp"
+#include "jutta_bt_proto/CoffeeMakerLoader.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+//---------------------------------------------------------------------------
+namespace jutta_bt_proto {
+//---------------------------------------------------------------------------
+ProductCommandCache::ProductCommandCache(size_t variantCapacity) : defaults(256), variants(std::max<size_t>(variantCapacity, 1)) {}
+
+void ProductCommandCache::rebuild(const std::vector<Product>& products, uint8_t key) {
+    clear();
+    if (codec.get_key() != key) {
+        codec = bt::CodecContext(key);
+    }
+    this->key = key;
+    for (const Product& product : products) {
+        encode(defaults[product.command[1]], product.command);
+    }
+}
+
+void ProductCommandCache::clear() {
+    for (Entry& entry : defaults) {
+        entry.valid = false;
+    }
+    for (Entry& entry : variants) {
+        entry.valid = false;
+    }
+    useCounter = 0;
+}
+
+std::span<const uint8_t> ProductCommandCache::get(const ProductCommand& command) {
+    // Default command of the product:
+    Entry& defaultEntry = defaults[command[1]];
+    if (defaultEntry.valid && defaultEntry.command == command) {
+        hits++;
+        return defaultEntry.encoded;
+    }
+
+    // Cached variant or the least recently used entry to replace:
+    Entry* lru = &variants[0];
+    for (Entry& entry : variants) {
+        if (entry.valid && entry.command == command) {
+            entry.lastUse = ++useCounter;
+            hits++;
+            return entry.encoded;
+        }
+        if (!entry.valid || (lru->valid && entry.lastUse < lru->lastUse)) {
+            lru = &entry;
+        }
+    }
+
+    misses++;
+    encode(*lru, command);
+    lru->lastUse = ++useCounter;
+    return lru->encoded;
+}
+
+void ProductCommandCache::encode(Entry& entry, const ProductCommand& command) const {
+    entry.command = command;
+    entry.encoded = command;
+    entry.encoded[0] = key;
+    entry.encoded[entry.encoded.size() - 1] = key;
+    codec.enc_dec(entry.encoded);
+    entry.valid = true;
+}
+
+uint8_t ProductCommandCache::get_key() const { return key; }
+
+size_t ProductCommandCache::get_hits() const { return hits; }
+
+size_t ProductCommandCache::get_misses() const { return misses; }
+//---------------------------------------------------------------------------
+}  // namespace jutta_bt_proto
+//---------------------------------------------------------------------------
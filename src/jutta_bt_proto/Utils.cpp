@@ -1,47 +1,275 @@
 #include "jutta_bt_proto/Utils.hpp"
+#include "bt/CodecKernels.hpp"
+#include "logger/Logger.hpp"
 #include <array>
 #include <cassert>
-#include <cctype>
 #include <cstddef>
 #include <cstdint>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
+#include <spdlog/spdlog.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define JUTTA_BT_PROTO_KERNELS_X86
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(JUTTA_BT_PROTO_NEON_KERNELS)
+// Opt-in like the NEON codec kernels (see bt::CodecKernel::NEON):
+#define JUTTA_BT_PROTO_KERNELS_NEON
+#include <arm_neon.h>
+#endif
 
 //---------------------------------------------------------------------------
 namespace jutta_bt_proto {
 //---------------------------------------------------------------------------
-std::string to_hex_string(const std::vector<uint8_t>& data) {
-    static const std::array<char, 16> HEX_CHARS{'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'};
+constexpr std::array<char, 16> HEX_CHARS{'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'};
+constexpr uint8_t INVALID_HEX_CHAR = 0xFF;
 
-    std::string result;
-    result.resize(data.size() * 2);
-    for (size_t i = 0; i < data.size(); i++) {
-        result[i * 2] = HEX_CHARS[data[i] >> 4];
-        result[(i * 2) + 1] = HEX_CHARS[data[i] & 0x0F];
+/**
+ * Value of each character as hex digit or INVALID_HEX_CHAR.
+ **/
+constexpr std::array<uint8_t, 256> HEX_CHAR_VALUES = [] {
+    std::array<uint8_t, 256> result{};
+    result.fill(INVALID_HEX_CHAR);
+    for (uint8_t i = 0; i < 10; i++) {
+        result['0' + i] = i;
+    }
+    for (uint8_t i = 0; i < 6; i++) {
+        result['A' + i] = 10 + i;
+        result['a' + i] = 10 + i;
     }
-
     return result;
+}();
+
+std::string_view to_string(HexError error) {
+    switch (error) {
+        case HexError::BUFFER_TOO_SMALL:
+            return "buffer too small";
+
+        case HexError::ODD_LENGTH:
+            return "odd length";
+
+        case HexError::INVALID_CHARACTER:
+            return "invalid character";
+    }
+    return "unknown";
+}
+
+HexResult HexResult::success(size_t count) { return HexResult(count, std::nullopt); }
+
+HexResult HexResult::failure(HexError error, size_t position) { return HexResult(position, error); }
+
+bool HexResult::has_value() const { return !err; }
+
+HexResult::operator bool() const { return has_value(); }
+
+size_t HexResult::value() const {
+    assert(has_value());
+    return val;
+}
+
+HexError HexResult::error() const {
+    assert(!has_value());
+    return *err;
+}
+
+size_t HexResult::position() const {
+    assert(!has_value());
+    return val;
+}
+
+#ifdef JUTTA_BT_PROTO_KERNELS_X86
+/**
+ * Converts 16 bytes per iteration to 32 characters. Returns the number of bytes processed.
+ **/
+__attribute__((target("ssse3"))) size_t to_hex_ssse3(const uint8_t* data, char* out, size_t size) {
+    const __m128i mask = _mm_set1_epi8(0x0F);
+    const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(HEX_CHARS.data()));
+
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        const __m128i high = _mm_shuffle_epi8(chars, _mm_and_si128(_mm_srli_epi16(d, 4), mask));
+        const __m128i low = _mm_shuffle_epi8(chars, _mm_and_si128(d, mask));
+        // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + (i * 2)), _mm_unpacklo_epi8(high, low));
+        // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + (i * 2) + 16), _mm_unpackhi_epi8(high, low));
+    }
+    return i;
 }
 
-uint8_t get_hex_char_val(char c) {
-    uint8_t i = static_cast<uint8_t>(std::toupper(c));
-    if (i >= 0x30 && i <= 0x39) {
-        return i -= 0x30;
+/**
+ * Converts 16 characters to their values as hex digit.
+ * valid gets cleared in case one of them is no hex digit.
+ **/
+__attribute__((target("ssse3"))) inline __m128i hex_values_ssse3(__m128i c, bool& valid) {
+    const __m128i digit = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+    const __m128i letter = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    // Unsigned comparison digit <= 9 and letter <= 5:
+    const __m128i isDigit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+    const __m128i isLetter = _mm_cmpeq_epi8(_mm_min_epu8(letter, _mm_set1_epi8(5)), letter);
+    if (_mm_movemask_epi8(_mm_or_si128(isDigit, isLetter)) != 0xFFFF) {
+        valid = false;
     }
-    if (i >= 0x41 && i <= 0x46) {
-        return i = i - 0x41 + 10;
+    return _mm_or_si128(_mm_and_si128(isDigit, digit), _mm_and_si128(isLetter, _mm_add_epi8(letter, _mm_set1_epi8(10))));
+}
+
+/**
+ * Converts 32 characters per iteration to 16 bytes. Returns the number of characters processed.
+ * Stops at the first block containing an invalid character, so the scalar path can report its position.
+ **/
+__attribute__((target("ssse3"))) size_t from_hex_ssse3(const char* hex, uint8_t* out, size_t size) {
+    // Multiplies the high nibble (even character) by 16 and adds the low nibble (odd character):
+    const __m128i weights = _mm_set1_epi16(0x0110);
+
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        bool valid = true;
+        // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        const __m128i first = hex_values_ssse3(_mm_loadu_si128(reinterpret_cast<const __m128i*>(hex + i)), valid);
+        // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        const __m128i second = hex_values_ssse3(_mm_loadu_si128(reinterpret_cast<const __m128i*>(hex + i + 16)), valid);
+        if (!valid) {
+            break;
+        }
+        const __m128i bytes = _mm_packus_epi16(_mm_maddubs_epi16(first, weights), _mm_maddubs_epi16(second, weights));
+        // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + (i / 2)), bytes);
     }
-    assert(false);
+    return i;
 }
+#endif  // JUTTA_BT_PROTO_KERNELS_X86
+
+#ifdef JUTTA_BT_PROTO_KERNELS_NEON
+/**
+ * Converts 16 bytes per iteration to 32 characters. Returns the number of bytes processed.
+ **/
+size_t to_hex_neon(const uint8_t* data, char* out, size_t size) {
+    const uint8x16_t chars = vld1q_u8(reinterpret_cast<const uint8_t*>(HEX_CHARS.data()));
 
-std::vector<uint8_t> from_hex_string(const std::string& hex) {
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        const uint8x16_t d = vld1q_u8(data + i);
+        const uint8x16x2_t result{vqtbl1q_u8(chars, vshrq_n_u8(d, 4)), vqtbl1q_u8(chars, vandq_u8(d, vdupq_n_u8(0x0F)))};
+        // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        vst2q_u8(reinterpret_cast<uint8_t*>(out + (i * 2)), result);
+    }
+    return i;
+}
+
+/**
+ * Converts 16 characters to their values as hex digit.
+ * valid gets cleared in case one of them is no hex digit.
+ **/
+inline uint8x16_t hex_values_neon(uint8x16_t c, bool& valid) {
+    const uint8x16_t digit = vsubq_u8(c, vdupq_n_u8('0'));
+    const uint8x16_t letter = vsubq_u8(vorrq_u8(c, vdupq_n_u8(0x20)), vdupq_n_u8('a'));
+    const uint8x16_t isDigit = vcleq_u8(digit, vdupq_n_u8(9));
+    const uint8x16_t isLetter = vcleq_u8(letter, vdupq_n_u8(5));
+    if (vminvq_u8(vorrq_u8(isDigit, isLetter)) != 0xFF) {
+        valid = false;
+    }
+    return vorrq_u8(vandq_u8(isDigit, digit), vandq_u8(isLetter, vaddq_u8(letter, vdupq_n_u8(10))));
+}
+
+/**
+ * Converts 32 characters per iteration to 16 bytes. Returns the number of characters processed.
+ * Stops at the first block containing an invalid character, so the scalar path can report its position.
+ **/
+size_t from_hex_neon(const char* hex, uint8_t* out, size_t size) {
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        // De-interleaves the characters for the high and low nibbles:
+        // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        const uint8x16x2_t c = vld2q_u8(reinterpret_cast<const uint8_t*>(hex + i));
+        bool valid = true;
+        const uint8x16_t high = hex_values_neon(c.val[0], valid);
+        const uint8x16_t low = hex_values_neon(c.val[1], valid);
+        if (!valid) {
+            break;
+        }
+        // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        vst1q_u8(out + (i / 2), vorrq_u8(vshlq_n_u8(high, 4), low));
+    }
+    return i;
+}
+#endif  // JUTTA_BT_PROTO_KERNELS_NEON
+
+HexResult to_hex(std::span<const uint8_t> data, std::span<char> out) {
+    if (out.size() < data.size() * 2) {
+        return HexResult::failure(HexError::BUFFER_TOO_SMALL, 0);
+    }
+
+    size_t i = 0;
+#ifdef JUTTA_BT_PROTO_KERNELS_X86
+    if (bt::is_codec_kernel_supported(bt::CodecKernel::SSSE3)) {
+        i = to_hex_ssse3(data.data(), out.data(), data.size());
+    }
+#endif  // JUTTA_BT_PROTO_KERNELS_X86
+#ifdef JUTTA_BT_PROTO_KERNELS_NEON
+    i = to_hex_neon(data.data(), out.data(), data.size());
+#endif  // JUTTA_BT_PROTO_KERNELS_NEON
+    for (; i < data.size(); i++) {
+        out[i * 2] = HEX_CHARS[data[i] >> 4];
+        out[(i * 2) + 1] = HEX_CHARS[data[i] & 0x0F];
+    }
+    return HexResult::success(data.size() * 2);
+}
+
+HexResult from_hex(std::string_view hex, std::span<uint8_t> out) {
+    if (hex.size() % 2 != 0) {
+        return HexResult::failure(HexError::ODD_LENGTH, hex.size() - 1);
+    }
+    if (out.size() < hex.size() / 2) {
+        return HexResult::failure(HexError::BUFFER_TOO_SMALL, 0);
+    }
+
+    size_t i = 0;
+#ifdef JUTTA_BT_PROTO_KERNELS_X86
+    if (bt::is_codec_kernel_supported(bt::CodecKernel::SSSE3)) {
+        i = from_hex_ssse3(hex.data(), out.data(), hex.size());
+    }
+#endif  // JUTTA_BT_PROTO_KERNELS_X86
+#ifdef JUTTA_BT_PROTO_KERNELS_NEON
+    i = from_hex_neon(hex.data(), out.data(), hex.size());
+#endif  // JUTTA_BT_PROTO_KERNELS_NEON
+    for (; i < hex.size(); i += 2) {
+        const uint8_t high = HEX_CHAR_VALUES[static_cast<uint8_t>(hex[i])];
+        if (high == INVALID_HEX_CHAR) {
+            return HexResult::failure(HexError::INVALID_CHARACTER, i);
+        }
+        const uint8_t low = HEX_CHAR_VALUES[static_cast<uint8_t>(hex[i + 1])];
+        if (low == INVALID_HEX_CHAR) {
+            return HexResult::failure(HexError::INVALID_CHARACTER, i + 1);
+        }
+        out[i / 2] = static_cast<uint8_t>((high << 4) | low);
+    }
+    return HexResult::success(hex.size() / 2);
+}
+
+std::string to_hex_string(std::span<const uint8_t> data) {
+    std::string result;
+    result.resize(data.size() * 2);
+    [[maybe_unused]] const HexResult hexResult = to_hex(data, result);
+    assert(hexResult);
+    return result;
+}
+
+std::vector<uint8_t> from_hex_string(std::string_view hex) {
     std::vector<uint8_t> result;
     result.resize(hex.size() / 2);
-    for (size_t i = 0; i < hex.size(); i += 2) {
-        result[i / 2] = (get_hex_char_val(hex[i]) << 4) | get_hex_char_val(hex[i + 1]);
+    const HexResult hexResult = from_hex(hex, result);
+    if (!hexResult) {
+        SPDLOG_ERROR("Invalid hex string '{}': {} at position {}.", hex, to_string(hexResult.error()), hexResult.position());
+        return {};
     }
     return result;
 }
 //---------------------------------------------------------------------------
 }  // namespace jutta_bt_proto
-//---------------------------------------------------------------------------
\ No newline at end of file
+//---------------------------------------------------------------------------
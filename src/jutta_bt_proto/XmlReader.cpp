@@ -0,0 +1,373 @@
+#include "jutta_bt_proto/XmlReader.hpp"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+
+//---------------------------------------------------------------------------
+namespace jutta_bt_proto {
+//---------------------------------------------------------------------------
+XmlAttributes::XmlAttributes(std::span<const XmlAttribute> attributes) : attributes(attributes) {}
+
+std::optional<std::string_view> XmlAttributes::get(std::string_view name) const {
+    for (const XmlAttribute& attribute : attributes) {
+        if (attribute.name == name) {
+            return attribute.value;
+        }
+    }
+    return std::nullopt;
+}
+
+size_t XmlAttributes::size() const { return attributes.size(); }
+
+XmlReader::XmlReader(std::istream& in) : in(in) {}
+
+bool is_whitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+bool is_name_char(char c) {
+    return !is_whitespace(c) && c != '/' && c != '>' && c != '<' && c != '=' && c != '"' && c != '\'';
+}
+
+/**
+ * Appends the given unicode code point UTF-8 encoded.
+ **/
+void append_utf8(std::string& result, uint32_t cp) {
+    if (cp < 0x80) {
+        result += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        result += static_cast<char>(0xC0 | (cp >> 6));
+        result += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        result += static_cast<char>(0xE0 | (cp >> 12));
+        result += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        result += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        result += static_cast<char>(0xF0 | (cp >> 18));
+        result += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        result += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        result += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+std::optional<char> XmlReader::peek() {
+    if (bufferPos >= bufferSize) {
+        in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        bufferSize = static_cast<size_t>(in.gcount());
+        bufferPos = 0;
+        if (bufferSize == 0) {
+            return std::nullopt;
+        }
+    }
+    return buffer[bufferPos];
+}
+
+std::optional<char> XmlReader::next() {
+    const std::optional<char> c = peek();
+    if (!c) {
+        return std::nullopt;
+    }
+    bufferPos++;
+    if (*c == '\n') {
+        line++;
+        column = 0;
+    } else {
+        column++;
+    }
+    return c;
+}
+
+void XmlReader::fail(std::string message) {
+    if (!error) {
+        error = XmlError{line, std::max<size_t>(column, 1), std::move(message)};
+    }
+}
+
+const std::optional<XmlError>& XmlReader::get_error() const { return error; }
+
+std::span<const std::string> XmlReader::get_open_elements() const { return openElements; }
+
+bool XmlReader::skip_whitespace() {
+    for (std::optional<char> c = peek(); c && is_whitespace(*c); c = peek()) {
+        next();
+    }
+    return true;
+}
+
+bool XmlReader::skip_until(std::string_view terminator) {
+    // Terminators are at most 3 characters long, so keeping the last 3 characters is enough:
+    std::array<char, 3> last{};
+    size_t count = 0;
+    while (count < terminator.size() || !std::equal(terminator.begin(), terminator.end(), last.end() - static_cast<std::ptrdiff_t>(terminator.size()))) {
+        const std::optional<char> c = next();
+        if (!c) {
+            fail("Unexpected end of file while looking for '" + std::string{terminator} + "'.");
+            return false;
+        }
+        std::shift_left(last.begin(), last.end(), 1);
+        last.back() = *c;
+        count++;
+    }
+    return true;
+}
+
+bool XmlReader::read_name(std::string& result, std::optional<char> first) {
+    result.clear();
+    if (first) {
+        result += *first;
+    }
+    for (std::optional<char> c = peek(); c && is_name_char(*c); c = peek()) {
+        result += *next();
+    }
+    if (result.empty()) {
+        fail("Expected a name.");
+        return false;
+    }
+    return true;
+}
+
+bool XmlReader::read_entity(std::string& result) {
+    entity.clear();
+    for (std::optional<char> c = next(); c != ';'; c = next()) {
+        if (!c || entity.size() > 8) {
+            fail("Invalid entity '&" + entity + "'.");
+            return false;
+        }
+        entity += *c;
+    }
+
+    if (entity == "amp") {
+        result += '&';
+    } else if (entity == "lt") {
+        result += '<';
+    } else if (entity == "gt") {
+        result += '>';
+    } else if (entity == "quot") {
+        result += '"';
+    } else if (entity == "apos") {
+        result += '\'';
+    } else if (entity.size() > 1 && entity[0] == '#') {
+        const bool hex = entity[1] == 'x' || entity[1] == 'X';
+        const std::string_view digits = std::string_view(entity).substr(hex ? 2 : 1);
+        uint32_t cp = 0;
+        const std::from_chars_result parsed = std::from_chars(digits.data(), digits.data() + digits.size(), cp, hex ? 16 : 10);
+        if (digits.empty() || parsed.ptr != digits.data() + digits.size() || cp > 0x10FFFF) {
+            fail("Invalid character reference '&" + entity + ";'.");
+            return false;
+        }
+        append_utf8(result, cp);
+    } else {
+        fail("Unknown entity '&" + entity + ";'.");
+        return false;
+    }
+    return true;
+}
+
+bool XmlReader::read_attribute_value(std::string& result, char quote) {
+    result.clear();
+    for (std::optional<char> c = next(); c != quote; c = next()) {
+        if (!c) {
+            fail("Unexpected end of file inside attribute value.");
+            return false;
+        }
+        if (*c == '<') {
+            fail("Unexpected '<' inside attribute value.");
+            return false;
+        }
+        if (*c == '&') {
+            if (!read_entity(result)) {
+                return false;
+            }
+        } else {
+            result += *c;
+        }
+    }
+    return true;
+}
+
+bool XmlReader::read_special() {
+    // We already consumed "<!":
+    const std::optional<char> c = next();
+    if (c == '-') {
+        if (next() != '-') {
+            fail("Invalid comment.");
+            return false;
+        }
+        return skip_until("-->");
+    }
+    if (c == '[') {
+        return skip_until("]]>");
+    }
+    // DOCTYPE, optionally with an internal subset in brackets:
+    size_t depth = 0;
+    for (std::optional<char> d = next(); d; d = next()) {
+        if (*d == '[') {
+            depth++;
+        } else if (*d == ']' && depth > 0) {
+            depth--;
+        } else if (*d == '>' && depth == 0) {
+            return true;
+        }
+    }
+    fail("Unexpected end of file inside declaration.");
+    return false;
+}
+
+bool XmlReader::read_end_tag(const EndElementHandler& onEnd) {
+    if (!read_name(name, std::nullopt)) {
+        return false;
+    }
+    skip_whitespace();
+    if (next() != '>') {
+        fail("Expected '>' after end tag '" + name + "'.");
+        return false;
+    }
+    if (openElements.empty() || openElements.back() != name) {
+        fail("Unexpected end tag '" + name + "'" + (openElements.empty() ? std::string{} : ", expected '" + openElements.back() + "'") + ".");
+        return false;
+    }
+    onEnd(name);
+    openElements.pop_back();
+    return !error;
+}
+
+bool XmlReader::read_tag(const StartElementHandler& onStart, const EndElementHandler& onEnd) {
+    // We already consumed '<':
+    const std::optional<char> c = next();
+    if (!c) {
+        fail("Unexpected end of file after '<'.");
+        return false;
+    }
+    if (*c == '?') {
+        return skip_until("?>");
+    }
+    if (*c == '!') {
+        return read_special();
+    }
+    if (*c == '/') {
+        return read_end_tag(onEnd);
+    }
+    if (!is_name_char(*c)) {
+        fail(std::string{"Unexpected character '"} + *c + "' after '<'.");
+        return false;
+    }
+    std::string elementName;
+    if (!read_name(elementName, c)) {
+        return false;
+    }
+
+    // Attributes get reused across elements to avoid allocations:
+    attributeCount = 0;
+    bool empty = false;
+    while (true) {
+        skip_whitespace();
+        const std::optional<char> d = next();
+        if (!d) {
+            fail("Unexpected end of file inside tag '" + elementName + "'.");
+            return false;
+        }
+        if (*d == '>') {
+            break;
+        }
+        if (*d == '/') {
+            if (next() != '>') {
+                fail("Expected '>' after '/' in tag '" + elementName + "'.");
+                return false;
+            }
+            empty = true;
+            break;
+        }
+        if (attributeCount >= attributes.size()) {
+            attributes.emplace_back();
+        }
+        XmlAttribute& attribute = attributes[attributeCount];
+        if (!read_name(attribute.name, d)) {
+            return false;
+        }
+        skip_whitespace();
+        if (next() != '=') {
+            fail("Expected '=' after attribute '" + attribute.name + "'.");
+            return false;
+        }
+        skip_whitespace();
+        const std::optional<char> quote = next();
+        if (quote != '"' && quote != '\'') {
+            fail("Expected quoted value for attribute '" + attribute.name + "'.");
+            return false;
+        }
+        if (!read_attribute_value(attribute.value, *quote)) {
+            return false;
+        }
+        attributeCount++;
+    }
+
+    openElements.push_back(std::move(elementName));
+    onStart(openElements.back(), XmlAttributes(std::span<const XmlAttribute>(attributes).first(attributeCount)));
+    if (error) {
+        return false;
+    }
+    if (empty) {
+        onEnd(openElements.back());
+        openElements.pop_back();
+    }
+    return !error;
+}
+
+bool XmlReader::parse(const StartElementHandler& onStart, const EndElementHandler& onEnd) {
+    // Skip the UTF-8 BOM:
+    if (peek() == '\xEF') {
+        next();
+        if (next() != '\xBB' || next() != '\xBF') {
+            fail("Invalid byte order mark.");
+            return false;
+        }
+    }
+
+    bool rootDone = false;
+    for (std::optional<char> c = next(); c; c = next()) {
+        if (*c != '<') {
+            // Text gets ignored, but there may not be any outside of the root element:
+            if (openElements.empty() && !is_whitespace(*c)) {
+                fail(std::string{"Unexpected character '"} + *c + "' outside of the root element.");
+                return false;
+            }
+            continue;
+        }
+
+        const std::optional<char> d = peek();
+        const bool isElement = d && *d != '?' && *d != '!' && *d != '/';
+        if (isElement && openElements.empty() && rootDone) {
+            fail("Multiple root elements.");
+            return false;
+        }
+        if (!read_tag(onStart, onEnd)) {
+            return false;
+        }
+        // Either an empty root element or the end tag of the root element:
+        if ((isElement || d == '/') && openElements.empty()) {
+            rootDone = true;
+        }
+    }
+
+    if (!openElements.empty()) {
+        fail("Unexpected end of file, '" + openElements.back() + "' not closed.");
+        return false;
+    }
+    if (!rootDone) {
+        fail("No root element found.");
+        return false;
+    }
+    return true;
+}
+//---------------------------------------------------------------------------
+}  // namespace jutta_bt_proto
+//---------------------------------------------------------------------------
@@ -1,18 +1,27 @@
 #include "bt/BLEHelper.hpp"
 #include "jutta_bt_proto/CoffeeMaker.hpp"
 #include "jutta_bt_proto/CoffeeMakerLoader.hpp"
+#include "jutta_bt_proto/MachineRegistry.hpp"
 #include "logger/Logger.hpp"
+#include <algorithm>
 #include <chrono>
 #include <cstddef>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <thread>
+#include <vector>
 #include <spdlog/spdlog.h>
 
-int main(int /*argc*/, char** /*argv*/) {
+int main(int argc, char** argv) {
     logger::setup_logger(spdlog::level::debug);
     SPDLOG_INFO("Starting test exec...");
+    const std::vector<std::string_view> args(argv, argv + argc);
+    if (std::find(args.begin(), args.end(), "--preload") != args.end()) {
+        // Parse all machine files upfront, so connecting does not have to:
+        static_cast<void>(jutta_bt_proto::MachineRegistry::get_instance().preload());
+    }
     while (true) {
         SPDLOG_INFO("Scanning...");
         bool canceled = false;
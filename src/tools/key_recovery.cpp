@@ -0,0 +1,117 @@
+#include "bt/ByteEncDecoder.hpp"
+#include "bt/KeyRecovery.hpp"
+#include "jutta_bt_proto/Utils.hpp"
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * Recovers the key from captured encoded frames.
+ * Reads one hex encoded frame per line from the given file or stdin.
+ * Empty lines and lines starting with '#' are ignored.
+ **/
+
+void print_usage(std::string_view name) {
+    std::cerr << "Usage: " << name << " [-d] [file]\n"
+              << "  -d    Print all frames decoded with the recovered key.\n"
+              << "  file  File containing one hex encoded frame per line. Defaults to stdin.\n";
+}
+
+std::string to_string(const bt::KeyCandidates& candidates) {
+    std::string result;
+    for (size_t key = 0; key < candidates.size(); key++) {
+        if (candidates.test(key)) {
+            if (!result.empty()) {
+                result += ' ';
+            }
+            result += "0x" + jutta_bt_proto::to_hex_string(std::vector<uint8_t>{static_cast<uint8_t>(key)});
+        }
+    }
+    return result.empty() ? "none" : result;
+}
+
+std::vector<std::vector<uint8_t>> read_frames(std::istream& in) {
+    std::vector<std::vector<uint8_t>> frames;
+    std::string line;
+    size_t lineNumber = 0;
+    while (std::getline(in, line)) {
+        lineNumber++;
+        std::erase_if(line, [](char c) { return std::isspace(static_cast<unsigned char>(c)); });
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::vector<uint8_t> frame(line.size() / 2);
+        const jutta_bt_proto::HexResult result = jutta_bt_proto::from_hex(line, frame);
+        if (!result) {
+            std::cerr << "Skipping invalid frame in line " << lineNumber << ": " << jutta_bt_proto::to_string(result.error()) << " at position " << result.position() << ".\n";
+            continue;
+        }
+        frames.push_back(std::move(frame));
+    }
+    return frames;
+}
+
+int main(int argc, char** argv) {
+    const std::vector<std::string_view> args(argv, argv + argc);
+    bool decode = false;
+    std::optional<std::string_view> path;
+    for (size_t i = 1; i < args.size(); i++) {
+        if (args[i] == "-d") {
+            decode = true;
+        } else if (args[i] == "-h" || args[i] == "--help" || path) {
+            print_usage(args[0]);
+            return args[i] == "-h" || args[i] == "--help" ? 0 : 1;
+        } else {
+            path = args[i];
+        }
+    }
+
+    std::vector<std::vector<uint8_t>> frames;
+    if (path) {
+        std::ifstream file{std::string{*path}};
+        if (!file) {
+            std::cerr << "Failed to open '" << *path << "'.\n";
+            return 1;
+        }
+        frames = read_frames(file);
+    } else {
+        frames = read_frames(std::cin);
+    }
+
+    const std::vector<bt::KeyCandidates> candidates = bt::find_key_candidates(frames);
+    bt::KeyCandidates common;
+    common.set();
+    for (size_t i = 0; i < candidates.size(); i++) {
+        std::cout << "Frame " << i << ": " << to_string(candidates[i]) << '\n';
+        common &= candidates[i];
+    }
+    if (frames.empty()) {
+        common.reset();
+    }
+    std::cout << "Common candidates: " << to_string(common) << '\n';
+
+    // Reuse the common candidates instead of looking them up again:
+    const std::optional<uint8_t> key = bt::recover_key(common, frames);
+    if (!key) {
+        std::cout << "Unable to recover a unique key from " << frames.size() << " frame(s).\n";
+        return 2;
+    }
+    std::cout << "Key: 0x" << jutta_bt_proto::to_hex_string(std::vector<uint8_t>{*key}) << '\n';
+
+    if (decode) {
+        const bt::CodecContext context(*key);
+        for (size_t i = 0; i < frames.size(); i++) {
+            std::vector<uint8_t> decoded(frames[i].size());
+            context.enc_dec(frames[i], decoded);
+            std::cout << "Decoded frame " << i << ": " << jutta_bt_proto::to_hex_string(decoded) << '\n';
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include "jutta_bt_proto/Arena.hpp"
+#include "jutta_bt_proto/CoffeeMakerLoader.hpp"
+#include "jutta_bt_proto/EmbeddedMachines.hpp"
+#include "jutta_bt_proto/MachineRegistry.hpp"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * Generates the C++ header with constant tables of JOE_MACHINES.TXT and all machine files (XML) it references.
+ * Used by the build with JUTTA_BT_PROTO_EMBED_MACHINES, so the library can serve the definitions without parsing anything at runtime.
+ **/
+
+void print_usage(std::string_view name) {
+    std::cerr << "Usage: " << name << " -o <header> [-n <namespace>] [machines]\n"
+              << "  -o <header>     Path of the header to write.\n"
+              << "  -n <namespace>  Namespace of the tables. Defaults to '" << jutta_bt_proto::EMBEDDED_MACHINES_NAMESPACE << "'.\n"
+              << "  machines        Path of the JOE_MACHINES.TXT. Defaults to '" << jutta_bt_proto::MachineRegistry::DEFAULT_PATH << "'.\n";
+}
+
+int main(int argc, char** argv) {
+    const std::vector<std::string_view> args(argv, argv + argc);
+    std::filesystem::path machinesPath = jutta_bt_proto::MachineRegistry::DEFAULT_PATH;
+    std::optional<std::filesystem::path> headerPath;
+    std::string_view nameSpace = jutta_bt_proto::EMBEDDED_MACHINES_NAMESPACE;
+    bool machinesPathSet = false;
+    for (size_t i = 1; i < args.size(); i++) {
+        if (args[i] == "-o" && i + 1 < args.size()) {
+            headerPath = args[++i];
+        } else if (args[i] == "-n" && i + 1 < args.size()) {
+            nameSpace = args[++i];
+        } else if (args[i] == "-h" || args[i] == "--help" || machinesPathSet) {
+            print_usage(args[0]);
+            return args[i] == "-h" || args[i] == "--help" ? 0 : 1;
+        } else {
+            machinesPath = args[i];
+            machinesPathSet = true;
+        }
+    }
+    if (!headerPath) {
+        print_usage(args[0]);
+        return 1;
+    }
+    if (!std::filesystem::exists(machinesPath)) {
+        std::cerr << "Machine file '" << machinesPath.string() << "' not found.\n";
+        return 1;
+    }
+
+    const std::filesystem::path directory = machinesPath.parent_path();
+    const std::shared_ptr<jutta_bt_proto::Arena> arena = std::make_shared<jutta_bt_proto::Arena>();
+    const jutta_bt_proto::Machines machines = jutta_bt_proto::load_machines(machinesPath, *arena);
+    std::vector<std::shared_ptr<const jutta_bt_proto::JoeDefinition>> definitions;
+    std::unordered_set<std::string_view> fileNames;
+    for (const auto& [articleNumber, machine] : machines) {
+        if (!fileNames.insert(machine.fileName).second) {
+            continue;
+        }
+        const std::filesystem::path xmlPath = directory / (std::string{machine.fileName} + ".xml");
+        if (!std::filesystem::exists(xmlPath)) {
+            std::cerr << "Machine file '" << xmlPath.string() << "' for '" << machine.name << "' not found. Skipping it.\n";
+            continue;
+        }
+        std::shared_ptr<const jutta_bt_proto::JoeDefinition> definition = jutta_bt_proto::load_joe(std::make_shared<const jutta_bt_proto::Machine>(machine), directory, arena);
+        if (!definition) {
+            std::cerr << "Failed to parse machine file '" << xmlPath.string() << "'.\n";
+            return 1;
+        }
+        definitions.push_back(std::move(definition));
+    }
+    const std::string header = jutta_bt_proto::to_embedded_header(machines, definitions, nameSpace);
+
+    std::filesystem::create_directories(headerPath->parent_path());
+    std::ofstream out(*headerPath, std::ios::binary | std::ios::trunc);
+    out << header;
+    if (!out) {
+        std::cerr << "Failed to write '" << headerPath->string() << "'.\n";
+        return 1;
+    }
+    std::cout << "Generated '" << headerPath->string() << "' with " << machines.size() << " machines and " << definitions.size() << " machine files.\n";
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include "jutta_bt_proto/MachineRegistry.hpp"
+#include "jutta_bt_proto/MachineSnapshot.hpp"
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+/**
+ * Compiles JOE_MACHINES.TXT and all machine files (XML) it references into a single binary snapshot.
+ * The MachineRegistry loads the snapshot instead of parsing the machine files in case it is up to date.
+ **/
+
+void print_usage(std::string_view name) {
+    std::cerr << "Usage: " << name << " [-o <snapshot>] [-c] [machines]\n"
+              << "  -o <snapshot>  Path of the snapshot to write. Defaults to the machines file with the extension '.snapshot'.\n"
+              << "  -c             Only check whether the snapshot is valid and up to date instead of writing it.\n"
+              << "  machines       Path of the JOE_MACHINES.TXT. Defaults to '" << jutta_bt_proto::MachineRegistry::DEFAULT_PATH << "'.\n";
+}
+
+int main(int argc, char** argv) {
+    const std::vector<std::string_view> args(argv, argv + argc);
+    std::filesystem::path machinesPath = jutta_bt_proto::MachineRegistry::DEFAULT_PATH;
+    std::optional<std::filesystem::path> snapshotPath;
+    bool check = false;
+    bool machinesPathSet = false;
+    for (size_t i = 1; i < args.size(); i++) {
+        if (args[i] == "-o" && i + 1 < args.size()) {
+            snapshotPath = args[++i];
+        } else if (args[i] == "-c") {
+            check = true;
+        } else if (args[i] == "-h" || args[i] == "--help" || machinesPathSet) {
+            print_usage(args[0]);
+            return args[i] == "-h" || args[i] == "--help" ? 0 : 1;
+        } else {
+            machinesPath = args[i];
+            machinesPathSet = true;
+        }
+    }
+    if (!snapshotPath) {
+        snapshotPath = jutta_bt_proto::to_snapshot_path(machinesPath);
+    }
+
+    if (check) {
+        const std::shared_ptr<const jutta_bt_proto::MachineSnapshot> snapshot = jutta_bt_proto::MachineSnapshot::open(*snapshotPath);
+        if (!snapshot) {
+            std::cout << "Snapshot '" << snapshotPath->string() << "' is missing, invalid or stale.\n";
+            return 2;
+        }
+        std::cout << "Snapshot '" << snapshotPath->string() << "' is up to date with " << snapshot->get_machines().size() << " machines.\n";
+        return 0;
+    }
+
+    if (!jutta_bt_proto::compile_snapshot(machinesPath, *snapshotPath)) {
+        std::cerr << "Failed to compile '" << machinesPath.string() << "' into '" << snapshotPath->string() << "'.\n";
+        return 1;
+    }
+    return 0;
+}
@@ -1,11 +1,41 @@
 #define CATCH_CONFIG_MAIN
 
 #include "bt/ByteEncDecoder.hpp"
+#include "bt/CodecKernels.hpp"
+#include "bt/FrameBatch.hpp"
+#include "bt/KeyRecovery.hpp"
+#include "bt/Uuid.hpp"
+#include "jutta_bt_proto/Arena.hpp"
+#include "jutta_bt_proto/CoffeeMaker.hpp"
+#include "jutta_bt_proto/CoffeeMakerLoader.hpp"
+#include "jutta_bt_proto/EmbeddedMachines.hpp"
+#include "jutta_bt_proto/FixedCommands.hpp"
+#include "jutta_bt_proto/HexView.hpp"
+#include "jutta_bt_proto/MachineRegistry.hpp"
+#include "jutta_bt_proto/MachineSnapshot.hpp"
+#include "jutta_bt_proto/MachineWatcher.hpp"
+#include "jutta_bt_proto/ManufacturerData.hpp"
+#include "jutta_bt_proto/ProductCommandCache.hpp"
 #include "jutta_bt_proto/Utils.hpp"
+#include "jutta_bt_proto/XmlReader.hpp"
+// Generated from tests/resources/machinefiles during the build:
+#include "EmbeddedTestMachines.hpp"
 #include <catch2/catch.hpp>
+#include <spdlog/fmt/fmt.h>
 #include <cstddef>
 #include <cstdint>
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
 #include <random>
+#include <sstream>
+#include <span>
+#include <string>
+#include <thread>
 #include <vector>
 
 TEST_CASE("Empty", "[encDecBytes]") {
@@ -90,6 +120,323 @@ TEST_CASE("InverseManyElementsRepeated", "[encDecBytes]") {
     }
 }
 
+TEST_CASE("SpanMatchesVector", "[encDecBytes]") {
+    const std::vector<uint8_t> data{0x2A, 0x03, 0x00, 0x04, 0x14, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x2A};
+    const uint8_t key = 42;
+    const std::vector<uint8_t> expected = bt::encDecBytes(data, key);
+
+    std::vector<uint8_t> out(data.size());
+    bt::encDecBytes(data, out, key);
+    REQUIRE(out == expected);
+
+    std::vector<uint8_t> inPlace = data;
+    bt::encDecBytes(std::span<uint8_t>(inPlace), key);
+    REQUIRE(inPlace == expected);
+
+    const bt::CodecContext context(key);
+    std::fill(out.begin(), out.end(), 0);
+    context.enc_dec(data, out);
+    REQUIRE(out == expected);
+
+    inPlace = data;
+    context.enc_dec(std::span<uint8_t>(inPlace));
+    REQUIRE(inPlace == expected);
+}
+
+TEST_CASE("ContextMatchesAllKeys", "[CodecContext]") {
+    std::random_device dev;
+    std::mt19937 rng(dev());
+    std::uniform_int_distribution<std::mt19937::result_type> dist(0, 255);
+
+    // Longer than a full period to ensure the position wraps correctly:
+    std::vector<uint8_t> data;
+    for (size_t i = 0; i < bt::CodecContext::PERIOD * 3 + 7; i++) {
+        data.push_back(static_cast<uint8_t>(dist(rng)));
+    }
+
+    for (size_t key = 0; key <= 0xFF; key++) {
+        const bt::CodecContext context(static_cast<uint8_t>(key));
+        REQUIRE(context.get_key() == key);
+        REQUIRE(context.enc_dec(data) == bt::encDecBytes(data, static_cast<uint8_t>(key)));
+    }
+}
+
+TEST_CASE("ContextInverse", "[CodecContext]") {
+    const std::vector<uint8_t> data{0x00, 0x7F, 0x80, 0x2A, 0xFF};
+    const bt::CodecContext context(42);
+    REQUIRE(context.enc_dec(context.enc_dec(data)) == data);
+    REQUIRE(context.enc_dec(std::vector<uint8_t>{}).empty());
+}
+
+TEST_CASE("KernelsMatchAllKeys", "[CodecKernels]") {
+    std::random_device dev;
+    std::mt19937 rng(dev());
+    std::uniform_int_distribution<std::mt19937::result_type> dist(0, 255);
+
+    std::vector<uint8_t> data;
+    for (size_t i = 0; i < 1031; i++) {
+        data.push_back(static_cast<uint8_t>(dist(rng)));
+    }
+
+    for (const bt::CodecKernel kernel : {bt::CodecKernel::SCALAR, bt::CodecKernel::SSSE3, bt::CodecKernel::AVX2, bt::CodecKernel::NEON}) {
+        if (!bt::is_codec_kernel_supported(kernel)) {
+            continue;
+        }
+        for (size_t key = 0; key <= 0xFF; key++) {
+            const std::vector<uint8_t> expected = bt::encDecBytes(data, static_cast<uint8_t>(key));
+            std::vector<uint8_t> result(data.size());
+            bt::enc_dec_kernel(kernel, data, result, static_cast<uint8_t>(key));
+            REQUIRE(result == expected);
+        }
+    }
+}
+
+TEST_CASE("KernelsOffset", "[CodecKernels]") {
+    std::vector<uint8_t> data;
+    for (size_t i = 0; i < 300; i++) {
+        data.push_back(static_cast<uint8_t>(i * 7));
+    }
+    const uint8_t key = 0x2A;
+    const std::vector<uint8_t> expected = bt::encDecBytes(data, key);
+
+    for (const bt::CodecKernel kernel : {bt::CodecKernel::SCALAR, bt::CodecKernel::SSSE3, bt::CodecKernel::AVX2, bt::CodecKernel::NEON}) {
+        if (!bt::is_codec_kernel_supported(kernel)) {
+            continue;
+        }
+        for (size_t offset = 0; offset < 140; offset += 3) {
+            std::vector<uint8_t> result(data.size() - offset);
+            bt::enc_dec_kernel(kernel, std::span<const uint8_t>(data).subspan(offset), result, key, offset);
+            REQUIRE(std::equal(result.begin(), result.end(), expected.begin() + static_cast<std::ptrdiff_t>(offset)));
+        }
+    }
+}
+
+TEST_CASE("StreamMatchesWholeFrame", "[StreamCodec]") {
+    std::vector<uint8_t> data;
+    for (size_t i = 0; i < 700; i++) {
+        data.push_back(static_cast<uint8_t>(i * 13));
+    }
+    const uint8_t key = 0x2A;
+    const std::vector<uint8_t> expected = bt::encDecBytes(data, key);
+
+    const bt::CodecContext context(key);
+    bt::StreamCodec stream;
+    // Process the frame in chunks of varying size, some below and some above the kernel threshold:
+    std::vector<uint8_t> result(data.size());
+    size_t offset = 0;
+    for (size_t chunkSize = 1; offset < data.size(); chunkSize = (chunkSize * 3) % 97 + 1) {
+        const size_t size = std::min(chunkSize, data.size() - offset);
+        stream.enc_dec(context, std::span<const uint8_t>(data).subspan(offset, size), std::span<uint8_t>(result).subspan(offset, size));
+        offset += size;
+        REQUIRE(stream.get_offset() == offset);
+    }
+    REQUIRE(result == expected);
+
+    stream.reset();
+    REQUIRE(stream.get_offset() == 0);
+    std::vector<uint8_t> inPlace = data;
+    stream.enc_dec(context, std::span<uint8_t>(inPlace));
+    REQUIRE(inPlace == expected);
+}
+
+TEST_CASE("StreamBackToBackFrames", "[StreamCodec]") {
+    const uint8_t key = 0x2A;
+    const bt::CodecContext context(key);
+    const std::vector<uint8_t> first{'@', 'a', 'n', ':', '0', '1', '\r', '\n'};
+    const std::vector<uint8_t> second{'@', 't', 'v', ':', '4', '2', '\r', '\n'};
+    const std::vector<uint8_t> firstEncoded = bt::encDecBytes(first, key);
+    const std::vector<uint8_t> secondEncoded = bt::encDecBytes(second, key);
+
+    // Each frame starts at the beginning of the key stream again, so the stream has to be reset in between:
+    bt::StreamCodec stream;
+    std::vector<uint8_t> result(first.size());
+    stream.enc_dec(context, std::span<const uint8_t>(firstEncoded).first(3), std::span<uint8_t>(result).first(3));
+    stream.enc_dec(context, std::span<const uint8_t>(firstEncoded).subspan(3), std::span<uint8_t>(result).subspan(3));
+    REQUIRE(result == first);
+    stream.reset();
+    result.resize(second.size());
+    stream.enc_dec(context, secondEncoded, result);
+    REQUIRE(result == second);
+
+    // Without the reset, the second frame gets decoded at the wrong offset:
+    bt::StreamCodec unreset;
+    std::vector<uint8_t> wrong(first.size());
+    unreset.enc_dec(context, firstEncoded, wrong);
+    unreset.enc_dec(context, secondEncoded, wrong);
+    REQUIRE(wrong != second);
+
+    // Decoding each frame on its own like notifications:
+    std::vector<uint8_t> notification(second.size());
+    context.enc_dec(secondEncoded, notification);
+    REQUIRE(notification == second);
+}
+
+TEST_CASE("ConstexprMatchesRuntime", "[encDecArray]") {
+    static constexpr std::array<uint8_t, 5> data{0x2A, 0x7F, 0x80, 0x00, 0xFF};
+    for (size_t key = 0; key <= 0xFF; key++) {
+        const std::array<uint8_t, 5> result = bt::encDecArray(data, static_cast<uint8_t>(key));
+        const std::vector<uint8_t> expected = bt::encDecBytes(std::vector<uint8_t>(data.begin(), data.end()), static_cast<uint8_t>(key));
+        REQUIRE(std::equal(result.begin(), result.end(), expected.begin(), expected.end()));
+    }
+}
+
+template <size_t N>
+void check_frames(const jutta_bt_proto::EncodedFrames<N>& frames, const std::array<uint8_t, N>& command) {
+    for (size_t key = 0; key <= 0xFF; key++) {
+        std::vector<uint8_t> data(command.begin(), command.end());
+        data[0] = static_cast<uint8_t>(key);
+        const std::vector<uint8_t> expected = bt::encDecBytes(data, static_cast<uint8_t>(key));
+        REQUIRE(std::equal(frames[key].begin(), frames[key].end(), expected.begin(), expected.end()));
+    }
+}
+
+TEST_CASE("FixedFramesMatchRuntime", "[FixedCommands]") {
+    check_frames(jutta_bt_proto::STAY_IN_BLE_FRAMES, jutta_bt_proto::STAY_IN_BLE_COMMAND);
+    check_frames(jutta_bt_proto::DISCONNECT_FRAMES, jutta_bt_proto::DISCONNECT_COMMAND);
+    check_frames(jutta_bt_proto::SHUTDOWN_FRAMES, jutta_bt_proto::SHUTDOWN_COMMAND);
+    check_frames(jutta_bt_proto::LOCK_FRAMES, jutta_bt_proto::LOCK_COMMAND);
+    check_frames(jutta_bt_proto::UNLOCK_FRAMES, jutta_bt_proto::UNLOCK_COMMAND);
+}
+
+TEST_CASE("FixedFramesKnownValues", "[FixedCommands]") {
+    // Examples from the README:
+    static_assert(jutta_bt_proto::STAY_IN_BLE_FRAMES[0x2A] == std::array<uint8_t, 3>{0x77, 0x65, 0x6D});
+    static_assert(jutta_bt_proto::LOCK_FRAMES[0x2A] == std::array<uint8_t, 2>{0x77, 0xE0});
+    static_assert(jutta_bt_proto::UNLOCK_FRAMES[0x2A] == std::array<uint8_t, 2>{0x77, 0xE1});
+    REQUIRE(jutta_bt_proto::STAY_IN_BLE_FRAMES[0x2A][0] == 0x77);
+}
+
+TEST_CASE("KeyCandidatesAllKeys", "[KeyRecovery]") {
+    for (size_t key = 0; key <= 0xFF; key++) {
+        const std::vector<uint8_t> frame = bt::encDecBytes({static_cast<uint8_t>(key), 0x7F, 0x80}, static_cast<uint8_t>(key));
+        const bt::KeyCandidates candidates = bt::find_key_candidates(frame);
+        REQUIRE(candidates.test(key));
+        // Every candidate has to decode the frame so it starts with itself:
+        for (size_t candidate = 0; candidate <= 0xFF; candidate++) {
+            const bool matches = bt::encDecBytes(frame, static_cast<uint8_t>(candidate))[0] == candidate;
+            REQUIRE(candidates.test(candidate) == matches);
+        }
+    }
+    REQUIRE(bt::find_key_candidates(std::vector<uint8_t>{}).none());
+}
+
+TEST_CASE("RecoverKeyFromCapture", "[KeyRecovery]") {
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<std::mt19937::result_type> dist(0, 255);
+
+    for (size_t key = 0; key <= 0xFF; key++) {
+        std::vector<std::vector<uint8_t>> frames;
+        for (size_t i = 0; i < 64; i++) {
+            std::vector<uint8_t> data{static_cast<uint8_t>(key)};
+            for (size_t e = 0; e < 1 + i % 20; e++) {
+                data.push_back(static_cast<uint8_t>(dist(rng)));
+            }
+            // Every fourth frame is a command with the key overridden at the end:
+            if (i % 4 == 0) {
+                data.back() = static_cast<uint8_t>(key);
+            }
+            frames.push_back(bt::encDecBytes(data, static_cast<uint8_t>(key)));
+        }
+        const bt::KeyCandidates common = bt::find_common_key_candidates(frames);
+        REQUIRE(common.test(key));
+        REQUIRE(bt::recover_key(frames) == std::optional<uint8_t>{static_cast<uint8_t>(key)});
+        REQUIRE(bt::recover_key(common, frames) == std::optional<uint8_t>{static_cast<uint8_t>(key)});
+        REQUIRE(bt::find_key_candidates(frames).size() == frames.size());
+    }
+    // Key 0x2A does not share its start byte with any other key:
+    REQUIRE(bt::recover_key(bt::encDecBytes({0x2A, 0x00, 0x01}, 0x2A)) == std::optional<uint8_t>{0x2A});
+    REQUIRE(bt::find_common_key_candidates(std::vector<std::vector<uint8_t>>{}).none());
+    REQUIRE_FALSE(bt::recover_key(std::vector<std::vector<uint8_t>>{}));
+}
+
+TEST_CASE("BatchKernelsMatchPerFrame", "[CodecKernels]") {
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<std::mt19937::result_type> dist(0, 255);
+
+    // 75 frames: two full AVX2 blocks, some SSSE3 blocks and a scalar tail.
+    const size_t frameCount = 75;
+    const size_t frameSize = 150;
+    std::vector<uint8_t> keys;
+    std::vector<std::vector<uint8_t>> frames;
+    std::vector<uint8_t> data(frameCount * frameSize);
+    for (size_t f = 0; f < frameCount; f++) {
+        keys.push_back(static_cast<uint8_t>(dist(rng)));
+        std::vector<uint8_t> frame;
+        for (size_t i = 0; i < frameSize; i++) {
+            frame.push_back(static_cast<uint8_t>(dist(rng)));
+            data[(i * frameCount) + f] = frame.back();
+        }
+        frames.push_back(frame);
+    }
+
+    for (const bt::CodecKernel kernel : {bt::CodecKernel::SCALAR, bt::CodecKernel::SSSE3, bt::CodecKernel::AVX2, bt::CodecKernel::NEON}) {
+        if (!bt::is_codec_kernel_supported(kernel)) {
+            continue;
+        }
+        std::vector<uint8_t> result(data.size());
+        bt::enc_dec_batch(kernel, data, result, keys, frameSize);
+        for (size_t f = 0; f < frameCount; f++) {
+            const std::vector<uint8_t> expected = bt::encDecBytes(frames[f], keys[f]);
+            for (size_t i = 0; i < frameSize; i++) {
+                REQUIRE(result[(i * frameCount) + f] == expected[i]);
+            }
+        }
+    }
+}
+
+TEST_CASE("FrameBatchRoundTrip", "[FrameBatch]") {
+    bt::FrameBatch batch(64, 20);
+    REQUIRE(batch.empty());
+    std::vector<std::vector<uint8_t>> frames;
+    for (size_t f = 0; f < 40; f++) {
+        std::vector<uint8_t> frame;
+        for (size_t i = 0; i < 1 + f % 20; i++) {
+            frame.push_back(static_cast<uint8_t>(f * 31 + i));
+        }
+        REQUIRE(batch.add(frame, static_cast<uint8_t>(f * 5)));
+        frames.push_back(frame);
+    }
+    REQUIRE_FALSE(batch.add(std::vector<uint8_t>(21), 0));
+    REQUIRE(batch.size() == frames.size());
+
+    batch.enc_dec();
+    for (size_t f = 0; f < frames.size(); f++) {
+        REQUIRE(batch.get_frame(f) == bt::encDecBytes(frames[f], static_cast<uint8_t>(f * 5)));
+    }
+    // Decoding again restores the original frames:
+    batch.enc_dec();
+    for (size_t f = 0; f < frames.size(); f++) {
+        REQUIRE(batch.get_frame(f) == frames[f]);
+    }
+
+    batch.clear();
+    REQUIRE(batch.empty());
+    for (size_t f = 0; f < batch.get_capacity(); f++) {
+        REQUIRE(batch.add(frames[0], 0x2A));
+    }
+    REQUIRE_FALSE(batch.add(frames[0], 0x2A));
+}
+
+TEST_CASE("ShortUuidsExpandToBaseUuid", "[Uuid]") {
+    uuid_t uuid16{};
+    uuid16.type = SDP_UUID16;
+    uuid16.value.uuid16 = 0x2A00;
+
+    // 00002A00-0000-1000-8000-00805F9B34FB
+    uuid_t uuid128{};
+    uuid128.type = SDP_UUID128;
+    const std::array<uint8_t, 16> bytes{0x00, 0x00, 0x2A, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0x80, 0x5F, 0x9B, 0x34, 0xFB};
+    std::copy(bytes.begin(), bytes.end(), std::begin(uuid128.value.uuid128.data));
+
+    REQUIRE(bt::to_uuid128(uuid16) == bt::to_uuid128(uuid128));
+    REQUIRE(bt::to_uuid128(uuid16).high == 0x00002A0000001000);
+    REQUIRE(bt::to_uuid128(uuid16).low == 0x800000805F9B34FB);
+    REQUIRE(bt::Uuid128Hash{}(bt::to_uuid128(uuid16)) == bt::Uuid128Hash{}(bt::to_uuid128(uuid128)));
+
+    uuid128.value.uuid128.data[15] ^= 0x01;
+    REQUIRE_FALSE(bt::to_uuid128(uuid16) == bt::to_uuid128(uuid128));
+}
+
 TEST_CASE("Uppercase", "[toFormHex]") {
     std::string s = "0123456789ABCDEF";
     const std::vector<uint8_t> tmp = jutta_bt_proto::from_hex_string(s);
@@ -107,3 +454,926 @@ TEST_CASE("Lowercase", "[toFormHex]") {
     REQUIRE(result.size() == tmp.size() * 2);
     REQUIRE(result == "0123456789ABCDEF");
 }
+
+TEST_CASE("HexAllBytes", "[toFormHex]") {
+    // Sizes below and above the SIMD block size:
+    for (const size_t size : {0, 1, 15, 16, 17, 31, 32, 33, 256, 1000}) {
+        std::vector<uint8_t> data;
+        for (size_t i = 0; i < size; i++) {
+            data.push_back(static_cast<uint8_t>((i * 37) + 11));
+        }
+        std::string expected;
+        for (const uint8_t b : data) {
+            expected += fmt::format("{:02X}", b);
+        }
+
+        std::string hex(size * 2, ' ');
+        const jutta_bt_proto::HexResult hexResult = jutta_bt_proto::to_hex(data, hex);
+        REQUIRE(hexResult);
+        REQUIRE(hexResult.value() == size * 2);
+        REQUIRE(hex == expected);
+        REQUIRE(jutta_bt_proto::to_hex_string(data) == expected);
+
+        std::vector<uint8_t> result(size);
+        const jutta_bt_proto::HexResult bytesResult = jutta_bt_proto::from_hex(hex, result);
+        REQUIRE(bytesResult);
+        REQUIRE(bytesResult.value() == size);
+        REQUIRE(result == data);
+        // Lower case input:
+        std::transform(hex.begin(), hex.end(), hex.begin(), [](char c) { return static_cast<char>(std::tolower(c)); });
+        REQUIRE(jutta_bt_proto::from_hex_string(hex) == data);
+    }
+}
+
+TEST_CASE("HexErrors", "[toFormHex]") {
+    std::array<uint8_t, 32> buffer{};
+    const jutta_bt_proto::HexResult odd = jutta_bt_proto::from_hex("ABC", buffer);
+    REQUIRE_FALSE(odd);
+    REQUIRE(odd.error() == jutta_bt_proto::HexError::ODD_LENGTH);
+
+    const jutta_bt_proto::HexResult small = jutta_bt_proto::from_hex("ABCD", std::span<uint8_t>(buffer).first(1));
+    REQUIRE_FALSE(small);
+    REQUIRE(small.error() == jutta_bt_proto::HexError::BUFFER_TOO_SMALL);
+
+    std::array<char, 3> chars{};
+    REQUIRE(jutta_bt_proto::to_hex(std::vector<uint8_t>{0x01, 0x02}, chars).error() == jutta_bt_proto::HexError::BUFFER_TOO_SMALL);
+
+    // Invalid characters at every position, inside and outside of the SIMD blocks:
+    for (size_t pos = 0; pos < 40; pos++) {
+        for (const char c : {'G', 'g', '/', ':', '@', '`', ' ', '\xFF'}) {
+            std::string hex(40, 'a');
+            hex[pos] = c;
+            const jutta_bt_proto::HexResult result = jutta_bt_proto::from_hex(hex, buffer);
+            REQUIRE_FALSE(result);
+            REQUIRE(result.error() == jutta_bt_proto::HexError::INVALID_CHARACTER);
+            REQUIRE(result.position() == pos);
+        }
+    }
+    REQUIRE(jutta_bt_proto::from_hex_string("0X").empty());
+}
+
+TEST_CASE("HexViewMatchesString", "[HexView]") {
+    // Sizes around the internal chunk size:
+    for (const size_t size : {0, 1, 63, 64, 65, 200}) {
+        std::vector<uint8_t> data;
+        for (size_t i = 0; i < size; i++) {
+            data.push_back(static_cast<uint8_t>(i * 3));
+        }
+        REQUIRE(fmt::format("{}", jutta_bt_proto::HexView(data)) == jutta_bt_proto::to_hex_string(data));
+    }
+    REQUIRE(fmt::format("Wrote: {}", jutta_bt_proto::HexView(std::vector<uint8_t>{0x2A, 0x0F})) == "Wrote: 2A0F");
+}
+
+TEST_CASE("ProductCommandTemplate", "[CoffeeMakerLoader]") {
+    std::vector<jutta_bt_proto::Item> strengthItems;
+    strengthItems.emplace_back("Mild", "01");
+    strengthItems.emplace_back("Strong", "03");
+    const jutta_bt_proto::Product product("Coffee", "03",
+                                          std::make_optional<jutta_bt_proto::ItemsOption>("F3", "02", strengthItems),
+                                          std::make_optional<jutta_bt_proto::ItemsOption>("F7", "01", std::span<const jutta_bt_proto::Item>{}),
+                                          std::make_optional<jutta_bt_proto::MinMaxOption>("F4", 100, 25, 240, 5),
+                                          std::nullopt);
+    // Same as the previous hex string based implementation: "00" + code + options at F<n>.
+    REQUIRE(product.to_bt_command() == "000300021400000100000000000000000000");
+    REQUIRE(product.command[1] == 0x03);
+
+    // Brewing a variant is just a few byte stores:
+    jutta_bt_proto::ProductCommand command = product.command;
+    product.strength->to_bt_command(command, product.strength->items[1].commandValue);
+    product.waterAmount->to_bt_command(command, 200);
+    REQUIRE(command[3] == 0x03);
+    REQUIRE(command[4] == 40);
+    REQUIRE(command[7] == 0x01);
+
+    REQUIRE(jutta_bt_proto::to_command_offset("F17") == std::optional<size_t>{17});
+    REQUIRE_FALSE(jutta_bt_proto::to_command_offset("F18"));
+    REQUIRE_FALSE(jutta_bt_proto::to_command_offset("F1"));
+    REQUIRE_FALSE(jutta_bt_proto::to_command_offset("X3"));
+    REQUIRE_FALSE(jutta_bt_proto::to_command_offset("F3a"));
+    REQUIRE(jutta_bt_proto::to_command_byte("0A") == 0x0A);
+    REQUIRE(jutta_bt_proto::to_command_byte("A") == 0);
+}
+
+TEST_CASE("ProductCommandCacheMatchesWrite", "[ProductCommandCache]") {
+    std::vector<jutta_bt_proto::Product> products;
+    for (const char* code : {"02", "03", "04"}) {
+        products.emplace_back("Product", code, std::nullopt, std::nullopt, std::make_optional<jutta_bt_proto::MinMaxOption>("F4", 100, 25, 240, 5), std::nullopt);
+    }
+    const uint8_t key = 0x2A;
+    // Same as CoffeeMaker::write() with encode and overrideKey set:
+    const auto expected = [key](const jutta_bt_proto::ProductCommand& command) {
+        std::vector<uint8_t> data(command.begin(), command.end());
+        data.front() = key;
+        data.back() = key;
+        return bt::encDecBytes(data, key);
+    };
+    const auto toVector = [](std::span<const uint8_t> data) { return std::vector<uint8_t>(data.begin(), data.end()); };
+
+    jutta_bt_proto::ProductCommandCache cache(2);
+    cache.rebuild(products, key);
+    for (const jutta_bt_proto::Product& product : products) {
+        REQUIRE(toVector(cache.get(product.command)) == expected(product.command));
+    }
+    REQUIRE(cache.get_hits() == products.size());
+    REQUIRE(cache.get_misses() == 0);
+
+    // Variants with a different water amount:
+    std::vector<jutta_bt_proto::ProductCommand> variants;
+    for (uint8_t amount : {50, 60, 70}) {
+        jutta_bt_proto::ProductCommand command = products[0].command;
+        products[0].waterAmount->to_bt_command(command, amount);
+        variants.push_back(command);
+    }
+    REQUIRE(toVector(cache.get(variants[0])) == expected(variants[0]));
+    REQUIRE(toVector(cache.get(variants[1])) == expected(variants[1]));
+    REQUIRE(cache.get_misses() == 2);
+    REQUIRE(toVector(cache.get(variants[0])) == expected(variants[0]));
+    REQUIRE(cache.get_misses() == 2);
+    // Evicts variants[1], the least recently used one:
+    REQUIRE(toVector(cache.get(variants[2])) == expected(variants[2]));
+    REQUIRE(cache.get_misses() == 3);
+    REQUIRE(toVector(cache.get(variants[0])) == expected(variants[0]));
+    REQUIRE(cache.get_misses() == 3);
+    REQUIRE(toVector(cache.get(variants[1])) == expected(variants[1]));
+    REQUIRE(cache.get_misses() == 4);
+
+    // A new key drops all variants:
+    cache.rebuild(products, 0x10);
+    REQUIRE(cache.get_key() == 0x10);
+    REQUIRE(cache.get(products[0].command)[0] != expected(products[0].command)[0]);
+}
+
+TEST_CASE("JoeIndexes", "[CoffeeMakerLoader]") {
+    std::vector<jutta_bt_proto::Product> products;
+    products.emplace_back("Espresso", "02", std::make_optional<jutta_bt_proto::ItemsOption>("F3", "02", std::span<const jutta_bt_proto::Item>{}), std::nullopt, std::make_optional<jutta_bt_proto::MinMaxOption>("F4", 45, 25, 80, 5), std::nullopt);
+    products.emplace_back("Hot water", "0D", std::nullopt, std::nullopt, std::nullopt, std::nullopt);
+    std::vector<jutta_bt_proto::Alert> alerts;
+    alerts.emplace_back(1, "fill water", "error");
+    alerts.emplace_back(13, "empty grounds", "error");
+    const jutta_bt_proto::JoeDefinition joe(nullptr, "2021", nullptr, std::move(products), std::move(alerts), {}, {});
+
+    REQUIRE(joe.products[1].codeValue == 0x0D);
+    REQUIRE(joe.products[1].code_to_size_t() == 0x0D);
+    REQUIRE(joe.find_product_by_code(0x0D) == &joe.products[1]);
+    REQUIRE(joe.find_product_by_code(0x0E) == nullptr);
+    REQUIRE(joe.find_product_by_name("Espresso") == &joe.products[0]);
+    REQUIRE(joe.find_product_by_name("Latte") == nullptr);
+    REQUIRE(joe.find_alert_by_bit(13) == &joe.alerts[1]);
+    REQUIRE(joe.find_alert_by_bit(2) == nullptr);
+
+    const jutta_bt_proto::Product& espresso = joe.products[0];
+    REQUIRE(espresso.find_items_option(3) == &*espresso.strength);
+    REQUIRE(espresso.find_min_max_option(4) == &*espresso.waterAmount);
+    REQUIRE(espresso.find_items_option(4) == nullptr);
+    REQUIRE(espresso.find_min_max_option(5) == nullptr);
+    REQUIRE(espresso.find_min_max_option(100) == nullptr);
+    REQUIRE(jutta_bt_proto::to_product_code("0102") == 0x0102);
+}
+
+TEST_CASE("JoeSharesDefinition", "[CoffeeMakerLoader]") {
+    std::vector<jutta_bt_proto::Product> products;
+    products.emplace_back("Espresso", "02", std::nullopt, std::nullopt, std::nullopt, std::nullopt);
+    products.emplace_back("Hot water", "0D", std::nullopt, std::nullopt, std::nullopt, std::nullopt);
+    std::vector<jutta_bt_proto::MaintenanceCounter> counters;
+    counters.emplace_back("cleaning", 0);
+    const std::shared_ptr<const jutta_bt_proto::JoeDefinition> definition = std::make_shared<const jutta_bt_proto::JoeDefinition>(nullptr, "2021", nullptr, std::move(products), std::vector<jutta_bt_proto::Alert>{}, std::move(counters), std::vector<jutta_bt_proto::MaintenancePercentage>{});
+
+    jutta_bt_proto::Joe first(definition);
+    const jutta_bt_proto::Joe second(definition);
+    REQUIRE(first.definition == second.definition);
+    REQUIRE(first.productStatCounters.size() == 2);
+    REQUIRE(first.maintenanceCounters.size() == 1);
+
+    // State of one connection does not leak into the other:
+    first.productStatCounters[1] = 42;
+    first.maintenanceCounters[0].count = 7;
+    REQUIRE(first.get_stat_counter(definition->products[1]) == 42);
+    REQUIRE(second.get_stat_counter(definition->products[1]) == 0);
+    REQUIRE(second.maintenanceCounters[0].count == 0);
+    REQUIRE(definition->maintenanceCounters[0].count == 0);
+}
+
+TEST_CASE("AlertsMatchStatusBits", "[CoffeeMakerLoader]") {
+    jutta_bt_proto::Arena arena;
+    std::vector<jutta_bt_proto::Alert> alerts;
+    for (const size_t bit : {0, 1, 7, 8, 13, 13, 31, 63, 64, 70, 95}) {
+        alerts.emplace_back(bit, arena.intern("Alert " + std::to_string(bit)), "info");
+    }
+    const jutta_bt_proto::JoeDefinition joe(nullptr, "2021", nullptr, {}, std::move(alerts), {}, {});
+    REQUIRE(joe.find_alerts_by_bit(13).size() == 2);
+    REQUIRE(joe.find_alerts_by_bit(14).empty());
+    REQUIRE(joe.find_alerts_by_bit(1000).empty());
+
+    std::mt19937 rng(13);
+    std::uniform_int_distribution<std::mt19937::result_type> dist(0, 255);
+    for (size_t run = 0; run < 200; run++) {
+        std::vector<uint8_t> status(run % 20);
+        for (uint8_t& b : status) {
+            b = static_cast<uint8_t>(dist(rng));
+        }
+        // Reference: check every bit MSB first against every alert.
+        std::vector<const jutta_bt_proto::Alert*> expected;
+        for (size_t i = 0; i < status.size() * 8; i++) {
+            if ((status[i >> 3] >> (7 - (i & 0b111))) & 0b1) {
+                for (const jutta_bt_proto::Alert& alert : joe.alerts) {
+                    if (alert.bit == i) {
+                        expected.push_back(&alert);
+                    }
+                }
+            }
+        }
+        std::vector<const jutta_bt_proto::Alert*> result;
+        joe.find_alerts(status, result);
+        REQUIRE(result == expected);
+    }
+}
+
+TEST_CASE("StatusDeltas", "[CoffeeMakerLoader]") {
+    std::vector<jutta_bt_proto::Alert> alerts;
+    for (const size_t bit : {1, 7, 13, 13, 20}) {
+        alerts.emplace_back(bit, "Alert", "info");
+    }
+    const jutta_bt_proto::JoeDefinition joe(nullptr, "2021", nullptr, {}, std::move(alerts), {}, {});
+    const std::vector<const jutta_bt_proto::Alert*> bit1{&joe.alerts[0]};
+    const std::vector<const jutta_bt_proto::Alert*> bit20{&joe.alerts[4]};
+    std::vector<const jutta_bt_proto::Alert*> raised;
+    std::vector<const jutta_bt_proto::Alert*> cleared;
+    auto find_changed = [&](std::vector<uint8_t> last, std::vector<uint8_t> status) {
+        raised.clear();
+        cleared.clear();
+        joe.find_changed_alerts(last, status, raised, cleared);
+    };
+
+    // The first status raises all set alerts:
+    find_changed({}, {0b01000001, 0b00000100, 0b00001000});
+    REQUIRE(raised == std::vector<const jutta_bt_proto::Alert*>{&joe.alerts[0], &joe.alerts[1], &joe.alerts[2], &joe.alerts[3], &joe.alerts[4]});
+    REQUIRE(cleared.empty());
+
+    // A single cleared bit:
+    find_changed({0b01000001, 0b00000100}, {0b00000001, 0b00000100});
+    REQUIRE(raised.empty());
+    REQUIRE(cleared == bit1);
+
+    // Raised and cleared at the same time:
+    find_changed({0b01000000, 0b00000000}, {0b00000001, 0b00000100});
+    REQUIRE(raised == std::vector<const jutta_bt_proto::Alert*>{&joe.alerts[1], &joe.alerts[2], &joe.alerts[3]});
+    REQUIRE(cleared == bit1);
+
+    // Bytes missing from a shrinking frame count as cleared:
+    find_changed({0b00000001, 0b00000100, 0b00001000}, {0b00000001});
+    REQUIRE(raised.empty());
+    REQUIRE(cleared == std::vector<const jutta_bt_proto::Alert*>{&joe.alerts[2], &joe.alerts[3], &joe.alerts[4]});
+
+    // And as raised for a growing one:
+    find_changed({0b00000001}, {0b00000001, 0b00000000, 0b00001000});
+    REQUIRE(raised == bit20);
+    REQUIRE(cleared.empty());
+
+    // Bits without alerts do not report anything:
+    find_changed({0b00000001, 0b00000000}, {0b10111111, 0b11111011, 0b11110111, 0xFF, 0xFF});
+    REQUIRE(raised.empty());
+    REQUIRE(cleared.empty());
+
+    // Matches diffing find_alerts() for random transitions:
+    std::mt19937 rng(15);
+    std::uniform_int_distribution<std::mt19937::result_type> dist(0, 255);
+    for (size_t run = 0; run < 200; run++) {
+        std::vector<uint8_t> last(run % 5);
+        std::vector<uint8_t> status((run / 5) % 5);
+        for (uint8_t& b : last) {
+            b = static_cast<uint8_t>(dist(rng));
+        }
+        for (uint8_t& b : status) {
+            b = static_cast<uint8_t>(dist(rng));
+        }
+        std::vector<const jutta_bt_proto::Alert*> lastAlerts;
+        std::vector<const jutta_bt_proto::Alert*> statusAlerts;
+        joe.find_alerts(last, lastAlerts);
+        joe.find_alerts(status, statusAlerts);
+        std::vector<const jutta_bt_proto::Alert*> expectedRaised;
+        std::vector<const jutta_bt_proto::Alert*> expectedCleared;
+        std::set_difference(statusAlerts.begin(), statusAlerts.end(), lastAlerts.begin(), lastAlerts.end(), std::back_inserter(expectedRaised));
+        std::set_difference(lastAlerts.begin(), lastAlerts.end(), statusAlerts.begin(), statusAlerts.end(), std::back_inserter(expectedCleared));
+        find_changed(last, status);
+        REQUIRE(raised == expectedRaised);
+        REQUIRE(cleared == expectedCleared);
+    }
+}
+
+TEST_CASE("LastFrameSkipsDuplicates", "[CoffeeMaker]") {
+    jutta_bt_proto::LastFrame lastFrame;
+    const std::vector<uint8_t> frame{0x2A, 0x01, 0x02};
+    const std::vector<uint8_t> other{0x2A, 0x01, 0x03};
+
+    REQUIRE_FALSE(lastFrame.is_duplicate(frame));
+    REQUIRE(lastFrame.is_duplicate(frame));
+    REQUIRE(lastFrame.is_duplicate(frame));
+    REQUIRE_FALSE(lastFrame.is_duplicate(other));
+    REQUIRE_FALSE(lastFrame.is_duplicate(frame));
+
+    // Prefixes and extensions of the stored frame are no duplicates:
+    REQUIRE_FALSE(lastFrame.is_duplicate(std::span<const uint8_t>(frame).first(2)));
+    REQUIRE_FALSE(lastFrame.is_duplicate(frame));
+
+    // After a reset, the next frame always counts as new:
+    lastFrame.reset();
+    REQUIRE_FALSE(lastFrame.is_duplicate(frame));
+    REQUIRE(lastFrame.is_duplicate(frame));
+
+    // Frames too large to store never count as duplicate:
+    const std::vector<uint8_t> large(lastFrame.data.size() + 1, 0x2A);
+    REQUIRE_FALSE(lastFrame.is_duplicate(large));
+    REQUIRE_FALSE(lastFrame.is_duplicate(large));
+    REQUIRE_FALSE(lastFrame.is_duplicate(frame));
+    REQUIRE(lastFrame.is_duplicate(frame));
+}
+
+TEST_CASE("ParseManufacturerData", "[ManufacturerData]") {
+    // Manufacturer data as advertised by an E6 (article number 15084):
+    const std::array<uint8_t, 16> data{0x2A, 0x05, 0x02, 0x00, 0xEC, 0x3A, 0x12, 0x00, 0x34, 0x12, 0x5B, 0x52, 0x21, 0x00, 0x00, 0x80};
+    const jutta_bt_proto::ManufacturerData manData = jutta_bt_proto::to_man_data(data);
+    REQUIRE(manData.key == 0x2A);
+    REQUIRE(manData.bfMajVer == 5);
+    REQUIRE(manData.bfMinVer == 2);
+    REQUIRE(manData.articleNumber == 15084);
+    REQUIRE(manData.machineNumber == 0x12);
+    REQUIRE(manData.serialNumber == 0x1234);
+    REQUIRE(manData.machineProdDate == date::year{2031} / 2 / 27);
+    REQUIRE(manData.machineProdDateUCHI == date::year{1990} / 1 / 1);
+    REQUIRE(manData.statusBits == 0x80);
+    REQUIRE(jutta_bt_proto::to_uint16_t_little_endian(data, 4) == 0x3AEC);
+}
+
+TEST_CASE("MachineRegistryLoadsOnce", "[MachineRegistry]") {
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "jutta_bt_proto_test_machines.txt";
+    {
+        std::ofstream file(path);
+        file << "ArticleNumber;Name;FileName;Version\n";
+        file << "15084;E6 (EB);EF532V2;2\n";
+        file << "15138;ENA 8 (EF);EF1091;1\n";
+    }
+
+    jutta_bt_proto::MachineRegistry registry(path);
+    REQUIRE_FALSE(registry.is_loaded());
+    const std::shared_ptr<const jutta_bt_proto::Machines> machines = registry.get_machines();
+    REQUIRE(registry.is_loaded());
+    REQUIRE(machines->size() == 2);
+    REQUIRE(machines->at(15084).fileName == "EF532V2");
+    REQUIRE(machines->at(15138).version == 1);
+
+    // Further calls share the same machines:
+    REQUIRE(registry.get_machines() == machines);
+    registry.set_path(path);
+    REQUIRE(registry.get_machines() == machines);
+
+    // Reloading keeps the old machines alive for their current users:
+    const std::shared_ptr<const jutta_bt_proto::Machines> reloaded = registry.reload();
+    REQUIRE(reloaded != machines);
+    REQUIRE(machines->at(15084).name == "E6 (EB)");
+    REQUIRE(reloaded->size() == 2);
+
+    // Machines share ownership with all machines loaded together:
+    const std::shared_ptr<const jutta_bt_proto::Machine> machine = registry.get_machine(15084);
+    REQUIRE(machine.get() == &reloaded->at(15084));
+    REQUIRE(registry.get_machine(1) == nullptr);
+    REQUIRE(registry.get_joe_definition(1) == nullptr);
+    REQUIRE(registry.get_joe_definition_count() == 0);
+
+    registry.set_path(path.string() + ".other");
+    REQUIRE_FALSE(registry.is_loaded());
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("MachineSnapshotRoundTrip", "[MachineSnapshot]") {
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "jutta_bt_proto_test_snapshot";
+    std::filesystem::create_directories(directory);
+    const std::filesystem::path machinesPath = directory / "JOE_MACHINES.TXT";
+    const std::filesystem::path snapshotPath = jutta_bt_proto::to_snapshot_path(machinesPath);
+    REQUIRE(snapshotPath == directory / "JOE_MACHINES.snapshot");
+    {
+        std::ofstream file(machinesPath);
+        file << "ArticleNumber;Name;FileName;Version\n15084;E6 (EB);EF532V2;2\n";
+    }
+
+    jutta_bt_proto::Machines machines;
+    machines.emplace(15084, jutta_bt_proto::Machine(15084, "E6 (EB)", "EF532V2", 2));
+    machines.emplace(15085, jutta_bt_proto::Machine(15085, "E6 (EC)", "EF532V2", 2));
+    machines.emplace(15138, jutta_bt_proto::Machine(15138, "ENA 8 (EF)", "EF1091", 1));
+
+    std::vector<jutta_bt_proto::Item> items;
+    items.emplace_back("Normal", "02");
+    items.emplace_back("Strong", "03");
+    std::vector<jutta_bt_proto::Product> products;
+    products.emplace_back("Espresso", "02", std::make_optional<jutta_bt_proto::ItemsOption>("F3", "02", items), std::nullopt, std::make_optional<jutta_bt_proto::MinMaxOption>("F4", 45, 25, 80, 5), std::nullopt);
+    products.emplace_back("Hot water", "0D", std::nullopt, std::nullopt, std::nullopt, std::nullopt);
+    std::vector<jutta_bt_proto::Alert> alerts;
+    alerts.emplace_back(1, "fill water", "error");
+    alerts.emplace_back(13, "empty grounds", "error");
+    std::vector<jutta_bt_proto::MaintenanceCounter> counters;
+    counters.emplace_back("cleaning", 0);
+    std::vector<jutta_bt_proto::MaintenancePercentage> percentages;
+    percentages.emplace_back("filter", 0);
+    const std::shared_ptr<const jutta_bt_proto::Machine> machine = std::make_shared<const jutta_bt_proto::Machine>(machines.at(15084));
+    const std::vector<std::shared_ptr<const jutta_bt_proto::JoeDefinition>> definitions{std::make_shared<const jutta_bt_proto::JoeDefinition>(nullptr, "2021", machine, std::move(products), std::move(alerts), std::move(counters), std::move(percentages))};
+    const std::vector<std::filesystem::path> sources{machinesPath};
+    REQUIRE(jutta_bt_proto::write_snapshot(snapshotPath, machines, definitions, sources));
+
+    {
+        const std::shared_ptr<const jutta_bt_proto::MachineSnapshot> snapshot = jutta_bt_proto::MachineSnapshot::open(snapshotPath);
+        REQUIRE(snapshot);
+        REQUIRE(snapshot->get_machines().size() == 3);
+        jutta_bt_proto::Arena arena;
+        REQUIRE(snapshot->to_machines(arena).at(15138).name == "ENA 8 (EF)");
+        REQUIRE(snapshot->find_machine(1) == nullptr);
+
+        // Both E6 share the same definition:
+        const jutta_bt_proto::snapshot::Machine* e6 = snapshot->find_machine(15085);
+        REQUIRE(e6);
+        REQUIRE(e6->definition == snapshot->find_machine(15084)->definition);
+        REQUIRE(snapshot->find_definition(*snapshot->find_machine(15138)) == nullptr);
+
+        const std::shared_ptr<const jutta_bt_proto::JoeDefinition> definition = snapshot->to_joe_definition(std::make_shared<const jutta_bt_proto::Machine>(machines.at(15085)));
+        REQUIRE(definition);
+        REQUIRE(definition->machine->articleNumber == 15085);
+        REQUIRE(definition->dated == "2021");
+        REQUIRE(definition->products.size() == 2);
+        for (size_t i = 0; i < definition->products.size(); i++) {
+            REQUIRE(definition->products[i].name == definitions[0]->products[i].name);
+            REQUIRE(definition->products[i].command == definitions[0]->products[i].command);
+        }
+        REQUIRE(definition->products[0].strength->items[1].name == "Strong");
+        REQUIRE(definition->products[0].waterAmount->max == 80);
+        REQUIRE_FALSE(definition->products[1].strength);
+        REQUIRE(definition->find_alert_by_bit(13)->name == "empty grounds");
+        REQUIRE(definition->maintenanceCounters[0].name == "cleaning");
+        REQUIRE(definition->maintenancePercentages[0].name == "filter");
+        REQUIRE(snapshot->to_joe_definition(std::make_shared<const jutta_bt_proto::Machine>(machines.at(15138))) == nullptr);
+    }
+
+    // Definitions point into the mapping and keep it alive:
+    {
+        std::shared_ptr<const jutta_bt_proto::MachineSnapshot> snapshot = jutta_bt_proto::MachineSnapshot::open(snapshotPath);
+        REQUIRE(snapshot);
+        const std::shared_ptr<const jutta_bt_proto::JoeDefinition> definition = snapshot->to_joe_definition(machine);
+        REQUIRE(definition);
+        REQUIRE(definition->snapshot == snapshot);
+        const std::weak_ptr<const jutta_bt_proto::MachineSnapshot> weakSnapshot = snapshot;
+        snapshot.reset();
+        REQUIRE_FALSE(weakSnapshot.expired());
+        REQUIRE(definition->products[0].name == "Espresso");
+        REQUIRE(definition->products[0].strength->items[0].value == "02");
+        REQUIRE(definition->find_alert_by_bit(1)->name == "fill water");
+    }
+
+    // Changing a source makes the snapshot stale:
+    {
+        std::ofstream file(machinesPath, std::ios::app);
+        file << "15138;ENA 8 (EF);EF1091;1\n";
+    }
+    REQUIRE_FALSE(jutta_bt_proto::MachineSnapshot::open(snapshotPath));
+
+    // Corrupted snapshots get rejected:
+    REQUIRE(jutta_bt_proto::write_snapshot(snapshotPath, machines, definitions, sources));
+    REQUIRE(jutta_bt_proto::MachineSnapshot::open(snapshotPath));
+    {
+        std::fstream file(snapshotPath, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(static_cast<std::streamoff>(sizeof(jutta_bt_proto::snapshot::Header)));
+        file.put('X');
+    }
+    REQUIRE_FALSE(jutta_bt_proto::MachineSnapshot::open(snapshotPath));
+    REQUIRE_FALSE(jutta_bt_proto::MachineSnapshot::open(directory / "missing.snapshot"));
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("MachineRegistryPreload", "[MachineRegistry]") {
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "jutta_bt_proto_test_preload";
+    std::filesystem::create_directories(directory);
+    const std::filesystem::path machinesPath = directory / "JOE_MACHINES.TXT";
+    {
+        std::ofstream file(machinesPath);
+        file << "ArticleNumber;Name;FileName;Version\n15084;E6 (EB);EF532V2;2\n15138;ENA 8 (EF);EF1091;1\n";
+    }
+
+    // Only the E6 definition is part of the snapshot and there are no XML files:
+    jutta_bt_proto::Arena arena;
+    jutta_bt_proto::Machines machines = jutta_bt_proto::load_machines(machinesPath, arena);
+    std::vector<jutta_bt_proto::Product> products;
+    products.emplace_back("Espresso", "02", std::nullopt, std::nullopt, std::nullopt, std::nullopt);
+    const std::vector<std::shared_ptr<const jutta_bt_proto::JoeDefinition>> definitions{std::make_shared<const jutta_bt_proto::JoeDefinition>(nullptr, "2021", std::make_shared<const jutta_bt_proto::Machine>(machines.at(15084)), std::move(products), std::vector<jutta_bt_proto::Alert>{}, std::vector<jutta_bt_proto::MaintenanceCounter>{}, std::vector<jutta_bt_proto::MaintenancePercentage>{})};
+    const std::vector<std::filesystem::path> sources{machinesPath};
+    REQUIRE(jutta_bt_proto::write_snapshot(jutta_bt_proto::to_snapshot_path(machinesPath), machines, definitions, sources));
+
+    jutta_bt_proto::MachineRegistry registry(machinesPath);
+    REQUIRE(registry.get_snapshot());
+    std::vector<jutta_bt_proto::PreloadResult> results = registry.preload(2);
+    std::sort(results.begin(), results.end(), [](const jutta_bt_proto::PreloadResult& a, const jutta_bt_proto::PreloadResult& b) { return a.articleNumber < b.articleNumber; });
+    REQUIRE(results.size() == 2);
+    REQUIRE(results[0].articleNumber == 15084);
+    REQUIRE(results[0].fileName == "EF532V2");
+    REQUIRE(results[0].success);
+    REQUIRE(results[0].fromSnapshot);
+    REQUIRE(results[1].articleNumber == 15138);
+    REQUIRE_FALSE(results[1].success);
+    REQUIRE(registry.get_joe_definition_count() == 1);
+
+    // Connecting uses the preloaded definition:
+    const std::shared_ptr<const jutta_bt_proto::JoeDefinition> definition = registry.get_joe_definition(15084);
+    REQUIRE(definition);
+    REQUIRE(definition->products[0].name == "Espresso");
+    REQUIRE(registry.get_joe_definition(15084) == definition);
+    REQUIRE(registry.get_joe_definition(15138) == nullptr);
+
+    // Nothing left to preload:
+    REQUIRE(registry.preload(2).size() == 1);
+
+    std::filesystem::remove_all(directory);
+}
+
+constexpr const char* TEST_MACHINE_FILE = R"(<?xml version="1.0" encoding="utf-8"?>
+<!-- Test machine -->
+<JOE dated="2021-06-02">
+  <PRODUCTS>
+    <PRODUCT Name="Espresso" Code="02">
+      <COFFEE_STRENGTH Argument="F3" Default="02">
+        <ITEM Name="Mild" Value="01"/>
+        <ITEM Name="Strong &amp; bold" Value="03"/>
+      </COFFEE_STRENGTH>
+      <WATER_AMOUNT Argument="F4" Value="45" Min="25" Max="80" Step="5"/>
+    </PRODUCT>
+    <PRODUCT Name="Hot water" Code="0D"><TEMPERATURE Argument="F7" Default="01"><ITEM Name="Normal" Value="01"/></TEMPERATURE></PRODUCT>
+  </PRODUCTS>
+  <ALERTS>
+    <ALERT Bit="1" Name="fill water" Type="error"/>
+    <ALERT Bit="13" Name="empty grounds"/>
+  </ALERTS>
+  <STATISTIC>
+    <MAINTENANCEPAGE>
+      <BANK Name="Something else"><TEXTITEM Type="ignored"/></BANK>
+      <BANK Name="Maintenance Counter"><TEXTITEM Type="cleaning"/><TEXTITEM Type="decalc"/></BANK>
+      <BANK Name="Maintenance Percent"><![CDATA[ <ignored> ]]><TEXTITEM Type="filter"/></BANK>
+      <BANK Name="Maintenance Counter"><TEXTITEM Type="duplicate"/></BANK>
+    </MAINTENANCEPAGE>
+  </STATISTIC>
+</JOE>
+)";
+
+TEST_CASE("LoadJoeFromXml", "[CoffeeMakerLoader]") {
+    std::istringstream in(TEST_MACHINE_FILE);
+    const std::shared_ptr<const jutta_bt_proto::JoeDefinition> joe = jutta_bt_proto::load_joe(nullptr, in, "test");
+    REQUIRE(joe);
+    REQUIRE(joe->dated == "2021-06-02");
+    REQUIRE(joe->products.size() == 2);
+
+    const jutta_bt_proto::Product& espresso = joe->products[0];
+    REQUIRE(espresso.name == "Espresso");
+    REQUIRE(espresso.strength);
+    REQUIRE(espresso.strength->items.size() == 2);
+    REQUIRE(espresso.strength->items[1].name == "Strong & bold");
+    REQUIRE(espresso.waterAmount);
+    REQUIRE(espresso.waterAmount->max == 80);
+    REQUIRE_FALSE(espresso.temperature);
+    REQUIRE(espresso.to_bt_command() == "000200020900000000000000000000000000");
+
+    const jutta_bt_proto::Product& hotWater = joe->products[1];
+    REQUIRE(hotWater.codeValue == 0x0D);
+    REQUIRE(hotWater.temperature);
+    REQUIRE(hotWater.temperature->items.size() == 1);
+    REQUIRE_FALSE(hotWater.strength);
+
+    REQUIRE(joe->alerts.size() == 2);
+    REQUIRE(joe->alerts[1].bit == 13);
+    REQUIRE(joe->alerts[1].type.empty());
+
+    REQUIRE(joe->maintenanceCounters.size() == 2);
+    REQUIRE(joe->maintenanceCounters[1].name == "decalc");
+    REQUIRE(joe->maintenancePercentages.size() == 1);
+    REQUIRE(joe->maintenancePercentages[0].name == "filter");
+}
+
+TEST_CASE("LoadJoeReportsMalformedXml", "[CoffeeMakerLoader]") {
+    for (const char* xml : {"", "<JOE dated=\"1\">", "<JOE dated=\"1\"></PRODUCTS>", "<OTHER/>", "<JOE/>", "<JOE dated=\"1\"><ALERTS><ALERT Bit=\"x\" Name=\"a\"/></ALERTS></JOE>",
+                            "<JOE dated=\"1\"><PRODUCTS><PRODUCT Name=\"a\"/></PRODUCTS></JOE>", "<JOE dated=\"1\"/><JOE dated=\"2\"/>", "<JOE dated=\"&unknown;\"/>", "<JOE dated=1/>"}) {
+        std::istringstream in(xml);
+        REQUIRE(jutta_bt_proto::load_joe(nullptr, in, "malformed") == nullptr);
+    }
+
+    std::istringstream in("<JOE dated=\"1\"/>");
+    const std::shared_ptr<const jutta_bt_proto::JoeDefinition> joe = jutta_bt_proto::load_joe(nullptr, in, "minimal");
+    REQUIRE(joe);
+    REQUIRE(joe->products.empty());
+    REQUIRE(joe->maintenanceCounters.empty());
+
+    // Bits outside of the machine status get rejected, so XML, snapshot and embedded tables agree:
+    for (const char* bit : {"18446744073709551615", "18446744073709551616", "4294967297", "4000000000", "4088"}) {
+        std::istringstream alertIn(std::string{"<JOE dated=\"1\"><ALERTS><ALERT Bit=\"1\" Name=\"a\"/><ALERT Bit=\""} + bit + "\" Name=\"b\"/></ALERTS></JOE>");
+        REQUIRE(jutta_bt_proto::load_joe(nullptr, alertIn, "large bit") == nullptr);
+    }
+    std::istringstream maxBitIn("<JOE dated=\"1\"><ALERTS><ALERT Bit=\"4087\" Name=\"last\"/></ALERTS></JOE>");
+    const std::shared_ptr<const jutta_bt_proto::JoeDefinition> maxBitJoe = jutta_bt_proto::load_joe(nullptr, maxBitIn, "max bit");
+    REQUIRE(maxBitJoe);
+    REQUIRE(maxBitJoe->find_alert_by_bit(jutta_bt_proto::Alert::MAX_BIT)->name == "last");
+
+    // Definitions not parsed from XML drop them instead of sizing the bit table after them:
+    std::vector<jutta_bt_proto::Alert> alerts;
+    alerts.emplace_back(jutta_bt_proto::Alert::MAX_BIT, "last", "info");
+    alerts.emplace_back(jutta_bt_proto::Alert::MAX_BIT + 1, "too large", "info");
+    const jutta_bt_proto::JoeDefinition maxJoe(nullptr, "1", nullptr, {}, std::move(alerts), {}, {});
+    REQUIRE(maxJoe.alerts.size() == 1);
+    REQUIRE(maxJoe.find_alert_by_bit(jutta_bt_proto::Alert::MAX_BIT)->name == "last");
+}
+
+/**
+ * Writes the test machine file dated with the given date as EF532V2.xml into the given directory.
+ **/
+void write_test_machine_file(const std::filesystem::path& directory, const std::string& dated) {
+    std::string xml = TEST_MACHINE_FILE;
+    xml.replace(xml.find("2021-06-02"), 10, dated);
+    std::ofstream file(directory / "EF532V2.xml", std::ios::binary | std::ios::trunc);
+    file << xml;
+}
+
+TEST_CASE("MachineRegistryRefreshesDefinitions", "[MachineRegistry]") {
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "jutta_bt_proto_test_refresh";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    const std::filesystem::path machinesPath = directory / "JOE_MACHINES.TXT";
+    {
+        std::ofstream file(machinesPath);
+        file << "ArticleNumber;Name;FileName;Version\n15084;E6 (EB);EF532V2;2\n";
+    }
+    write_test_machine_file(directory, "2021-06-02");
+
+    jutta_bt_proto::MachineRegistry registry(machinesPath);
+    const std::shared_ptr<const jutta_bt_proto::JoeDefinition> definition = registry.get_joe_definition(15084);
+    REQUIRE(definition);
+    REQUIRE(jutta_bt_proto::validate_joe_definition(*definition));
+
+    // Invalid machine files do not replace the current definition:
+    {
+        std::ofstream file(directory / "EF532V2.xml", std::ios::trunc);
+        file << "<JOE dated=\"2022-01-01\"/>";
+    }
+    REQUIRE_FALSE(registry.refresh_joe_definitions("EF532V2"));
+    REQUIRE(registry.get_joe_definition(15084) == definition);
+
+    write_test_machine_file(directory, "2022-01-01");
+    REQUIRE(registry.refresh_joe_definitions("EF532V2"));
+    const std::shared_ptr<const jutta_bt_proto::JoeDefinition> refreshed = registry.get_joe_definition(15084);
+    REQUIRE(refreshed != definition);
+    REQUIRE(refreshed->dated == "2022-01-01");
+    // Coffee makers still holding on to the old definition keep using it until they reconnect:
+    REQUIRE(definition->dated == "2021-06-02");
+    REQUIRE(definition->products[0].name == "Espresso");
+
+    // Refreshing the machines parses the cached definitions again:
+    {
+        std::ofstream file(machinesPath, std::ios::trunc);
+        file << "ArticleNumber;Name;FileName;Version\n15084;E6 (EB);EF532V2;3\n15138;ENA 8 (EF);EF1091;1\n";
+    }
+    REQUIRE(registry.refresh_machines());
+    REQUIRE(registry.get_machines()->size() == 2);
+    REQUIRE(registry.get_joe_definition_count() == 1);
+    const std::shared_ptr<const jutta_bt_proto::JoeDefinition> reparsed = registry.get_joe_definition(15084);
+    REQUIRE(reparsed != refreshed);
+    REQUIRE(reparsed->machine->version == 3);
+    REQUIRE(reparsed->dated == "2022-01-01");
+
+    // Machines without any entries are invalid:
+    {
+        std::ofstream file(machinesPath, std::ios::trunc);
+        file << "ArticleNumber;Name;FileName;Version\n";
+    }
+    REQUIRE_FALSE(registry.refresh_machines());
+    REQUIRE(registry.get_machines()->size() == 2);
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("MachineRegistryFreesOldArenas", "[MachineRegistry]") {
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "jutta_bt_proto_test_arenas";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    const std::filesystem::path machinesPath = directory / "JOE_MACHINES.TXT";
+    {
+        std::ofstream file(machinesPath);
+        file << "ArticleNumber;Name;FileName;Version\n15084;E6 (EB);EF532V2;2\n";
+    }
+    write_test_machine_file(directory, "2021-06-02");
+
+    jutta_bt_proto::MachineRegistry registry(machinesPath);
+    std::shared_ptr<const jutta_bt_proto::JoeDefinition> definition = registry.get_joe_definition(15084);
+    REQUIRE(definition);
+    const std::weak_ptr<const jutta_bt_proto::Arena> oldArena = registry.get_arena();
+    REQUIRE(definition->arena == oldArena.lock());
+
+    // Refreshing a single file does not grow the arena of the machines:
+    const size_t size = registry.get_arena()->get_size();
+    REQUIRE(registry.refresh_joe_definitions("EF532V2"));
+    REQUIRE(registry.get_arena()->get_size() == size);
+    REQUIRE(registry.get_joe_definition(15084)->arena != definition->arena);
+
+    // The old arena stays alive as long as a coffee maker still uses a definition of it:
+    REQUIRE(registry.refresh_machines());
+    REQUIRE(registry.get_arena() != oldArena.lock());
+    REQUIRE_FALSE(oldArena.expired());
+    REQUIRE(definition->products[0].name == "Espresso");
+    definition = nullptr;
+    REQUIRE(oldArena.expired());
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("MachineWatcherPublishesChanges", "[MachineWatcher]") {
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "jutta_bt_proto_test_watcher";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    const std::filesystem::path machinesPath = directory / "JOE_MACHINES.TXT";
+    {
+        std::ofstream file(machinesPath);
+        file << "ArticleNumber;Name;FileName;Version\n15084;E6 (EB);EF532V2;2\n";
+    }
+    write_test_machine_file(directory, "2021-06-02");
+
+    jutta_bt_proto::MachineRegistry registry(machinesPath);
+    const std::shared_ptr<const jutta_bt_proto::JoeDefinition> definition = registry.get_joe_definition(15084);
+    REQUIRE(definition);
+
+    jutta_bt_proto::MachineWatcher watcher(registry, std::chrono::milliseconds{50});
+    REQUIRE(watcher.start());
+    REQUIRE(watcher.is_running());
+    REQUIRE_FALSE(watcher.start());
+
+    write_test_machine_file(directory, "2022-01-01");
+    const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds{5};
+    while (watcher.get_refresh_count() == 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    }
+    REQUIRE(watcher.get_refresh_count() == 1);
+    REQUIRE(watcher.get_failed_refresh_count() == 0);
+    REQUIRE(registry.get_joe_definition(15084)->dated == "2022-01-01");
+
+    // Replacing the whole directory like extract_apk.sh does:
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    {
+        std::ofstream file(machinesPath);
+        file << "ArticleNumber;Name;FileName;Version\n15084;E6 (EB);EF532V2;2\n";
+    }
+    write_test_machine_file(directory, "2023-03-04");
+    while (watcher.get_refresh_count() < 2 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    }
+    REQUIRE(watcher.get_refresh_count() == 2);
+    REQUIRE(registry.get_joe_definition(15084)->dated == "2023-03-04");
+
+    watcher.stop();
+    REQUIRE_FALSE(watcher.is_running());
+    std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("ArenaInternsStrings", "[Arena]") {
+    jutta_bt_proto::Arena arena;
+    const std::string_view normal = arena.intern(std::string{"Normal"});
+    REQUIRE(normal == "Normal");
+    REQUIRE(arena.intern("Normal").data() == normal.data());
+    REQUIRE(arena.intern("").empty());
+    REQUIRE(arena.get_string_count() == 1);
+
+    // Large values get a block of their own and do not invalidate earlier views:
+    const std::string large(jutta_bt_proto::Arena::BLOCK_SIZE * 2, 'x');
+    REQUIRE(arena.intern(large) == large);
+    REQUIRE(normal == "Normal");
+
+    const std::vector<jutta_bt_proto::Item> items{{"Mild", "01"}, {"Strong", "03"}};
+    const std::span<const jutta_bt_proto::Item> stored = arena.store<jutta_bt_proto::Item>(items);
+    REQUIRE(stored.size() == 2);
+    REQUIRE(reinterpret_cast<uintptr_t>(stored.data()) % alignof(jutta_bt_proto::Item) == 0);
+    REQUIRE(stored[1].commandValue == 0x03);
+    REQUIRE(arena.store<jutta_bt_proto::Item>({}).empty());
+
+    // Definitions sharing an arena share their strings:
+    const std::shared_ptr<jutta_bt_proto::Arena> shared = std::make_shared<jutta_bt_proto::Arena>();
+    std::istringstream firstIn(TEST_MACHINE_FILE);
+    std::istringstream secondIn(TEST_MACHINE_FILE);
+    const std::shared_ptr<const jutta_bt_proto::JoeDefinition> first = jutta_bt_proto::load_joe(nullptr, firstIn, "first", shared);
+    const size_t size = shared->get_size();
+    const std::shared_ptr<const jutta_bt_proto::JoeDefinition> second = jutta_bt_proto::load_joe(nullptr, secondIn, "second", shared);
+    REQUIRE(first);
+    REQUIRE(second);
+    REQUIRE(first->arena == second->arena);
+    REQUIRE(first->products[0].name.data() == second->products[0].name.data());
+    REQUIRE(first->productCodes == std::vector<size_t>{0x02, 0x0D});
+    // Only the item arrays get stored again:
+    REQUIRE(shared->get_size() - size < 2 * 3 * sizeof(jutta_bt_proto::Item));
+}
+
+namespace embedded_test {
+constexpr std::array<jutta_bt_proto::embedded::Item, 2> ITEMS{{{"Mild", "01"}, {"Strong", "03"}}};
+constexpr jutta_bt_proto::embedded::ItemsOption STRENGTH{"F3", "02", ITEMS};
+constexpr jutta_bt_proto::embedded::MinMaxOption WATER_AMOUNT{"F4", 45, 25, 80, 5};
+constexpr std::array<jutta_bt_proto::embedded::Product, 2> PRODUCTS{{{"Espresso", "02", &STRENGTH, nullptr, &WATER_AMOUNT, nullptr},
+                                                                     {"Hot water", "0D", nullptr, nullptr, nullptr, nullptr}}};
+constexpr std::array<jutta_bt_proto::embedded::Alert, 1> ALERTS{{{13, "empty grounds", "error"}}};
+constexpr std::array<std::string_view, 1> COUNTERS{"cleaning"};
+constexpr jutta_bt_proto::embedded::Definition DEFINITION{"EF532V2", "2021", PRODUCTS, ALERTS, COUNTERS, {}};
+}  // namespace embedded_test
+
+TEST_CASE("LoadJoeFromEmbeddedTables", "[EmbeddedMachines]") {
+    static_assert(embedded_test::DEFINITION.products[0].strength->items[1].value == "03");
+
+    const std::shared_ptr<const jutta_bt_proto::Machine> machine = std::make_shared<const jutta_bt_proto::Machine>(15084, "E6 (EB)", "EF532V2", 2);
+    const std::shared_ptr<const jutta_bt_proto::JoeDefinition> joe = jutta_bt_proto::load_joe(machine, embedded_test::DEFINITION);
+    REQUIRE(joe);
+    REQUIRE(joe->dated == "2021");
+    REQUIRE(joe->products.size() == 2);
+    // No copies of the strings:
+    REQUIRE(joe->products[1].name.data() == embedded_test::PRODUCTS[1].name.data());
+    REQUIRE(joe->products[0].strength->items[1].commandValue == 0x03);
+    REQUIRE(joe->products[0].to_bt_command() == "000200020900000000000000000000000000");
+    REQUIRE_FALSE(joe->products[1].strength);
+    REQUIRE(joe->find_alert_by_bit(13)->name == "empty grounds");
+    REQUIRE(joe->maintenanceCounters[0].name == "cleaning");
+    REQUIRE(joe->maintenancePercentages.empty());
+
+#ifdef JUTTA_BT_PROTO_EMBED_MACHINES
+    REQUIRE_FALSE(jutta_bt_proto::get_embedded_machines().empty());
+    REQUIRE(std::is_sorted(jutta_bt_proto::get_embedded_machines().begin(), jutta_bt_proto::get_embedded_machines().end(), [](const jutta_bt_proto::embedded::Machine& a, const jutta_bt_proto::embedded::Machine& b) { return a.articleNumber < b.articleNumber; }));
+#else
+    REQUIRE(jutta_bt_proto::get_embedded_machines().empty());
+    REQUIRE(jutta_bt_proto::find_embedded_machine(15084) == nullptr);
+#endif
+}
+
+TEST_CASE("GeneratedEmbeddedTablesMatchXml", "[EmbeddedMachines]") {
+    // Generated by jutta_machine_codegen from tests/resources/machinefiles:
+    namespace tables = jutta_bt_proto::embedded::test_machines;
+    static_assert(tables::MACHINES.size() == 2);
+    static_assert(tables::MACHINES[0].articleNumber == 15084 && tables::MACHINES[0].definition == &tables::EF532V2);
+    static_assert(tables::MACHINES[1].articleNumber == 15138 && tables::MACHINES[1].definition == nullptr);
+    static_assert(tables::EF532V2.products[0].strength->items[1].name == "Strong & bold");
+
+    const jutta_bt_proto::Machines machines = jutta_bt_proto::to_machines(tables::MACHINES);
+    REQUIRE(machines.size() == 2);
+    REQUIRE(machines.at(15138).name == "ENA 8 (EF)");
+    const std::shared_ptr<const jutta_bt_proto::Machine> machine = std::make_shared<const jutta_bt_proto::Machine>(machines.at(15084));
+    const std::shared_ptr<const jutta_bt_proto::JoeDefinition> embedded = jutta_bt_proto::load_joe(machine, tables::EF532V2);
+    std::istringstream in(TEST_MACHINE_FILE);
+    const std::shared_ptr<const jutta_bt_proto::JoeDefinition> parsed = jutta_bt_proto::load_joe(machine, in, "test");
+    REQUIRE(embedded);
+    REQUIRE(parsed);
+    REQUIRE(embedded->dated == parsed->dated);
+    REQUIRE(embedded->productCodes == parsed->productCodes);
+    for (size_t i = 0; i < parsed->products.size(); i++) {
+        REQUIRE(embedded->products[i].name == parsed->products[i].name);
+        REQUIRE(embedded->products[i].to_bt_command() == parsed->products[i].to_bt_command());
+    }
+    REQUIRE(embedded->alerts.size() == parsed->alerts.size());
+    REQUIRE(embedded->find_alert_by_bit(1)->name == "fill water");
+    REQUIRE(embedded->maintenanceCounters.size() == parsed->maintenanceCounters.size());
+    REQUIRE(embedded->maintenancePercentages[0].name == "filter");
+}
+
+TEST_CASE("EmbeddedHeaderContainsTables", "[EmbeddedMachines]") {
+    jutta_bt_proto::Machines machines;
+    machines.emplace(15138, jutta_bt_proto::Machine(15138, "ENA 8 (EF)", "EF1091", 1));
+    machines.emplace(15084, jutta_bt_proto::Machine(15084, "E6 (EB)", "EF532V2", 2));
+    std::istringstream in(TEST_MACHINE_FILE);
+    const std::vector<std::shared_ptr<const jutta_bt_proto::JoeDefinition>> definitions{jutta_bt_proto::load_joe(std::make_shared<const jutta_bt_proto::Machine>(machines.at(15084)), in, "test")};
+    const std::string header = jutta_bt_proto::to_embedded_header(machines, definitions);
+
+    REQUIRE(header.find("inline constexpr Definition EF532V2{\"EF532V2\", \"2021-06-02\"") != std::string::npos);
+    REQUIRE(header.find("{\"Strong & bold\", \"03\"}") != std::string::npos);
+    REQUIRE(header.find("{\"Espresso\", \"02\", &ITEMS_OPTION_0, nullptr, &MIN_MAX_OPTION_0, nullptr}") != std::string::npos);
+    // Sorted by article number, machines without machine file have no definition:
+    const size_t e6 = header.find("{15084, \"E6 (EB)\", \"EF532V2\", 2, &EF532V2}");
+    const size_t ena8 = header.find("{15138, \"ENA 8 (EF)\", \"EF1091\", 1, nullptr}");
+    REQUIRE(e6 != std::string::npos);
+    REQUIRE(ena8 != std::string::npos);
+    REQUIRE(e6 < ena8);
+}
+
+TEST_CASE("XmlReaderEvents", "[XmlReader]") {
+    std::istringstream in("\xEF\xBB\xBF<?xml version=\"1.0\"?>\n<!DOCTYPE a [<!ELEMENT a ANY>]>\n<a x='&#65;&#x42;&lt;'>text<b/><!-- <c> --><c y=\"1\" z = \"2\"></c></a>\n");
+    jutta_bt_proto::XmlReader reader(in);
+    std::string events;
+    const bool success = reader.parse([&events, &reader](std::string_view name, const jutta_bt_proto::XmlAttributes& attributes) {
+                                          events += "<" + std::string{name} + ":" + std::to_string(reader.get_open_elements().size());
+                                          for (const char* attribute : {"x", "y", "z"}) {
+                                              if (attributes.get(attribute)) {
+                                                  events += " " + std::string{attribute} + "=" + std::string{*attributes.get(attribute)};
+                                              }
+                                          }
+                                      },
+                                      [&events](std::string_view name) { events += "/" + std::string{name}; });
+    REQUIRE(success);
+    REQUIRE(events == "<a:1 x=AB<<b:2/b<c:2 y=1 z=2/c/a");
+
+    std::istringstream malformed("<a>\n  <b>\n</a>");
+    jutta_bt_proto::XmlReader malformedReader(malformed);
+    REQUIRE_FALSE(malformedReader.parse([](std::string_view, const jutta_bt_proto::XmlAttributes&) {}, [](std::string_view) {}));
+    REQUIRE(malformedReader.get_error());
+    REQUIRE(malformedReader.get_error()->line == 3);
+    REQUIRE(malformedReader.get_error()->message == "Unexpected end tag 'a', expected 'b'.");
+}